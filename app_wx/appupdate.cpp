@@ -3,6 +3,8 @@
 #include <spread/job/thread.hpp>
 #include <spread/spread.hpp>
 #include "misc/dirfinder.hpp"
+#include "misc/hashcache.hpp"
+#include "tiglib/spread_cache.hpp"
 #include "version.hpp"
 #include <fstream>
 #include <ctime>
@@ -155,7 +157,10 @@ struct UpdateJob : Job
           }
 
         log("Current version: " + std::string(TIGGIT_VERSION));
-        newVer = repo->getSpread().getPackVersion("tiggit.net", package);
+        {
+          TigLib::SpreadLock lock;
+          newVer = repo->getSpread().getPackVersion("tiggit.net", package);
+        }
         log("New version: " + newVer);
 
         // Figure out if we've got a new version
@@ -165,7 +170,10 @@ struct UpdateJob : Job
           {
             log("NEW version detected!");
             log("Installing tiggit.net/" + package + " into " + dest);
-            client = repo->getSpread().install("tiggit.net", package, dest);
+            {
+              TigLib::SpreadLock lock;
+              client = repo->getSpread().install("tiggit.net", package, dest);
+            }
             if(waitClient(client))
               {
                 if(info->isAbort()) log("Install aborted");
@@ -194,16 +202,28 @@ void AppUpdater::cacheLocalExeDir()
   bf::path exePath = Misc::DirFinder::getExePath();
   exePath = exePath.parent_path();
 
-  // Traverse it and cache all the files in it
+  /* Traverse it and cache all the files in it. Spread hashes each
+     file it is given, so skip files that are unchanged since we
+     cached them on an earlier run. Recording the hash afterwards is
+     cheap, since the file was just read.
+   */
   bf::directory_iterator iter(exePath), end;
   for(; iter != end; ++iter)
     {
-      bf::path file = iter->path();
+      std::string file = iter->path().string();
+      uint64_t hash;
+      if(Misc::HashCache::lookup(file, hash))
+        continue;
 
       // Ignore errors, this is just an optimization anyway.
-      try { spread.cacheFile(file.string()); }
+      try
+        {
+          TigLib::cacheFile(spread, file);
+          Misc::HashCache::hashFile(file, false);
+        }
       catch(...) {}
     }
+  Misc::HashCache::save();
 #endif
 }
 
@@ -23,6 +23,19 @@ namespace wxTigApp
       conf.setBool("show_votes", b);
       show_votes = b;
     }
+
+    /* Off unless switched on in the config. The daemon can't take
+       over running downloads, only start them again from scratch, and
+       it can only be launched on Windows for now.
+     */
+    bool getBackgroundJobs()
+    {
+#ifdef _WIN32
+      return conf.getBool("background_jobs", false);
+#else
+      return false;
+#endif
+    }
   };
 }
 #endif
@@ -7,6 +7,12 @@
 #include <boost/filesystem.hpp>
 #include <spread/misc/readjson.hpp>
 #include "launcher/run.hpp"
+#include "misc/trace.hpp"
+#include "misc/metrics.hpp"
+#include "misc/filecopy.hpp"
+#include "jobprogress.hpp"
+#include <sstream>
+#include <stdexcept>
 
 namespace bf = boost::filesystem;
 using namespace TigData;
@@ -24,15 +30,22 @@ using namespace TigLib;
 
 void GameNews::reload()
 {
-  news.reload();
+  if(!news.reload()) return;
+
+  // Items may have moved, so throw out all conversions
+  items.clear();
   items.resize(news.size());
+  converted.assign(news.size(), false);
+}
 
-  for(int i=0; i<news.size(); i++)
-    {
-      wxGameNewsItem &out = items[i];
-      const TigLib::NewsItem &in = news.get(i);
+const wxGameNewsItem &GameNews::get(int i) const
+{
+  wxGameNewsItem &out = items[i];
+  const TigLib::NewsItem &in = news.get(i);
+  out.read = in.isRead;
 
-      out.read = in.isRead;
+  if(!converted[i])
+    {
       out.dateNum = in.date;
       out.subject = strToWx(in.subject);
       out.body = strToWx(in.body);
@@ -40,7 +53,10 @@ void GameNews::reload()
       char buf[50];
       strftime(buf,50, "%Y-%m-%d", gmtime(&in.date));
       out.date = wxString(buf, wxConvUTF8);
+      converted[i] = true;
     }
+
+  return out;
 }
 
 void GameNews::markAsRead(int i)
@@ -75,6 +91,7 @@ static InstalledPick instPick;
 
 void wxTigApp::GameData::updateReady()
 {
+  TRACE_SCOPE("GameData::updateReady");
   PRINT("GameData::updateReady()");
   PRINT("  repo.hasNewData():  " << repo.hasNewData());
   PRINT("  hasNewUpdate:       " << updater.hasNewUpdate);
@@ -93,6 +110,7 @@ void wxTigApp::GameData::updateReady()
 
       // Just update the stats
       repo.loadStats();
+      statsChanged();
       updateDisplayStatus();
       return;
     }
@@ -163,6 +181,68 @@ void wxTigApp::GameData::notifyButton(int id)
 
 bool wxTigApp::GameData::isActive() { return notify.hasJobs(); }
 
+static std::string megs(int64_t bytes)
+{
+  std::ostringstream str;
+  str.precision(1);
+  str << std::fixed << bytes/(1024.0*1024) << " MB";
+  return str.str();
+}
+
+void wxTigApp::GameData::dedupGames()
+{
+  if(notify.hasJobs())
+    {
+      Boxes::error("Cannot do this while downloads are in progress");
+      return;
+    }
+
+  if(!Boxes::ask("This will look for identical files in your installed games, and make them share disk space.\n\nIt may take a while. Continue?"))
+    return;
+
+  Misc::Dedup::Report rep;
+  Spread::JobInfoPtr info = repo.dedupGames(&rep);
+  JobProgress prog(info);
+  if(!prog.start("Looking for duplicate files"))
+    {
+      if(info->isError())
+        Boxes::error("Failed: " + info->getMessage());
+      return;
+    }
+
+  std::ostringstream msg;
+  msg << "Scanned " << rep.files << " files.\n"
+      << "Found " << rep.dupes << " duplicates (" << megs(rep.dupeBytes) << ").\n"
+      << "Reclaimed " << megs(rep.savedBytes) << ".\n\n"
+      << "Total reclaimed in this repository: " << megs(repo.getDedupSaved());
+  if(rep.linked < rep.dupes)
+    msg << "\n\nSome files could not be merged, since the filesystem does not support it.";
+  Boxes::say(msg.str());
+}
+
+std::string wxTigApp::GameData::getDiagnostics()
+{
+  TigLib::FileCache::Stats cs = repo.getCacheStats();
+  std::ostringstream str;
+  str.precision(1);
+  str << std::fixed << Misc::Metrics::toText()
+      << "\nFile cache: " << cs.files << " files, " << megs(cs.bytes);
+  if(repo.getCacheBudget() > 0)
+    str << " of " << megs(repo.getCacheBudget()) << "\n";
+  else
+    str << " (off, set cache_budget in tiglib.conf to enable)\n";
+  str << "  hit rate " << cs.hitRate()*100 << "% (" << cs.hits << " hits, "
+      << cs.misses << " misses), saved " << megs(cs.savedBytes) << "\n";
+  return str.str();
+}
+
+wxString wxTigApp::GameData::totalSizeString()
+{
+  int64_t total = repo.getTotalSize();
+  if(total <= 0) return wxString();
+  return strToWx(megs(total));
+}
+
 bool wxTigApp::GameData::moveRepo(const std::string &newPath)
 {
   PRINT("GameData::moveRepo(" << newPath << ")");
@@ -187,15 +267,11 @@ bool wxTigApp::GameData::moveRepo(const std::string &newPath)
   try
     {
       Spread::SpreadLib *spread = &repo.getSpread();
-
-      // Import main data (games, screenshots and config files.) The
-      // last 'false' parameter means 'do not delete source files'.
-      if(!ImportGui::importRepoGui(repo.getPath(), newPath, spread, false))
-        return true;
-
       bf::path oldP = repo.getPath(), newP = newPath;
 
-      // Next, copy executables and spread files.
+      /* Copy executables and spread files first. These are copies, so
+         stopping here leaves the current repository as it was.
+       */
       if(!ImportGui::copyFilesGui((oldP/"run").string(), (newP/"run").string(),
                                   spread, "Copying executables"))
         return true;
@@ -204,18 +280,47 @@ bool wxTigApp::GameData::moveRepo(const std::string &newPath)
                                   spread, "Copying Tiggit data"))
         return true;
 
-      bf::copy_file(oldP/"spread/cache.conf", newP/"spread/cache.conf");
+      Misc::FileCopy::copyFile((oldP/"spread/cache.conf").string(),
+                               (newP/"spread/cache.conf").string());
+
+      /* Import main data (games, screenshots and config files.) The
+         'false' parameter means 'do not ask to delete source files',
+         the old repo is cleaned up after the restart instead.
 
-      /* Create a cleanup file in the new repo. This will ask the user
-         if they want to delete the old repository after we've
-         restarted.
+         Games are moved rather than copied when both directories are
+         on the same filesystem, which is instant. Games on another
+         filesystem are copied, and removed with the rest of the old
+         repo after the restart. If the import stops halfway, the
+         moved games are put back.
        */
-      ReadJson::writeJson((newP/"cleanup.json").string(), oldP.string(), true);
+      Import::MoveList moved;
+      if(!ImportGui::importRepoGui(repo.getPath(), newPath, spread, false, true, &moved))
+        {
+          Boxes::error("Moving was aborted. Your games are still in " + repo.getPath());
+          return true;
+        }
 
-      // Finally, switch the globally stored path string over to the
-      // new location. This makes this the "official" repository from
-      // now on.
-      repo.setStoredPath(newPath);
+      try
+        {
+          /* Create a cleanup file in the new repo. This will ask the
+             user if they want to delete the old repository after we've
+             restarted.
+           */
+          ReadJson::writeJson((newP/"cleanup.json").string(), oldP.string(), true);
+
+          // Finally, switch the globally stored path string over to
+          // the new location. This makes this the "official"
+          // repository from now on.
+          if(!repo.setStoredPath(newPath))
+            throw std::runtime_error("Could not store the new repository location");
+        }
+      catch(...)
+        {
+          // Put the games back where the running repository expects
+          // them
+          Import::undoMoves(moved, newPath);
+          throw;
+        }
 
       // Notify the user that we are restarting from the new location
       Boxes::say("Tiggit will now restart for changes to take effect");
@@ -253,9 +358,21 @@ void wxTigApp::GameData::killData()
     }
 }
 
+void wxTigApp::GameData::statsChanged()
+{
+  const InfoLookup &lst = repo.getList();
+  InfoLookup::const_iterator it;
+  for(it=lst.begin(); it!=lst.end(); it++)
+    {
+      GameInf *gi = (GameInf*)(it->second->extra);
+      if(gi) gi->updateStats();
+    }
+}
+
 void wxTigApp::GameData::loadData()
 {
   PRINT("loadData()");
+  TRACE_SCOPE("GameData::loadData");
 
   using namespace std;
 
@@ -12,12 +12,18 @@ namespace wxTigApp
   struct GameNews : wxGameNews
   {
     TigLib::NewsReader news;
-    std::vector<wxGameNewsItem> items;
+
+    /* Converted items. Filled in by get() as they are needed, which
+       is usually only for the rows that are visible.
+     */
+    mutable std::vector<wxGameNewsItem> items;
+    mutable std::vector<bool> converted;
 
     GameNews(TigLib::Repo *repo) : news(repo) {}
 
-    const wxGameNewsItem &get(int i) const { return items[i]; }
-    int size() const { return items.size(); }
+    const wxGameNewsItem &get(int i) const;
+    bool isRead(int i) const { return news.get(i).isRead; }
+    int size() const { return news.size(); }
     void reload();
     void markAsRead(int);
     void markAllAsRead();
@@ -48,6 +54,12 @@ namespace wxTigApp
 
     bool isActive();
 
+    std::string getDiagnostics();
+
+    wxString totalSizeString();
+
+    void dedupGames();
+
     // Notify us that an update is available. This will prompt the
     // user about the appropriate action.
     void updateReady();
@@ -61,6 +73,10 @@ namespace wxTigApp
     // Deallocate all GameInf structures
     void killData();
 
+    // Tell all GameInf structures that the stats data (download
+    // counts and ratings) has been reloaded.
+    void statsChanged();
+
     // Called when a game has started or finished installing, or has
     // been uninstalled.
     void installStatusChanged()
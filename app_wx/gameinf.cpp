@@ -58,9 +58,71 @@ static wxString ago(time_t when, time_t now=0)
   return wxString(buf, wxConvUTF8);
 }
 
-void GameInf::updateStatus()
+void GameInf::updateStatus() { valid &= ~CF_STATUS; }
+void GameInf::updateStats() { valid &= ~CF_STATS; }
+
+void GameInf::sampleProgress()
+{
+  if(!isWorking())
+    {
+      meter.reset();
+      return;
+    }
+
+  int64_t current, total;
+  info.progress(current, total);
+  meter.update(current);
+}
+
+void GameInf::makeTitle() const
+{
+  if(valid & CF_TITLE) return;
+  title = strToWx(info.ent->title);
+  valid |= CF_TITLE;
+}
+
+void GameInf::makeDesc() const
+{
+  if(valid & CF_DESC) return;
+  desc = strToWx(info.ent->desc);
+  valid |= CF_DESC;
+}
+
+void GameInf::makeTime() const
+{
+  if(valid & CF_TIME) return;
+  timeStr = ago(info.ent->addTime);
+  valid |= CF_TIME;
+}
+
+void GameInf::makeStats() const
 {
+  if(valid & CF_STATS) return;
+
+  const TigEntry *ent = info.ent;
+
+  dlStr = wxString::Format(wxT("%d"), ent->dlCount);
+  if(ent->rateCount > 0 && ent->rating > 0)
+    {
+      rateStr = wxString::Format(wxT("%3.2f"), ent->rating);
+      rateStr2 = rateStr + wxString::Format(wxT(" (%d)"), ent->rateCount);
+    }
+  else
+    {
+      rateStr.Clear();
+      rateStr2.Clear();
+    }
+
+  valid |= CF_STATS;
+}
+
+void GameInf::makeStatus() const
+{
+  if(valid & CF_STATUS) return;
+
+  makeTitle();
   titleStatus = title;
+  statusStr.Clear();
 
   if(isWorking())
     {
@@ -78,29 +140,47 @@ void GameInf::updateStatus()
 
       status << wxT(" (") << sizify(current) << wxT(" / ")
              << sizify(total) << wxT(")");
+
+      // Smoothed speed and time left
+      int64_t eta = meter.getETA(current, total);
+      if(eta >= 0)
+        status << wxT(", ") << strToWx(meter.rateString()) << wxT(", ")
+               << strToWx(Misc::RateMeter::etaString(eta)) << wxT(" left");
       statusStr = status;
     }
   else if(isInstalled())
     titleStatus += wxT(" [installed]");
+
+  valid |= CF_STATUS;
 }
 
-void GameInf::updateAll()
+wxString GameInf::getTitle(bool includeStatus) const
 {
-  const TigEntry *ent = info.ent;
-
-  title = strToWx(ent->title);
-  desc = strToWx(ent->desc);
-
-  dlStr = wxString::Format(wxT("%d"), ent->dlCount);
-  if(ent->rateCount > 0 && ent->rating > 0)
+  if(includeStatus)
     {
-      rateStr = wxString::Format(wxT("%3.2f"), ent->rating);
-      rateStr2 = rateStr + wxString::Format(wxT(" (%d)"), ent->rateCount);
+      makeStatus();
+      return titleStatus;
     }
+  makeTitle();
+  return title;
+}
 
-  timeStr = ago(ent->addTime);
+wxString GameInf::timeString() const { makeTime(); return timeStr; }
+wxString GameInf::dlString() const { makeStats(); return dlStr; }
+wxString GameInf::statusString() const { makeStatus(); return statusStr; }
+wxString GameInf::getDesc() const { makeDesc(); return desc; }
 
-  updateStatus();
+// Not cached, since sizes are updated in the background
+wxString GameInf::sizeString() const
+{
+  int64_t size = info.getSize();
+  if(size <= 0) return wxString();
+  return sizify(size);
+}
+wxString GameInf::rateString() const
+{
+  makeStats();
+  return conf->show_votes?rateStr2:rateStr;
 }
 
 std::string GameInf::getHomepage() const
@@ -155,6 +235,7 @@ void GameInf::launchGame()
    */
   Spread::JobInfoPtr job = info.update();
   JobProgress prog(job);
+  prog.showRate = true;
 
   bool run = true;
   if(!prog.start("Checking for updates"))
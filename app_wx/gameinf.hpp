@@ -3,6 +3,7 @@
 
 #include "tiglib/liveinfo.hpp"
 #include "gameconf.hpp"
+#include "misc/ratemeter.hpp"
 
 using namespace wxTiggit;
 
@@ -11,8 +12,7 @@ namespace wxTigApp
   struct GameInf : wxGameInfo
   {
     GameInf(TigLib::LiveInfo *_info, GameConf *_conf)
-      : info(*_info), shotIsLoaded(false), conf(_conf)
-    { updateAll(); }
+      : info(*_info), shotIsLoaded(false), conf(_conf), valid(0) {}
 
     bool isInstalled() const { return info.isInstalled(); }
     bool isUninstalled() const { return info.isUninstalled(); }
@@ -20,9 +20,19 @@ namespace wxTigApp
     bool isDemo() const { return info.ent->isDemo(); }
     bool isNew() const { return info.isNew(); }
 
-    // Update status strings
+    /* Mark status strings (install progress etc) as outdated. They
+       are rebuilt the next time they are requested.
+     */
     void updateStatus();
 
+    // Feed the current install progress to the speed meter. Called
+    // from the notifier on every tick.
+    void sampleProgress();
+
+    // Mark rating and download count strings as outdated. Call this
+    // after the stats have been reloaded.
+    void updateStats();
+
     TigLib::LiveInfo &info;
 
   private:
@@ -32,19 +42,40 @@ namespace wxTigApp
 
     GameConf *conf;
 
-    wxString title, titleStatus, timeStr, rateStr, rateStr2, dlStr, statusStr, desc;
+    /* Cached display strings. Only a handful of games are ever
+       visible at once, so these are not created until somebody asks
+       for them. The 'valid' bit field tells which groups are
+       currently up to date.
+     */
+    mutable wxString title, titleStatus, timeStr, rateStr, rateStr2, dlStr, statusStr, desc;
+    mutable int valid;
+
+    // Install speed, see sampleProgress()
+    Misc::RateMeter meter;
+
+    enum CacheFields
+      {
+        CF_TITLE        = 0x01, // title
+        CF_DESC         = 0x02, // desc
+        CF_TIME         = 0x04, // timeStr
+        CF_STATS        = 0x08, // rateStr, rateStr2, dlStr
+        CF_STATUS       = 0x10  // titleStatus, statusStr
+      };
 
-    // Used to update cached wxStrings from source data
-    void updateAll();
+    // Used to (re)build cached wxStrings from source data
+    void makeTitle() const;
+    void makeDesc() const;
+    void makeTime() const;
+    void makeStats() const;
+    void makeStatus() const;
 
-    wxString getTitle(bool includeStatus=false) const
-    { return includeStatus?titleStatus:title; }
-    wxString timeString() const { return timeStr; }
-    wxString dlString() const { return dlStr; }
-    wxString statusString() const { return statusStr; }
-    wxString getDesc() const { return desc; }
-    wxString rateString() const
-    { return conf->show_votes?rateStr2:rateStr; }
+    wxString getTitle(bool includeStatus=false) const;
+    wxString timeString() const;
+    wxString dlString() const;
+    wxString statusString() const;
+    wxString sizeString() const;
+    wxString getDesc() const;
+    wxString rateString() const;
 
     std::string getHomepage() const;
     std::string getTiggitPage() const;
@@ -73,6 +73,11 @@ bool GameList::sortDownloads()
   lister.sortDownloads();
   return setStat(SS_DOWNLOADS);
 }
+bool GameList::sortSize()
+{
+  lister.sortSize();
+  return setStat(SS_SIZE);
+}
 
 int GameList::size() const { return lister.size(); }
 
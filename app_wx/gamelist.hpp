@@ -45,7 +45,7 @@ namespace wxTigApp
 
     enum SortStatus
       {
-        SS_NONE, SS_TITLE, SS_DATE, SS_RATING, SS_DOWNLOADS
+        SS_NONE, SS_TITLE, SS_DATE, SS_RATING, SS_DOWNLOADS, SS_SIZE
       };
 
     bool setStat(int i)
@@ -70,6 +70,7 @@ namespace wxTigApp
     bool sortDate();
     bool sortRating();
     bool sortDownloads();
+    bool sortSize();
 
     int size() const;
     const wxGameInfo& get(int i) { return edit(i); }
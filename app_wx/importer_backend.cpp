@@ -1,13 +1,23 @@
 #include "importer_backend.hpp"
 
 #include "../misc/freespace.hpp"
+#include "../misc/trace.hpp"
+#include "../misc/metrics.hpp"
+#include "../misc/filecopy.hpp"
+#include "../misc/filehash.hpp"
+#include "../tiglib/spread_cache.hpp"
 #include <spread/misc/readjson.hpp>
 #include <spread/misc/jconfig.hpp>
 #include <spread/job/thread.hpp>
 #include <stdexcept>
 #include <sstream>
+#include <map>
+#include <fstream>
+#include <algorithm>
 #include <assert.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 
 using namespace Spread;
 using namespace Misc;
@@ -23,13 +33,60 @@ static string toStr(X i)
   return str.str();
 }
 
+/* Import journal. Kept in the destination directory while copying,
+   and lists all files known to be complete. If the copy is
+   interrupted, the next run uses it to continue where it stopped,
+   without trusting files that may be half written. Removed when the
+   copy finishes.
+ */
+#define JOURNAL_NAME ".tiggit_import"
+
+struct Journal
+{
+  // Finished files (relative to the destination dir) and their sizes
+  map<string,int64_t> files;
+
+  ofstream out;
+  boost::mutex mutex;
+
+  void load(const string &file)
+  {
+    ifstream inp(file.c_str());
+    int64_t size;
+    string name;
+    while(inp >> size && getline(inp, name))
+      if(name.size() > 1)
+        files[name.substr(1)] = size;
+  }
+
+  void open(const string &file)
+  {
+    out.open(file.c_str(), ios::app);
+    if(!out) throw runtime_error("Cannot write " + file);
+  }
+
+  // Thread safe. Flushed right away, so the entry survives crashes.
+  void add(const string &name, int64_t size)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    out << size << " " << name << "\n";
+    out.flush();
+  }
+};
+
 struct Copy
 {
   JobInfoPtr info;
   SpreadLib *spread;
   Logger *logger;
 
-  Copy() : spread(NULL), logger(NULL) {}
+  Journal *journal;
+  int dstLen;
+
+  // Disk space held for the current copy
+  Misc::SpaceReservation space;
+
+  Copy() : spread(NULL), logger(NULL), journal(NULL) {}
 
   void log(const string &msg)
   {
@@ -47,6 +104,29 @@ struct Copy
     if(info) info->setProgress(cur, tot);
   }
 
+  // Progress callback from the copy threads. Returns false if the
+  // user aborted the job.
+  bool copyProgress(int64_t cur, int64_t tot)
+  {
+    prog(cur, tot);
+    space.setProgress(cur, tot);
+    return !(info && info->checkForAbort());
+  }
+
+  // Finished files, added to the Spread cache after the copy
+  vector<string> finished;
+  boost::mutex finishedMutex;
+
+  // Called from the copy threads for each finished file
+  void fileDone(const FileCopy::Entry &e)
+  {
+    {
+      boost::lock_guard<boost::mutex> lock(finishedMutex);
+      finished.push_back(e.to);
+    }
+    if(journal) journal->add(e.to.substr(dstLen), e.size);
+  }
+
   void doCopyFiles(const string &from, const string &to, bool addPng=false)
   {
     log("doCopyFiles FROM=" + from + " TO=" + to);
@@ -63,30 +143,49 @@ struct Copy
     path dstDir = absolute(to);
 
     // Base path without slash
-    string base = (srcDir/"tmp").parent_path().string();
-    int curlen = base.size() + 1;
+    string dstBase = (dstDir/"tmp").parent_path().string();
+    dstLen = dstBase.size() + 1;
+
+    // Continue an interrupted copy, if any
+    string jfile = (dstDir/JOURNAL_NAME).string();
+    Journal jour;
+    bool resume = exists(jfile);
+    if(resume)
+      {
+        jour.load(jfile);
+        log("  Resuming interrupted copy, " + toStr(jour.files.size()) + " files already done");
+      }
+
+    // Files that were in the destination before we started
+    vector<pair<string,int64_t> > keep;
 
-    vector<string> fromList, toList;
+    vector<FileCopy::Entry> list;
     int64_t totalSize = 0;
 
-    // Recurse the directory and list files to copy
-    recursive_directory_iterator iter(srcDir), end;
+    // Index the source directory, and the destination if it already
+    // exists. Both are scanned in parallel, which is a lot faster
+    // than stat'ing each output file on its own.
     log("  Indexing " + srcDir.string());
-    for(; iter != end; ++iter)
-      {
-        path p = iter->path();
-        if(!is_regular_file(p)) continue;
+    vector<FileCopy::FileInfo> files, existing;
+    FileCopy::index(srcDir.string(), files);
+    if(exists(dstDir))
+      FileCopy::index(dstDir.string(), existing);
+
+    map<string,int64_t> have;
+    for(int i=0; i<existing.size(); i++)
+      have[existing[i].name] = existing[i].size;
 
-        /* Remove base path from the name, retaining only the local
-           path. Example:
+    list.reserve(files.size());
+    for(int i=0; i<files.size(); i++)
+      {
+        /* File names are relative to the source dir. Example:
 
-           p = c:\path\to\dir\some-file\in-here\somewhere.txt
-           base = c:\path\to\dir
+           file = c:\path\to\dir\some-file\in-here\somewhere.txt
+           srcDir = c:\path\to\dir
            =>
            local = some-file\in-here\somewhere.txt
         */
-        string infile = p.string();
-        string local = infile.substr(curlen);
+        const string &local = files[i].name;
         string outfile = (dstDir/local).string();
 
         // Add PNG extension to screenshots
@@ -94,35 +193,100 @@ struct Copy
           if(outfile.size() <= 4 || outfile[outfile.size()-4] != '.')
             outfile += ".png";
 
-        // Don't overwrite files
-        if(exists(outfile))
-          continue;
+        string infile = (srcDir/local).string();
+        string key = outfile.substr(dstLen);
+        map<string,int64_t>::iterator hit = have.find(key);
+        if(hit != have.end())
+          {
+            // Don't overwrite files that were already there
+            if(!resume)
+              {
+                keep.push_back(make_pair(key, hit->second));
+                continue;
+              }
+
+            // Finished in an earlier run
+            map<string,int64_t>::iterator jit = jour.files.find(key);
+            if(jit != jour.files.end() && jit->second == hit->second)
+              continue;
+
+            // Left over from the interrupted run, and may be
+            // incomplete. Keep it if it's good, otherwise copy it
+            // again.
+            if(hit->second == files[i].size && sameContent(infile, outfile))
+              {
+                keep.push_back(make_pair(key, hit->second));
+                continue;
+              }
+            log("  Recopying " + key);
+            remove(outfile);
+          }
 
         // List file
-        fromList.push_back(infile);
-        toList.push_back(outfile);
+        FileCopy::Entry e;
+        e.from = infile;
+        e.to = outfile;
+        e.size = files[i].size;
+        list.push_back(e);
 
-        totalSize += file_size(p);
+        totalSize += e.size;
       }
 
-    assert(fromList.size() == toList.size());
-
     prog(0, totalSize);
-    log("  Found " + toStr(fromList.size()) + " files, total " + toStr(totalSize) + " bytes");
-    // Check free disk space
-    int64_t diskFree, diskTotal;
+    log("  Found " + toStr(list.size()) + " files, total " + toStr(totalSize) + " bytes");
     // Make sure the destination dir exists first
     bf::create_directories(dstDir);
-    Misc::getDiskSpace(dstDir.string(), diskFree, diskTotal);
-    log("  Free disk space: " + toStr(diskFree) + " bytes");
 
-    // This isn't exact, since required allocated size will often be
-    // larger than file data size. But it will catch the most cases.
-    if(diskFree < totalSize)
+    /* Reserve the disk space we need. Each file takes up a whole
+       number of blocks, and the reservation keeps other installs and
+       imports running at the same time from counting on the same
+       free space.
+     */
+    int64_t block = Misc::getBlockSize(dstDir.string());
+    int64_t allocTotal = 0;
+    for(int i=0; i<list.size(); i++)
+      allocTotal += Misc::allocSize(list[i].size, block);
+    log("  Space needed on disk: " + toStr(allocTotal) + " bytes");
+    log("  Free disk space: " + toStr(Misc::getAvailable(dstDir.string())) + " bytes");
+
+    if(!space.reserve(dstDir.string(), allocTotal))
       fail("Not enough free disk space on destination drive " + dstDir.string());
 
+    // Start the journal, and record the files we are keeping
+    jour.open(jfile);
+    journal = &jour;
+    for(int i=0; i<keep.size(); i++)
+      jour.add(keep[i].first, keep[i].second);
+
     log("  Copying files...");
-    spread->cacheCopy(fromList, toList, info);
+    int64_t start = Metrics::now();
+    bool done = FileCopy::copy(list, boost::bind(&Copy::copyProgress, this, _1, _2),
+                               boost::bind(&Copy::fileDone, this, _1));
+    journal = NULL;
+    space.release();
+
+    /* Register the copied files in the Spread cache, so later installs
+       and updates can reuse them. This hashes every file, so it's done
+       in one go here instead of holding up the copy threads. The
+       files were just written, so they are still in the OS cache.
+     */
+    if(!finished.empty())
+      {
+        log("  Adding " + toStr(finished.size()) + " files to the cache");
+        TigLib::cacheFiles(*spread, finished);
+        finished.clear();
+      }
+
+    // Keep the journal around if we were aborted
+    if(done)
+      {
+        jour.out.close();
+        remove(jfile);
+      }
+
+    Metrics::throughput("copy.bytes_per_sec", totalSize, Metrics::now()-start);
+    Metrics::count("copy.bytes", totalSize);
+    Metrics::count("copy.files", list.size());
     log("  Done");
   }
 };
@@ -179,22 +343,54 @@ struct CopyJob : Spread::Job
   string fromDir, toDir, idname, outConf;
   Logger *log;
   SpreadLib *spread;
-  bool addPng;
+  bool addPng, move;
+
+  // Set to true if the directory was renamed rather than copied
+  bool *renamed;
 
-  CopyJob() : log(NULL), addPng(false) {}
+  CopyJob() : log(NULL), addPng(false), move(false), renamed(NULL) {}
+
+  /* Move the entire directory with one rename. This only works
+     within the same filesystem, but is then instant no matter how
+     much data there is.
+   */
+  bool tryRename()
+  {
+    try
+      {
+        if(bf::exists(toDir)) return false;
+        bf::create_directories(bf::path(toDir).parent_path());
+        bf::rename(fromDir, toDir);
+      }
+    catch(...) { return false; }
+
+    if(log) (*log)("Moved " + fromDir + " to " + toDir);
+    return true;
+  }
 
   void doJob()
   {
+    TRACE_SCOPE2("CopyJob", fromDir);
     setBusy("Copying files");
     assert(spread);
 
-    Copy cpy;
-    cpy.spread = spread;
-    cpy.info = info;
-    cpy.logger = log;
-    cpy.doCopyFiles(fromDir, toDir, addPng);
-
-    if(checkStatus()) return;
+    /* A finished rename is never reported as aborted, since the files
+       are already gone from the source. The caller must know about
+       them, to register or undo the move.
+     */
+    if(move && tryRename())
+      {
+        if(renamed) *renamed = true;
+      }
+    else
+      {
+        Copy cpy;
+        cpy.spread = spread;
+        cpy.info = info;
+        cpy.logger = log;
+        cpy.doCopyFiles(fromDir, toDir, addPng);
+        if(checkStatus()) return;
+      }
 
     // Success. Write the entry to the output config file, if any.
     if(outConf != "" && idname != "")
@@ -225,16 +421,17 @@ JobInfoPtr Import::copyFiles(const string &from, const string &to,
   return Thread::run(job);
 }
 
-JobInfoPtr Import::importGame(const string &game,
-                              const string &from, const string &to,
-                              SpreadLib *spread, Misc::Logger &log, bool async)
+/* Find the source and destination directories for importing a
+   game. Returns false if there is nothing to import.
+ */
+static bool findGame(const string &game, const string &from, const string &to,
+                     Misc::Logger &log, string &fromDir, string &toDir,
+                     string &outConf)
 {
-  log("Importing " + game + " from " + from + " to " + to);
-
   if(bf::equivalent(from, to))
     {
       log("ERROR: from and to paths are equivalent");
-      return JobInfoPtr();
+      return false;
     }
 
   string fromDir1 = (bf::path(from)/"data"/game).string();
@@ -245,31 +442,34 @@ JobInfoPtr Import::importGame(const string &game,
   // check the value in the tiglib_installed.conf file first as our
   // source path.
 
-  string toDir = (bf::path(to)/"gamedata"/game).string();
-  JobInfoPtr info;
+  toDir = (bf::path(to)/"gamedata"/game).string();
 
   log("  fromDir1=" + fromDir1);
   log("  fromDir2=" + fromDir2);
   log("  fromDir3=" + fromDir3);
   log("  toDir=" + toDir);
 
-  bool isOk = true;
-
-  // Don't do anything if the destination exists
+  // Don't do anything if the destination exists, unless it was left
+  // by an import that was interrupted.
   if(bf::exists(toDir))
     {
-      log("Destination already exists. Abort.");
-      return info;
+      if(!bf::exists(bf::path(toDir)/JOURNAL_NAME))
+        {
+          log("Destination already exists. Abort.");
+          return false;
+        }
+      log("Resuming interrupted import");
     }
 
-  // Check destination config
-  string outConf = (bf::path(to)/"tiglib_installed.conf").string();
+  // Check destination config. Games marked as uninstalled there (eg.
+  // by undoMoves()) may be imported again.
+  outConf = (bf::path(to)/"tiglib_installed.conf").string();
   {
     JConfig conf(outConf);
-    if(conf.has(game))
+    if(conf.get(game) != "")
       {
         log("Game already registered in " + outConf + ". Abort.");
-        return info;
+        return false;
       }
   }
 
@@ -282,7 +482,7 @@ JobInfoPtr Import::importGame(const string &game,
   else
     {
       log("No source directory found. Abort.");
-      return info;
+      return false;
     }
 
   log("Picked source dir " + fromDir1);
@@ -290,22 +490,254 @@ JobInfoPtr Import::importGame(const string &game,
   // Make sure to absolute() paths. If we are running in a thread, we
   // may risk changing the programs working directory while we are
   // working.
-  fromDir1 = bf::absolute(fromDir1).string();
+  fromDir = bf::absolute(fromDir1).string();
   toDir = bf::absolute(toDir).string();
-  log("FINAL IN: " + fromDir1);
+  log("FINAL IN: " + fromDir);
   log("FINAL OUT: " + toDir);
+  return true;
+}
+
+JobInfoPtr Import::importGame(const string &game,
+                              const string &from, const string &to,
+                              SpreadLib *spread, Misc::Logger &log, bool async,
+                              bool move)
+{
+  log("Importing " + game + " from " + from + " to " + to);
+
+  string fromDir, toDir, outConf;
+  if(!findGame(game, from, to, log, fromDir, toDir, outConf))
+    return JobInfoPtr();
 
   CopyJob *job = new CopyJob;
-  job->fromDir = fromDir1;
+  job->fromDir = fromDir;
   job->toDir = toDir;
   job->idname = game;
   job->outConf = outConf;
   job->log = &log;
   job->spread = spread;
   job->addPng = false;
+  job->move = move;
+  return Thread::run(job, async);
+}
+
+// Max number of games copied at the same time by importGames()
+#define GAME_THREADS 3
+
+struct BatchImportJob : Spread::Job
+{
+  vector<string> games;
+  string from, to;
+  Logger *log;
+  SpreadLib *spread;
+  bool move;
+  boost::shared_ptr<Import::BatchResult> result;
+
+  struct Item
+  {
+    string game, fromDir, toDir;
+    int64_t size;
+    bool renamed;
+    JobInfoPtr info;
+  };
+
+  static bool sizeLess(const Item &a, const Item &b)
+  { return a.size < b.size; }
+
+  // Record the result of a finished game
+  void finish(Item &it, const string &outConf)
+  {
+    if(it.info->isSuccess())
+      {
+        // Registered here rather than in CopyJob, so that parallel
+        // jobs don't overwrite each other's config changes.
+        (*log)("Updating " + outConf + " with " + it.game + "=" + it.toDir);
+        JConfig conf(outConf);
+        conf.set(it.game, it.toDir);
+
+        result->success.push_back(it.game);
+        if(it.renamed)
+          {
+            Import::Moved m;
+            m.game = it.game;
+            m.from = it.fromDir;
+            m.to = it.toDir;
+            result->moved.push_back(m);
+          }
+        (*log)("Successfully imported " + it.game);
+      }
+    else
+      {
+        result->failed.push_back(it.game);
+        result->errors.push_back(it.info->getMessage());
+        (*log)("Failed to import " + it.game + ": " + it.info->getMessage());
+      }
+  }
+
+  void doJob()
+  {
+    TRACE_SCOPE("BatchImportJob");
+    setBusy("Preparing import");
+    assert(spread && log);
+
+    // Find all the games, and how big they are
+    vector<Item> items;
+    string outConf;
+    int64_t total = 0;
+    for(int i=0; i<games.size(); i++)
+      {
+        Item it;
+        it.game = games[i];
+        (*log)("Importing " + it.game + " from " + from + " to " + to);
+        if(!findGame(it.game, from, to, *log, it.fromDir, it.toDir, outConf))
+          continue;
+
+        it.size = 0;
+        it.renamed = false;
+        try
+          {
+            vector<FileCopy::FileInfo> files;
+            FileCopy::index(it.fromDir, files);
+            for(int k=0; k<files.size(); k++)
+              it.size += files[k].size;
+          }
+        catch(...) {}
+
+        total += it.size;
+        items.push_back(it);
+      }
+
+    // Do the small games first, so that most of the library becomes
+    // usable as early as possible.
+    std::stable_sort(items.begin(), items.end(), sizeLess);
+
+    vector<Item*> active;
+    int next = 0, finished = 0;
+    int64_t doneBytes = 0;
+    int64_t start = Metrics::now();
+
+    bool aborting = false;
+    while(true)
+      {
+        /* On abort, stop the running games, and keep going until they
+           have all finished. They are collected below like any other
+           finished game, so renamed games are never lost track of.
+         */
+        if(!aborting && info->checkForAbort())
+          {
+            for(int i=0; i<active.size(); i++)
+              active[i]->info->abort();
+            aborting = true;
+          }
+
+        // Start new games
+        while(!aborting && active.size() < GAME_THREADS && next < items.size())
+          {
+            Item &it = items[next++];
+            CopyJob *job = new CopyJob;
+            job->fromDir = it.fromDir;
+            job->toDir = it.toDir;
+            job->log = log;
+            job->spread = spread;
+            job->move = move;
+            job->renamed = &it.renamed;
+            it.info = Thread::run(job);
+            active.push_back(&it);
+          }
+
+        // Collect finished games, and sum up progress
+        int64_t current = doneBytes;
+        for(int i=0; i<active.size(); i++)
+          {
+            Item &it = *active[i];
+            if(it.info->isFinished())
+              {
+                finish(it, outConf);
+                doneBytes += it.size;
+                current += it.size;
+                finished++;
+                active.erase(active.begin() + i--);
+                continue;
+              }
+
+            // Scale the game's own progress to its estimated size
+            int64_t cur = it.info->getCurrent(), tot = it.info->getTotal();
+            if(tot > 0)
+              current += (int64_t)(it.size * ((double)cur/tot));
+          }
+
+        if(active.empty() && (aborting || next == items.size()))
+          break;
+
+        setProgress(current, total);
+
+        // Throughput and time left
+        double secs = (Metrics::now() - start) / 1000000.0;
+        stringstream msg;
+        msg << "Imported " << finished << " of " << items.size() << " games";
+        if(secs > 2 && current > 0)
+          {
+            double speed = current / secs;
+            int left = (int)((total-current) / speed);
+            msg.precision(1);
+            msg << std::fixed << " (" << speed/(1024*1024) << " MB/s, ";
+            if(left >= 120) msg << left/60 << " minutes left)";
+            else msg << left << " seconds left)";
+          }
+        setBusy(msg.str());
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      }
+
+    if(aborting) return;
+    setProgress(total, total);
+    setDone();
+  }
+};
+
+JobInfoPtr Import::importGames(const vector<string> &games,
+                               const string &from, const string &to,
+                               SpreadLib *spread, Misc::Logger &log,
+                               boost::shared_ptr<BatchResult> result,
+                               bool move, bool async)
+{
+  assert(result);
+  BatchImportJob *job = new BatchImportJob;
+  job->games = games;
+  job->from = from;
+  job->to = to;
+  job->log = &log;
+  job->spread = spread;
+  job->move = move;
+  job->result = result;
   return Thread::run(job, async);
 }
 
+bool Import::undoMoves(const MoveList &moved, const string &to,
+                       Misc::Logger *log)
+{
+  string outConf = (bf::path(to)/"tiglib_installed.conf").string();
+  JConfig conf(outConf);
+
+  bool ok = true;
+  for(int i=moved.size()-1; i>=0; i--)
+    {
+      const Moved &m = moved[i];
+      try
+        {
+          bf::rename(m.to, m.from);
+          conf.set(m.game, "");
+          if(log) (*log)("Moved " + m.to + " back to " + m.from);
+        }
+      catch(exception &e)
+        {
+          if(log) (*log)("ERROR: Could not move " + m.to + " back to " +
+                         m.from + ": " + e.what());
+          ok = false;
+        }
+    }
+  return ok;
+}
+
 JobInfoPtr Import::importShots(const string &from, const string &to,
                                Spread::SpreadLib *spread, Misc::Logger &log,
                                bool async)
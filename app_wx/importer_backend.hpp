@@ -4,6 +4,7 @@
 #include <spread/spread.hpp>
 #include "../misc/logger.hpp"
 #include <vector>
+#include <boost/shared_ptr.hpp>
 
 namespace Import
 {
@@ -12,10 +13,60 @@ namespace Import
   void getGameList(std::vector<std::string> &games, const std::string &from,
                    Misc::Logger &logger);
 
+  /* Import one game. If 'move' is true, the game directory is
+     renamed into place when possible (ie. when source and destination
+     are on the same filesystem), instead of being copied. The source
+     is then gone afterwards.
+   */
   Spread::JobInfoPtr importGame(const std::string &game,
                                 const std::string &from, const std::string &to,
                                 Spread::SpreadLib *spread, Misc::Logger &logger,
-                                bool async=true);
+                                bool async=true, bool move=false);
+
+  // A game directory that was moved by renaming it
+  struct Moved
+  {
+    std::string game, from, to;
+  };
+  typedef std::vector<Moved> MoveList;
+
+  struct BatchResult
+  {
+    std::vector<std::string> success, failed;
+
+    // Error messages, one for each entry in 'failed'
+    std::vector<std::string> errors;
+
+    // Games in 'success' that were renamed rather than copied
+    MoveList moved;
+  };
+
+  /* Import a list of games in one job. Up to three games are copied
+     at the same time, smallest first, so that most of the library
+     becomes usable quickly. Progress covers all games, and the job
+     message shows the number of games done, throughput and time
+     left.
+
+     With 'move', games are renamed into place where possible, as in
+     importGame(), and listed in result->moved. Games on another
+     filesystem are still copied, and their sources left in place.
+
+     Games that are already imported or not found are skipped. The
+     results are only valid after the job has finished.
+   */
+  Spread::JobInfoPtr importGames(const std::vector<std::string> &games,
+                                 const std::string &from, const std::string &to,
+                                 Spread::SpreadLib *spread, Misc::Logger &logger,
+                                 boost::shared_ptr<BatchResult> result,
+                                 bool move=false, bool async=true);
+
+  /* Undo the renames done by a move import, and unregister the games
+     from the destination repository 'to'. Returns false if any game
+     could not be moved back. It is then still found in the
+     destination, and listed in the log.
+   */
+  bool undoMoves(const MoveList &moved, const std::string &to,
+                 Misc::Logger *logger = NULL);
 
   Spread::JobInfoPtr importShots(const std::string &from, const std::string &to,
                                  Spread::SpreadLib *spread, Misc::Logger &logger,
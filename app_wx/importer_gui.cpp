@@ -3,6 +3,7 @@
 #include <vector>
 #include <string>
 #include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
 #include "wx/boxes.hpp"
 #include "jobprogress.hpp"
 #include <spread/misc/readjson.hpp>
@@ -65,8 +66,20 @@ bool ImportGui::copyFilesGui(const std::string &from, const std::string &to,
   return false;
 }
 
+// Put moved games back after a failed move, and tell the user if that
+// didn't work out
+static void undoMoves(const Import::MoveList &moved, const string &to,
+                      Misc::Logger &log)
+{
+  if(moved.empty()) return;
+  log("Undoing move of " + boost::lexical_cast<string>(moved.size()) + " games");
+  if(!Import::undoMoves(moved, to, &log))
+    Boxes::error("Some games could not be moved back, and are still found in " +
+                 to + ". See import.log there for details.");
+}
+
 bool ImportGui::importRepoGui(const string &from, const string &to, SpreadLib *spread,
-                              bool doCleanup)
+                              bool doCleanup, bool move, Import::MoveList *moved)
 {
   Misc::Logger log((boost::filesystem::path(to) / "import.log").string());
   log("Importing repository from '" + from + "' to '" + to + "'");
@@ -86,40 +99,47 @@ bool ImportGui::importRepoGui(const string &from, const string &to, SpreadLib *s
   vector<string> games, success;
   Import::getGameList(games, from, log);
 
-  // Import games one by one
-  for(int i=0; i<games.size(); i++)
+  // Import all the games in one batch
+  boost::shared_ptr<Import::BatchResult> res(new Import::BatchResult);
+  JobInfoPtr batch = Import::importGames(games, from, to, spread, log, res, move);
+  wxTigApp::JobProgress prog(batch);
+  prog.showStatus = true;
+  if(!prog.start("Importing games"))
     {
-      const string &game = games[i];
-      log("Importing game " + game);
-      JobInfoPtr info = Import::importGame(game, from, to, spread, log);
+      // The job stops quickly once aborted. Wait for it, so we don't
+      // read the results while it is still running.
+      prog.wait("Stopping import");
 
-      if(info)
+      bool cont;
+      if(batch->isError())
         {
-          wxTigApp::JobProgress prog(info);
-          if(!prog.start("Importing game " + game))
-            {
-              if(info->isError())
-                {
-                  log("Failure: " + info->getMessage());
-                  if(!Boxes::ask("Import failed: " + info->getMessage() + "\n\nContinue?"))
-                    return false;
-                }
-              else
-                {
-                  log("Aborted by user");
-                  if(!Boxes::ask("Do you want to continue importing?"))
-                    return false;
-                }
-            }
-          else
-            {
-              // Add successful games to a special list
-              success.push_back(game);
-              log("Successfully imported " + game);
-            }
+          log("Failure: " + batch->getMessage());
+          cont = Boxes::ask("Import failed: " + batch->getMessage() + "\n\nContinue?");
         }
       else
-        log("No import needed or game not found");
+        {
+          log("Aborted by user");
+          cont = Boxes::ask("Do you want to continue importing?");
+        }
+
+      if(!cont)
+        {
+          undoMoves(res->moved, to, log);
+          return false;
+        }
+    }
+  success = res->success;
+
+  if(res->failed.size())
+    {
+      string msg = "The following games failed to import:\n";
+      for(int i=0; i<res->failed.size(); i++)
+        msg += "\n" + res->failed[i] + ": " + res->errors[i];
+      if(!Boxes::ask(msg + "\n\nContinue?"))
+        {
+          undoMoves(res->moved, to, log);
+          return false;
+        }
     }
 
   // Import screenshots
@@ -142,5 +162,6 @@ bool ImportGui::importRepoGui(const string &from, const string &to, SpreadLib *s
   if(doCleanup && Boxes::ask("Do you want to delete successfully imported data from " + from + "?"))
     Import::cleanup(from, success, log);
 
+  if(moved) *moved = res->moved;
   return true;
 }
@@ -2,11 +2,21 @@
 #define __APPWX_IMPORTER_GUI_HPP_
 
 #include <spread/spread.hpp>
+#include "importer_backend.hpp"
 
 namespace ImportGui
 {
+  /* Import a repository. With 'move', games are renamed into place
+     where possible instead of copied (see Import::importGames). If the
+     import is aborted, or fails and the user does not continue, the
+     renames are undone and false is returned.
+
+     On success, games that were moved are listed in 'moved', so the
+     caller can undo the move if its own later steps fail.
+   */
   bool importRepoGui(const std::string &from, const std::string &to,
-                     Spread::SpreadLib *spread, bool doCleanup);
+                     Spread::SpreadLib *spread, bool doCleanup,
+                     bool move=false, Import::MoveList *moved=NULL);
 
   bool copyFilesGui(const std::string &from, const std::string &to,
                     Spread::SpreadLib *spread, const std::string &text);
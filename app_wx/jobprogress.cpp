@@ -1,46 +1,139 @@
 #include "jobprogress.hpp"
 
+#include <wx/evtloop.h>
+#include <wx/timer.h>
+
 using namespace wxTigApp;
 
-bool JobProgress::start(const std::string &msg)
+// How often to check on the job, in milliseconds
+#define TICK_MS 200
+
+namespace
 {
-  setMsg(msg);
+  struct ProgressTimer : wxTimer
+  {
+    JobProgress *prog;
+    wxEventLoop *loop;
 
-  // Poll-loop until the job finishes, or the user cancels it.
-  while(true)
+    ProgressTimer(JobProgress *_prog, wxEventLoop *_loop)
+      : prog(_prog), loop(_loop)
     {
-      yield();
-      wxMilliSleep(40);
+      Start(TICK_MS);
+    }
 
-      bool res;
-      if(info->getTotal() != 0)
+    void Notify()
+    {
+      if(!prog->tick())
         {
-          // Calculate progress
-          int prog = (int)(info->getCurrent()*100.0/info->getTotal());
-          // Avoid auto-closing at 100%
-          if(prog >= 100) prog = 99;
-          res = update(prog);
+          Stop();
+          loop->Exit();
         }
-      else
-        res = pulse();
+    }
+  };
+}
 
-      // Did the user click 'Cancel'?
-      if(!res)
-        {
-          // Abort
-          info->abort();
+bool JobProgress::start(const std::string &msg)
+{
+  waiting = false;
+  return run(msg);
+}
 
-          // Break here, don't rely on isFinished() because a hanged
-          // job may never reach that state.
-          break;
-        }
+bool JobProgress::wait(const std::string &msg)
+{
+  waiting = true;
+  return run(msg);
+}
 
-      // If we're finished, exit.
-      if(info->isFinished())
-        break;
+bool JobProgress::run(const std::string &_msg)
+{
+  msg = shown = _msg;
+  meter.reset();
+  setMsg(msg);
+
+  /* Run our own event loop until the job finishes, or the user
+     cancels it. The timer wakes us up a few times a second to update
+     the dialog. In between we sleep, instead of spinning.
+   */
+  if(tick())
+    {
+      wxEventLoop loop;
+      ProgressTimer timer(this, &loop);
+      loop.Run();
     }
 
   update(100);
 
   return info->isSuccess();
 }
+
+bool JobProgress::tick()
+{
+  // Updating the dialog yields, which may deliver another timer
+  // event before we are done with this one.
+  if(inTick) return true;
+
+  inTick = true;
+  bool res = poll();
+  inTick = false;
+  return res;
+}
+
+bool JobProgress::poll()
+{
+  // If we're finished, exit.
+  if(info->isFinished())
+    return false;
+
+  // Nothing to show but that we're still waiting
+  if(waiting)
+    {
+      pulse();
+      return true;
+    }
+
+  bool res;
+  int64_t current = info->getCurrent(), total = info->getTotal();
+  if(total != 0)
+    {
+      // Calculate progress
+      int prog = (int)(current*100.0/total);
+      // Avoid auto-closing at 100%
+      if(prog >= 100) prog = 99;
+
+      std::string text = msg;
+      if(showStatus)
+        text += "\n" + info->getMessage();
+      if(showRate)
+        {
+          meter.update(current);
+          int64_t eta = meter.getETA(current, total);
+          if(eta >= 0)
+            text += "\n" + meter.rateString() + ", " +
+              Misc::RateMeter::etaString(eta) + " left";
+        }
+
+      // Only touch the text when it changes
+      if(text != shown)
+        {
+          shown = text;
+          res = setMsg(text, prog);
+        }
+      else
+        res = update(prog);
+    }
+  else
+    res = pulse();
+
+  // Did the user click 'Cancel'?
+  if(!res)
+    {
+      // Abort
+      info->abort();
+
+      // Stop here, don't rely on isFinished() because a hanged job
+      // may never reach that state.
+      return false;
+    }
+
+  return true;
+}
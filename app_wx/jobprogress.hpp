@@ -2,6 +2,7 @@
 #define __WXAPP_JOBPROG_HPP_
 
 #include "../wx/progress_holder.hpp"
+#include "misc/ratemeter.hpp"
 #include <spread/job/jobinfo.hpp>
 
 namespace wxTigApp
@@ -10,11 +11,38 @@ namespace wxTigApp
   {
     Spread::JobInfoPtr info;
 
+    // If true, the job's own status message is shown below the main
+    // message, and updated as it changes.
+    bool showStatus;
+
+    // If true, show the transfer speed and the estimated time
+    // left. Only makes sense for jobs that count bytes.
+    bool showRate;
+
     JobProgress(Spread::JobInfoPtr _info)
-      : info(_info) {}
+      : info(_info), showStatus(false), showRate(false), inTick(false),
+        waiting(false) {}
 
     // Returns true on success, false on failure or abort.
     bool start(const std::string &msg);
+
+    /* Wait for the job to finish, eg. after it has been aborted, while
+       showing 'msg'. Can't be cancelled. Returns true if the job
+       succeeded.
+     */
+    bool wait(const std::string &msg);
+
+    // Update the dialog. Returns false once the job is finished or
+    // aborted. Called regularly by start().
+    bool tick();
+
+  private:
+    std::string msg, shown;
+    Misc::RateMeter meter;
+    bool inTick, waiting;
+
+    bool run(const std::string &msg);
+    bool poll();
   };
 }
 #endif
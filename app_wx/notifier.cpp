@@ -1,6 +1,12 @@
 #include "notifier.hpp"
 #include "gamedata.hpp"
 #include "wx/boxes.hpp"
+#include "misc/trace.hpp"
+#include "misc/metrics.hpp"
+#include "misc/dirfinder.hpp"
+#include "launcher/run.hpp"
+#include <boost/filesystem.hpp>
+#include <ctime>
 #include <assert.h>
 
 using namespace wxTigApp;
@@ -45,8 +51,59 @@ static GameInf* getFromId(const TigLib::Repo &repo, const std::string &idname)
   return (GameInf*)(it->second->extra);
 }
 
+void StatusNotifier::dumpMetrics()
+{
+  if(data)
+    Misc::Metrics::writeJson(data->repo.getPath("metrics.json"));
+}
+
+/* Start a daemon that picks up the given installs once we have
+   released the repository. Returns false if there is no daemon
+   executable next to ours.
+ */
+static bool startDaemon(const std::string &repoDir,
+                        const std::vector<std::string> &games)
+{
+  namespace bf = boost::filesystem;
+
+  bf::path exe = bf::path(Misc::DirFinder::getExePath()).parent_path();
+#ifdef _WIN32
+  exe /= "tiggit-cli.exe";
+#else
+  exe /= "tiggit-cli";
+#endif
+  if(!bf::exists(exe)) return false;
+
+  std::string cmd = "\"" + exe.string() + "\" --repo \"" + repoDir + "\" daemon";
+  for(int i=0; i<games.size(); i++)
+    cmd += " " + games[i];
+
+  try { Launcher::run(cmd, exe.parent_path().string()); }
+  catch(...) { return false; }
+  return true;
+}
+
 void StatusNotifier::cleanup()
 {
+  // Store final metrics and settings
+  dumpMetrics();
+  if(data) data->repo.flushConfig();
+
+  // Background cache jobs hold on to the repository
+  if(data) data->repo.stopCacheJobs();
+
+  // Installs to continue in the background
+  std::vector<std::string> handoff;
+  std::string repoDir;
+  if(data && data->config.getBackgroundJobs())
+    {
+      repoDir = data->repo.getPath();
+      WatchList::iterator it;
+      for(it = watchList.begin(); it != watchList.end(); it++)
+        if(it->second && !it->second->isFinished())
+          handoff.push_back(it->first);
+    }
+
   // Disable the loop
   data = NULL;
 
@@ -60,6 +117,12 @@ void StatusNotifier::cleanup()
       abort = true;
     }
 
+  if(sizeJob && !sizeJob->isFinished())
+    {
+      sizeJob->abort();
+      abort = true;
+    }
+
   // Abort any other job
   WatchList::iterator it;
   for(it = watchList.begin(); it != watchList.end(); it++)
@@ -76,6 +139,30 @@ void StatusNotifier::cleanup()
   // closes, so a delay before exiting won't disturb the user.
   if(abort)
     wxSleep(1);
+
+  /* The daemon waits for us to release the repository lock, and
+     then starts the aborted installs over again.
+   */
+  if(!handoff.empty())
+    {
+      PRINT("Handing " << handoff.size() << " jobs to daemon");
+      startDaemon(repoDir, handoff);
+    }
+}
+
+void StatusNotifier::resumeJobs(const std::vector<std::string> &games)
+{
+  if(!data) return;
+
+  for(int i=0; i<games.size(); i++)
+    {
+      GameInf *inf = getFromId(data->repo, games[i]);
+
+      // Go through the public wxGameInfo interface, like the GUI does
+      wxTiggit::wxGameInfo *gi = inf;
+      if(inf && inf->info.isUninstalled())
+        gi->installGame();
+    }
 }
 
 void StatusNotifier::reassignJobs()
@@ -105,6 +192,34 @@ void StatusNotifier::tick()
   // anything. So just exit.
   if(!data) return;
 
+  TRACE_SCOPE("StatusNotifier::tick");
+  TRACE_COUNTER("Watched jobs", watchList.size());
+  Misc::Metrics::Timer tm("notifier.tick_us");
+  Misc::Metrics::gauge("notifier.jobs", watchList.size());
+
+  // Dump metrics to disk once in a while
+  time_t now = std::time(NULL);
+  if(difftime(now, lastDump) >= 60)
+    {
+      lastDump = now;
+      dumpMetrics();
+    }
+
+  /* Keep installed game sizes up to date. Only games that changed on
+     disk are rescanned, so this is cheap. Redraw the lists when done,
+     since the sizes are shown there.
+   */
+  if(sizeJob && sizeJob->isFinished())
+    {
+      sizeJob.reset();
+      data->updateDisplayStatus();
+    }
+  else if(!sizeJob && difftime(now, lastSizes) >= 30)
+    {
+      lastSizes = now;
+      sizeJob = data->repo.refreshSizes();
+    }
+
   // Check if we're updating the entire dataset first
   if(updateJob && updateJob->isFinished())
     {
@@ -165,6 +280,7 @@ void StatusNotifier::tick()
         }
 
       // Update the object status
+      inf->sampleProgress();
       inf->updateStatus();
     }
 
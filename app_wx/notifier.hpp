@@ -2,6 +2,9 @@
 #define __WXAPP_NOTIFIER_HPP_
 
 #include <map>
+#include <vector>
+#include <string>
+#include <time.h>
 #include <spread/job/jobinfo.hpp>
 
 /* This is a pretty simple and unelegant notification distributor. We
@@ -24,11 +27,24 @@ namespace wxTigApp
     // finishes, we notify the main loader system.
     Spread::JobInfoPtr updateJob;
 
-    StatusNotifier() : data(0) {}
+    // Background job refreshing the installed game sizes
+    Spread::JobInfoPtr sizeJob;
 
-    // Invoked at program exit
+    // Last time metrics were written to disk, and sizes refreshed
+    time_t lastDump, lastSizes;
+
+    StatusNotifier() : data(0), lastDump(0), lastSizes(0) {}
+
+    /* Invoked at program exit. If "background_jobs" is switched on
+       in the config (see GameConf::getBackgroundJobs()), unfinished
+       installs are restarted from scratch by a background daemon
+       (tiggit-cli daemon). Otherwise they are just aborted.
+     */
     void cleanup();
 
+    // Restart installs that were handed over from a daemon
+    void resumeJobs(const std::vector<std::string> &games);
+
     // Invoked regularly to inspect the watchList
     void tick();
 
@@ -52,6 +68,9 @@ namespace wxTigApp
 
     // Notify the main data object that an item has changed status
     void statusChanged();
+
+    // Write collected metrics to metrics.json in the repository
+    void dumpMetrics();
   };
 
   extern StatusNotifier notify;
@@ -7,6 +7,10 @@
 #include "wx/dialogs.hpp"
 #include <wx/cmdline.h>
 #include "version.hpp"
+#include "misc/trace.hpp"
+#include "misc/logger.hpp"
+#include "tiglib/daemon_client.hpp"
+#include <boost/lexical_cast.hpp>
 
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
@@ -59,6 +63,9 @@ struct TigApp : wxApp
   {
     // Make sure we clean up the notifier on exit
     wxTigApp::notify.cleanup();
+
+    // Write the session trace, if tracing is compiled in
+    TRACE_STOP();
     return wxApp::OnExit();
   }
 
@@ -67,6 +74,9 @@ struct TigApp : wxApp
     if(!wxApp::OnInit())
       return false;
 
+    // Get the last log lines onto disk if we crash
+    Misc::Logger::catchCrashes();
+
     /* TODO: Use this to test the dialog boxes
     {
       wxTiggit::OutputDirDialog dlg1(NULL, "c:\\default\\location", "", false, true);
@@ -141,6 +151,8 @@ struct TigApp : wxApp
 
         PRINT("Final repo dir: " << rep.getPath());
 
+        TRACE_START(rep.getPath("trace.json"));
+
         // Check if there is a newer version installed in the repo. If
         // there is, lauch it and exit.
         {
@@ -163,24 +175,78 @@ struct TigApp : wxApp
           }
 
         PRINT("Initializing repository");
+
+        // Games that a background daemon was installing when we took
+        // over the repository from it
+        std::vector<std::string> resumeGames;
         {
           // Try locking the repository
           bool repOk = rep.initRepo();
 
+          /* The lock is released by the OS the moment its owner is
+             gone, so we can poll for it. A daemon hands the
+             repository over once its jobs have stopped. If we are
+             restarting from within the client itself, the old
+             instance may still be shutting down.
+           */
+          int waitMs = 3000;
+
+          /* Taking over from a daemon aborts its running jobs, even
+             ones started from tiggit-cli, and they are downloaded
+             again from the start. Let the user choose to let them
+             finish first.
+           */
           if(!repOk)
             {
-              // Try waiting a short while. The lock could be the
-              // remains of an exiting process that is still shutting
-              // down, as is typical when we are restarting from
-              // within the client itself.
-              wxSleep(2);
+              TigLib::DaemonClient cli;
+              std::vector<std::string> lines;
+              std::string error;
+              if(cli.connect(rep.getPath()))
+                {
+                  try { cli.request("list working", lines, error); }
+                  catch(...) {}
+                  cli.close();
+                }
+
+              if(!lines.empty())
+                {
+                  std::string games;
+                  for(int i=0; i<lines.size(); i++)
+                    {
+                      TigLib::DaemonStatus st;
+                      if(st.parse(lines[i]))
+                        games += "\n  " + st.idname;
+                    }
+
+                  if(!Boxes::ask("Tiggit is installing games in the background:\n" + games + "\n\nIf you continue, these downloads are stopped and will start over from the beginning. Choose No to let them finish first.\n\nContinue?"))
+                    return false;
+                }
+            }
+
+          if(!repOk && TigLib::DaemonClient::handoff(rep.getPath(), resumeGames))
+            {
+              PRINT("Took over " << resumeGames.size() << " jobs from daemon");
+              waitMs = 10000;
+            }
+          for(int i=0; i<waitMs/100 && !repOk; i++)
+            {
+              wxMilliSleep(100);
               repOk = rep.initRepo();
             }
 
           if(!repOk)
             {
-              // Ask the user
-              if(Boxes::ask("Failed to lock repository: " + rep.getPath() + "\n\nThis usually means that a previous instance of Tiggit crashed. But it MIGHT also mean you are running two instances of Tiggit at once.\n\nAre you SURE you want to continue? If two programs access the repository at the same, data loss may occur!"))
+              int owner = rep.getLockOwner();
+              if(owner)
+                {
+                  // A live process has it. Forcing would never be safe.
+                  Boxes::error("The repository " + rep.getPath() + " is in use by another running instance of Tiggit (process " + boost::lexical_cast<std::string>(owner) + ").\n\nPlease close it and try again.");
+                  return false;
+                }
+
+              // Only readers (such as tiggit-cli) have it open, or the
+              // filesystem doesn't support locking.
+              if(Boxes::ask("The repository " + rep.getPath() + " is being used by another program, such as tiggit-cli.\n\nYou can wait for it to finish, or continue anyway. If two programs change the repository at the same time, data loss may occur!\n\nContinue anyway?"))
                 // The 'true' means override lock
                 repOk = rep.initRepo(true);
               else
@@ -241,6 +307,7 @@ struct TigApp : wxApp
               {
                 // Keep the user informed about what we're doing
                 wxTigApp::JobProgress prog(info);
+                prog.showRate = true;
                 if(!prog.start("Updating data...\nDestination directory: " + rep.getPath()))
                   {
                     if(info->isError())
@@ -281,6 +348,9 @@ struct TigApp : wxApp
         frame->Show(true);
         gameData->frame = frame;
 
+        // Continue where the daemon left off
+        wxTigApp::notify.resumeJobs(resumeGames);
+
         PRINT("last_time: " << rep.getLastTime());
 
         // Check for and act on cleanup instructions.
@@ -0,0 +1,754 @@
+#include "tiglib/repo.hpp"
+#include "tiglib/liveinfo.hpp"
+#include "tiglib/daemon.hpp"
+#include "tiglib/daemon_client.hpp"
+#include "misc/metrics.hpp"
+#include "misc/ratemeter.hpp"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <set>
+#include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace TigLib;
+
+/* Command Line Interface to TigLib.
+
+   Runs without any GUI, so it can be used from scripts, eg. to set up
+   many machines with the same games, and to benchmark the library.
+   Operations on several games can run in parallel, see -j.
+
+   If the repository is held by a running daemon (see
+   tiglib/daemon.hpp), list, install, update and uninstall are passed
+   on to it instead.
+ */
+
+void help()
+{
+  cout << "\ntiggit-cli [options] <command> [parameters]\n\n"
+       << "Commands:\n\n"
+
+       << "    help                        - show this help\n"
+       << "    repo                        - show repository location\n"
+       << "    fetch                       - download the latest game list\n"
+       << "    list [installed|new]        - list games\n"
+       << "    search <words>              - find games by title or tags\n"
+       << "    install <game> ...          - install games\n"
+       << "    outdated                    - list games with a newer version\n"
+       << "    update <game> ... | --all   - update games. --all updates the\n"
+       << "                                  outdated ones, smallest first\n"
+       << "    uninstall <game> ...        - uninstall games\n"
+       << "    verify <game> ... | --all   - check installed games for damage\n"
+       << "    daemon [<game> ...]         - run in the background, serving other\n"
+       << "                                  clients. Installs the given games.\n"
+       << "                                  Jobs are restarted from scratch when\n"
+       << "                                  the repository changes owner.\n"
+       << "    watch                       - show progress of the daemon's jobs\n"
+       << "    stop                        - stop the daemon\n"
+
+       << "\nGames are given by their full id (tiggit.net/name) or just the name.\n"
+
+       << "\nOptions:\n\n"
+       << "    -r, --repo <dir>            - use the repository in <dir>\n"
+       << "    -j, --jobs <n>              - run up to <n> jobs at once (default 1)\n"
+       << "    -a, --all                   - apply to all installed games\n"
+       << "    --repair                    - repair damaged files (verify)\n"
+       << "    --offline                   - don't connect to the net\n"
+       << "    --force-lock                - use the repository even if locked, for\n"
+       << "                                  filesystems without working locks\n"
+       << "    --stats                     - print timing statistics when done\n"
+
+       << "\n\nTiggit is Free Software, licensed under the GNU GPL v3."
+       << "\nSuggestions can be submitted at http://tiggit.net/forum/.\n\n";
+  exit(0);
+}
+
+void fail(const std::string &msg)
+{
+  cerr << msg << endl;
+  exit(1);
+}
+
+enum
+  {
+    NONE = 0,
+    HELP, REPO, FETCH, LIST, SEARCH, INSTALL, UPDATE, UNINSTALL, VERIFY,
+    OUTDATED,
+    DAEMON, WATCH, STOP
+  };
+
+int cmd = NONE;
+vector<string> args;
+
+string repoDir;
+/* One at a time unless asked for more. Parallel jobs only overlap
+   their downloads and file work, their Spread calls take turns (see
+   TigLib::SpreadLock).
+ */
+int maxJobs = 1;
+bool jobsGiven = false;
+bool allGames = false, repair = false, offline = false, forceLock = false,
+  showStats = false;
+
+void parseCmd(const string &str)
+{
+  if(str == "help") cmd = HELP;
+  else if(str == "repo") cmd = REPO;
+  else if(str == "fetch") cmd = FETCH;
+  else if(str == "list") cmd = LIST;
+  else if(str == "search") cmd = SEARCH;
+  else if(str == "install") cmd = INSTALL;
+  else if(str == "update") cmd = UPDATE;
+  else if(str == "outdated") cmd = OUTDATED;
+  else if(str == "uninstall") cmd = UNINSTALL;
+  else if(str == "verify") cmd = VERIFY;
+  else if(str == "daemon") cmd = DAEMON;
+  else if(str == "watch") cmd = WATCH;
+  else if(str == "stop") cmd = STOP;
+  else fail("Unknown command: " + str);
+}
+
+void parseArgs(int argc, char **argv)
+{
+  for(int i=1; i<argc; i++)
+    {
+      string str = argv[i];
+
+      // Options taking a parameter
+      if(str == "-r" || str == "--repo" || str == "-j" || str == "--jobs")
+        {
+          if(i+1 >= argc) fail("Missing parameter for " + str);
+          string val = argv[++i];
+          if(str == "-r" || str == "--repo") repoDir = val;
+          else
+            {
+              maxJobs = atoi(val.c_str());
+              jobsGiven = true;
+              if(maxJobs < 1) fail("Invalid job count: " + val);
+            }
+        }
+      else if(str == "-a" || str == "--all") allGames = true;
+      else if(str == "--repair") repair = true;
+      else if(str == "--offline") offline = true;
+      else if(str == "--force-lock") forceLock = true;
+      else if(str == "--stats") showStats = true;
+      else if(str == "-h" || str == "--help") help();
+      else if(str[0] == '-') fail("Unknown option: " + str);
+      else if(cmd == NONE) parseCmd(str);
+      else args.push_back(str);
+    }
+}
+
+Repo repo;
+DaemonClient client;
+
+string lower(string s)
+{
+  std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+  return s;
+}
+
+string sizeStr(int64_t bytes)
+{
+  char buf[50];
+  snprintf(buf, sizeof(buf), "%.1f MB", bytes/(1024.0*1024));
+  return buf;
+}
+
+/* Lock the repository. Commands that only read take a shared lock,
+   so they can run alongside each other. Returns false if the
+   repository is held by a running daemon, in which case 'client' is
+   connected to it.
+ */
+bool openRepo()
+{
+  if(repoDir != "")
+    repo.setRepo(repoDir);
+  else if(!repo.findRepo())
+    fail("No repository found. Use --repo to specify one.");
+
+  bool readOnly = !forceLock &&
+    (cmd == LIST || cmd == SEARCH || cmd == OUTDATED ||
+     (cmd == VERIFY && !repair));
+
+  if(readOnly && !boost::filesystem::is_directory(repo.getPath()))
+    fail("No repository at " + repo.getPath() + ".");
+
+  /* A daemon started by an exiting GUI has to wait for the GUI to
+     release the lock. The OS drops the lock the moment the GUI is
+     gone, so just poll for it.
+   */
+  int64_t until = Misc::Metrics::now() + (cmd == DAEMON ? 20000000 : 0);
+  while(true)
+    {
+      if(readOnly ? repo.initRepoReadOnly() : repo.initRepo(forceLock))
+        return true;
+      if(Misc::Metrics::now() >= until) break;
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    }
+
+  if(client.connect(repo.getPath()))
+    return false;
+
+  int owner = repo.getLockOwner();
+  if(owner)
+    {
+      ostringstream msg;
+      msg << "The repository at " << repo.getPath() << " is in use by\n"
+          << "process " << owner << ".";
+      fail(msg.str());
+    }
+  fail("The repository at " + repo.getPath() + " is being read by other\n"
+       "processes. Try again when they are done.");
+  return false;
+}
+
+// Wait for a job, printing progress. Returns true on success.
+bool waitFor(Spread::JobInfoPtr info, const string &what)
+{
+  if(!info) return true;
+
+  while(!info->isFinished())
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+      if(info->getTotal() > 0)
+        fprintf(stderr, "\r%s: %3d%%", what.c_str(),
+                (int)(info->getCurrent()*100.0/info->getTotal()));
+    }
+  fprintf(stderr, "\r%s: done      \n", what.c_str());
+
+  if(!info->isSuccess())
+    cerr << what << " failed: " << info->getMessage() << endl;
+  return info->isSuccess();
+}
+
+void loadData(bool fetch)
+{
+  if(fetch && !repo.offline)
+    waitFor(repo.fetchFiles(false, true), "Fetching game data");
+
+  repo.loadData();
+  repo.doneLoading();
+}
+
+// Find a game by full id or by name. Returns NULL if not found.
+LiveInfo *findGame(const string &name)
+{
+  const InfoLookup &list = repo.getList();
+  InfoLookup::const_iterator it = list.find(name);
+  if(it != list.end()) return it->second;
+
+  for(it = list.begin(); it != list.end(); it++)
+    if(it->second->ent->urlname == name)
+      return it->second;
+  return NULL;
+}
+
+// Resolve the command line arguments (or --all) into a list of games
+vector<LiveInfo*> getGames(bool installedOnly)
+{
+  vector<LiveInfo*> res;
+  if(allGames)
+    {
+      const InfoLookup &list = repo.getList();
+      InfoLookup::const_iterator it;
+      for(it = list.begin(); it != list.end(); it++)
+        if(it->second->isInstalled())
+          res.push_back(it->second);
+      return res;
+    }
+
+  if(args.empty()) fail("No games given");
+
+  set<LiveInfo*> seen;
+  for(int i=0; i<args.size(); i++)
+    {
+      LiveInfo *inf = findGame(args[i]);
+      if(!inf) fail("Unknown game: " + args[i]);
+      if(installedOnly && !inf->isInstalled())
+        fail("Not installed: " + args[i]);
+      if(seen.insert(inf).second)
+        res.push_back(inf);
+    }
+  return res;
+}
+
+void printGame(const LiveInfo *inf)
+{
+  string status = inf->isInstalled() ? "installed" :
+    inf->isWorking() ? "working" : "-";
+  printf("%-40s %-10s %s\n", inf->ent->idname.c_str(), status.c_str(),
+         inf->ent->title.c_str());
+}
+
+void doList()
+{
+  string filter = args.empty() ? "" : args[0];
+  if(filter != "" && filter != "installed" && filter != "new")
+    fail("Unknown list: " + filter);
+
+  const InfoLookup &list = repo.getList();
+  InfoLookup::const_iterator it;
+  for(it = list.begin(); it != list.end(); it++)
+    {
+      const LiveInfo *inf = it->second;
+      if(filter == "installed" && !inf->isInstalled()) continue;
+      if(filter == "new" && !inf->isNew()) continue;
+      printGame(inf);
+    }
+}
+
+void doSearch()
+{
+  if(args.empty()) fail("Nothing to search for");
+
+  vector<string> words;
+  for(int i=0; i<args.size(); i++)
+    words.push_back(lower(args[i]));
+
+  const InfoLookup &list = repo.getList();
+  InfoLookup::const_iterator it;
+  for(it = list.begin(); it != list.end(); it++)
+    {
+      const TigData::TigEntry *ent = it->second->ent;
+      string text = lower(ent->idname + " " + ent->title + " " + ent->tags);
+
+      bool match = true;
+      for(int i=0; i<words.size() && match; i++)
+        match = text.find(words[i]) != string::npos;
+      if(match) printGame(it->second);
+    }
+}
+
+/* One operation on one game. Tasks are started up to 'maxJobs' at a
+   time, and run in parallel in the background.
+ */
+struct Task
+{
+  LiveInfo *game;
+  Spread::JobInfoPtr info;
+  Misc::Verify::Report report;
+  int64_t start, time;
+  bool done;
+
+  Task(LiveInfo *g) : game(g), start(0), time(0), done(false) {}
+};
+
+Spread::JobInfoPtr startTask(Task &t)
+{
+  switch(cmd)
+    {
+    case INSTALL: return t.game->install(true);
+    case UPDATE: return t.game->update(true);
+    case UNINSTALL: return t.game->uninstall(true);
+    case VERIFY: return t.game->verify(&t.report, repair, true);
+    }
+  assert(0);
+  return Spread::JobInfoPtr();
+}
+
+// Print the result of a finished task. Returns true on success.
+bool report(const Task &t)
+{
+  const string &id = t.game->ent->idname;
+  double secs = t.time / 1000000.0;
+  bool ok = !t.info || t.info->isSuccess();
+
+  if(!ok)
+    {
+      printf("[failed] %s: %s\n", id.c_str(),
+             t.info->isAbort() ? "aborted" : t.info->getMessage().c_str());
+      return false;
+    }
+
+  if(cmd == VERIFY)
+    {
+      const Misc::Verify::Report &r = t.report;
+
+      // Nothing to compare against, so nothing was verified
+      if(r.baseline)
+        {
+          printf("[unverified] %s: no reference, recorded %d files as the "
+                 "baseline%s\n", id.c_str(), (int)r.files,
+                 repo.isReadOnly() ? " (not saved)" : "");
+          return true;
+        }
+
+      printf("[%s] %s: %d files, %s, %.1fs", r.isOk() ? "ok" : "damaged",
+             id.c_str(), (int)r.files, sizeStr(r.bytes).c_str(), secs);
+      if(!r.isOk())
+        printf(", %d changed, %d missing", (int)r.changed.size(),
+               (int)r.missing.size());
+      if(r.repaired)
+        printf(", %d repaired", (int)r.repaired);
+      printf("\n");
+      return r.isOk();
+    }
+
+  printf("[ok] %s (%.1fs)\n", id.c_str(), secs);
+  return true;
+}
+
+// Run the current command on all the given games. Returns the number
+// of failures.
+int runTasks(const vector<LiveInfo*> &games)
+{
+  // Tasks must not move once started, since jobs hold pointers into
+  // them.
+  vector<Task> tasks;
+  tasks.reserve(games.size());
+  for(int i=0; i<games.size(); i++)
+    tasks.push_back(Task(games[i]));
+
+  int next = 0, running = 0, finished = 0, failed = 0;
+  Misc::RateMeter meter;
+  while(finished < tasks.size())
+    {
+      // Fill up the free slots
+      while(running < maxJobs && next < tasks.size())
+        {
+          Task &t = tasks[next++];
+          t.start = Misc::Metrics::now();
+          t.info = startTask(t);
+          running++;
+        }
+
+      // Collect finished tasks, and sum up the progress of the rest
+      int64_t cur = 0, total = 0;
+      for(int i=0; i<next; i++)
+        {
+          Task &t = tasks[i];
+          if(t.done) continue;
+
+          if(t.info && !t.info->isFinished())
+            {
+              cur += t.info->getCurrent();
+              total += t.info->getTotal();
+              continue;
+            }
+
+          t.done = true;
+          t.time = Misc::Metrics::now() - t.start;
+          running--;
+          finished++;
+          fprintf(stderr, "\r%60s\r", "");
+          if(!report(t)) failed++;
+        }
+
+      if(finished == tasks.size()) break;
+
+      meter.update(cur);
+      fprintf(stderr, "\r%d/%d done, %d running", finished,
+              (int)tasks.size(), running);
+      if(total > 0)
+        fprintf(stderr, ", %s, %s left   ", meter.rateString().c_str(),
+                Misc::RateMeter::etaString(meter.getETA(cur, total)).c_str());
+      fflush(stderr);
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+    }
+
+  return failed;
+}
+
+// Print games with a newer version available, and return them
+vector<UpdateInfo> doOutdated()
+{
+  vector<string> unknown;
+  vector<UpdateInfo> list = repo.checkUpdates(&unknown);
+  for(int i=0; i<list.size(); i++)
+    {
+      const UpdateInfo &u = list[i];
+      printf("%-40s %s -> %s (%s)\n", u.idname.c_str(), u.installed.c_str(),
+             u.available.c_str(), sizeStr(u.size).c_str());
+    }
+  if(!unknown.empty())
+    cerr << unknown.size() << " installed games have no recorded version. "
+         << "Update them by name\nto record it.\n";
+  return list;
+}
+
+/* Update all outdated games, using Repo::updateGames(). That runs
+   fewer jobs at once than runTasks(), since they all download, and
+   orders them by size. Returns the number of failures.
+ */
+int updateAll()
+{
+  vector<UpdateInfo> list = doOutdated();
+  if(list.empty())
+    {
+      cout << "Everything is up to date\n";
+      return 0;
+    }
+
+  Spread::JobInfoPtr info = jobsGiven ? repo.updateGames(&list, maxJobs)
+                                      : repo.updateGames(&list);
+  int failed = 0;
+  vector<bool> shown(list.size());
+  while(true)
+    {
+      bool finished = info->isFinished();
+
+      // Report games as they finish
+      int done = 0;
+      for(int i=0; i<list.size(); i++)
+        {
+          const UpdateInfo &u = list[i];
+          if(!u.done) continue;
+          done++;
+          if(shown[i]) continue;
+          shown[i] = true;
+
+          fprintf(stderr, "\r%60s\r", "");
+          if(u.error == "")
+            printf("[ok] %s %s\n", u.idname.c_str(), u.available.c_str());
+          else
+            {
+              printf("[failed] %s: %s\n", u.idname.c_str(), u.error.c_str());
+              failed++;
+            }
+        }
+
+      if(finished) break;
+
+      fprintf(stderr, "\r%d/%d updated", done, (int)list.size());
+      fflush(stderr);
+      boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+    }
+
+  // Games never started count as failed too
+  for(int i=0; i<list.size(); i++)
+    if(!list[i].done)
+      {
+        printf("[failed] %s: not started\n", list[i].idname.c_str());
+        failed++;
+      }
+
+  return failed;
+}
+
+// Send a request to the daemon, and fail on errors
+vector<string> remote(const string &req)
+{
+  vector<string> lines;
+  string error;
+  if(!client.request(req, lines, error))
+    fail(error);
+  return lines;
+}
+
+void printStatus(const DaemonStatus &st)
+{
+  string msg = st.message;
+  if(st.state == "working" && st.total > 0)
+    {
+      char buf[20];
+      snprintf(buf, sizeof(buf), "%3d%% ", (int)(st.current*100.0/st.total));
+      msg = buf + msg;
+    }
+  printf("%-40s %-10s %s\n", st.idname.c_str(), st.state.c_str(), msg.c_str());
+}
+
+// Run the current command through the daemon. Returns the number of
+// failures.
+int runRemote()
+{
+  DaemonStatus st;
+
+  if(cmd == LIST)
+    {
+      string filter = args.empty() ? "" : args[0];
+      if(filter == "new")
+        fail("Can't list new games while the daemon is running");
+      vector<string> lines = remote("list " + filter);
+      for(int i=0; i<lines.size(); i++)
+        if(st.parse(lines[i])) printStatus(st);
+      return 0;
+    }
+
+  if(cmd == WATCH)
+    {
+      client.send("watch");
+      string line;
+      while(client.readLine(line))
+        if(st.parse(line)) printStatus(st);
+      return 0;
+    }
+
+  if(cmd == OUTDATED)
+    {
+      vector<string> lines = remote("outdated");
+      for(int i=0; i<lines.size(); i++)
+        if(st.parse(lines[i])) printStatus(st);
+      return 0;
+    }
+
+  if(cmd == STOP)
+    {
+      remote("shutdown");
+      cout << "Daemon stopped\n";
+      return 0;
+    }
+
+  if(cmd != INSTALL && cmd != UPDATE && cmd != UNINSTALL)
+    fail("The repository is in use by the daemon. Stop it first with\n"
+         "'tiggit-cli stop'.");
+
+  vector<string> games = args;
+  if(allGames)
+    {
+      // Only update what is out of date
+      games.clear();
+      vector<string> lines = remote(cmd == UPDATE ? "outdated" : "list installed");
+      for(int i=0; i<lines.size(); i++)
+        if(st.parse(lines[i])) games.push_back(st.idname);
+    }
+  else if(games.empty()) fail("No games given");
+
+  string name = cmd == INSTALL ? "install" : cmd == UPDATE ? "update" : "uninstall";
+  int64_t start = Misc::Metrics::now();
+  int failed = 0;
+
+  // The daemon runs all the jobs at once. Start them, and follow them
+  // until they are done.
+  vector<string> running;
+  for(int i=0; i<games.size(); i++)
+    {
+      vector<string> lines;
+      string error;
+      if(client.request(name + " " + games[i], lines, error) &&
+         !lines.empty() && st.parse(lines[0]))
+        running.push_back(st.idname);
+      else
+        {
+          printf("[failed] %s: %s\n", games[i].c_str(), error.c_str());
+          failed++;
+        }
+    }
+
+  while(!running.empty())
+    {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+      vector<string> left;
+      for(int i=0; i<running.size(); i++)
+        {
+          vector<string> lines = remote("status " + running[i]);
+          if(lines.empty() || !st.parse(lines[0])) continue;
+
+          if(st.state == "working")
+            left.push_back(running[i]);
+          else if(st.state == "failed")
+            {
+              fprintf(stderr, "\r%30s\r", "");
+              printf("[failed] %s: %s\n", st.idname.c_str(), st.message.c_str());
+              failed++;
+            }
+          else
+            {
+              fprintf(stderr, "\r%30s\r", "");
+              printf("[ok] %s\n", st.idname.c_str());
+            }
+        }
+      running.swap(left);
+      if(!running.empty())
+        fprintf(stderr, "\r%d running", (int)running.size());
+    }
+
+  printf("%d succeeded, %d failed in %.1fs\n",
+         (int)games.size() - failed, failed,
+         (Misc::Metrics::now() - start) / 1000000.0);
+  return failed;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc < 2)
+    help();
+
+  parseArgs(argc, argv);
+  if(cmd == NONE || cmd == HELP)
+    help();
+
+  repo.offline = offline;
+  int64_t start = Misc::Metrics::now();
+
+  if(cmd == REPO)
+    {
+      if(repoDir != "") repo.setRepo(repoDir);
+      else if(!repo.findRepo())
+        fail("No default repository found.");
+      cout << repo.getPath() << endl;
+      return 0;
+    }
+
+  if(!openRepo())
+    return runRemote() ? 1 : 0;
+
+  if(cmd == WATCH || cmd == STOP)
+    fail("No daemon is running");
+
+  int failed = 0;
+  if(cmd == DAEMON)
+    {
+      loadData(true);
+
+      Daemon daemon(repo);
+      daemon.start();
+      daemon.resume(args);
+      cout << "Serving " << repo.getPath() << "\n"
+           << "Use 'tiggit-cli stop' to exit.\n";
+      daemon.run();
+    }
+  else if(cmd == FETCH)
+    {
+      if(offline) fail("Can't fetch in offline mode");
+      if(!waitFor(repo.fetchFiles(true, true), "Fetching game data"))
+        failed = 1;
+    }
+  else
+    {
+      // Listing doesn't need the very latest data
+      loadData(!repo.isReadOnly() && (cmd == INSTALL || cmd == UPDATE));
+
+      if(cmd == LIST) doList();
+      else if(cmd == SEARCH) doSearch();
+      else if(cmd == OUTDATED) doOutdated();
+      else if(cmd == UPDATE && allGames)
+        {
+          failed = updateAll();
+          printf("%d failed in %.1fs\n", failed,
+                 (Misc::Metrics::now() - start) / 1000000.0);
+        }
+      else
+        {
+          vector<LiveInfo*> games = getGames(cmd != INSTALL);
+          if(cmd == INSTALL)
+            {
+              // Skip what's already there
+              vector<LiveInfo*> todo;
+              for(int i=0; i<games.size(); i++)
+                if(games[i]->isUninstalled()) todo.push_back(games[i]);
+                else cout << "Already installed: " << games[i]->ent->idname << endl;
+              games = todo;
+            }
+          failed = runTasks(games);
+
+          printf("%d succeeded, %d failed in %.1fs\n",
+                 (int)games.size() - failed, failed,
+                 (Misc::Metrics::now() - start) / 1000000.0);
+        }
+    }
+
+  repo.flushConfig();
+  if(showStats)
+    cerr << "\n" << Misc::Metrics::toText();
+
+  return failed ? 1 : 0;
+}
@@ -2,7 +2,8 @@
 
 #include <stdexcept>
 
-void noImpl(const std::string &command, const std::string &workdir = "")
+void noImpl(const std::string &command, const std::string &workdir = "",
+            Launcher::ReadyFunc onReady = Launcher::ReadyFunc())
 {
   throw std::runtime_error("Cannot run " + command + ": Launching is not yet implemented on this platform");
 }
@@ -18,3 +19,9 @@ void Launcher::run(const std::string &command, const std::string &workdir)
 {
   RUN (command, workdir);
 }
+
+void Launcher::run(const std::string &command, const std::string &workdir,
+                   ReadyFunc onReady)
+{
+  RUN (command, workdir, onReady);
+}
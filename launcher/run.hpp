@@ -2,13 +2,28 @@
 #define __LAUNCHER_RUN_HPP_
 
 #include <string>
+#include <stdint.h>
+#include <boost/function.hpp>
 
 namespace Launcher
 {
+  /* Called once the started program is ready for input, with the
+     time (in microseconds) it took to get there, or -1 if we couldn't
+     tell. Called from a background thread.
+   */
+  typedef boost::function<void(int64_t)> ReadyFunc;
+
   /* Run the given command in the specified working directory. If no
      dir is specified, use the current process' working dir.
    */
   void run(const std::string &command, const std::string &workdir = "");
+
+  /* Same as above, but also time the program until it is ready for
+     input. Only Windows can tell us that, elsewhere onReady is never
+     called.
+   */
+  void run(const std::string &command, const std::string &workdir,
+           ReadyFunc onReady);
 }
 
 #endif
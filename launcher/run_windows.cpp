@@ -44,7 +44,39 @@ static bool iends(const std::string &str, const std::string &ending)
   return true;
 }
 
-void Launcher::win32_run(const std::string &command, const std::string &workdir)
+struct ReadyWait
+{
+  HANDLE proc;
+  LARGE_INTEGER start;
+  Launcher::ReadyFunc onReady;
+};
+
+// Wait for the new process to finish starting up, then report how
+// long it took
+static DWORD WINAPI waitReady(LPVOID param)
+{
+  ReadyWait *rw = (ReadyWait*)param;
+
+  // Only works for programs with a message loop. Console programs and
+  // some fullscreen games fail right away.
+  int64_t usecs = -1;
+  if(WaitForInputIdle(rw->proc, 120000) == 0)
+    {
+      LARGE_INTEGER now, freq;
+      QueryPerformanceCounter(&now);
+      QueryPerformanceFrequency(&freq);
+      usecs = (now.QuadPart - rw->start.QuadPart) * 1000000 / freq.QuadPart;
+    }
+
+  CloseHandle(rw->proc);
+  try { rw->onReady(usecs); }
+  catch(...) {}
+  delete rw;
+  return 0;
+}
+
+void Launcher::win32_run(const std::string &command, const std::string &workdir,
+                         ReadyFunc onReady)
 {
   // Check if the command is a .bat file
   if(iends(command, ".bat"))
@@ -62,6 +94,9 @@ void Launcher::win32_run(const std::string &command, const std::string &workdir)
   ZeroMemory(&si, sizeof(si));
   si.cb = sizeof(si);
 
+  LARGE_INTEGER start;
+  QueryPerformanceCounter(&start);
+
   bool ok =
     CreateProcess(NULL, (char*)command.c_str(), NULL, NULL, false,
                   DETACHED_PROCESS, NULL,
@@ -76,8 +111,25 @@ void Launcher::win32_run(const std::string &command, const std::string &workdir)
       throw std::runtime_error(err);
     }
 
+  if(onReady)
+    {
+      ReadyWait *rw = new ReadyWait;
+      rw->proc = pi.hProcess;
+      rw->start = start;
+      rw->onReady = onReady;
+
+      HANDLE th = CreateThread(NULL, 0, waitReady, rw, 0, NULL);
+      if(th)
+        {
+          // The thread owns the process handle now
+          CloseHandle(th);
+          pi.hProcess = NULL;
+        }
+      else delete rw;
+    }
+
   // We don't need to keep track of the process
-  CloseHandle(pi.hProcess);
+  if(pi.hProcess) CloseHandle(pi.hProcess);
   CloseHandle(pi.hThread);
 }
 #endif
@@ -3,11 +3,12 @@
 
 #ifdef _WIN32
 
-#include <string>
+#include "run.hpp"
 
 namespace Launcher
 {
-  void win32_run(const std::string &command, const std::string &workdir = "");
+  void win32_run(const std::string &command, const std::string &workdir = "",
+                 ReadyFunc onReady = ReadyFunc());
 }
 
 #endif
@@ -1,9 +1,13 @@
 #include "listbase.hpp"
+#include "misc/trace.hpp"
+#include "misc/metrics.hpp"
 
 using namespace List;
 
 void ListBase::updateChildren()
 {
+  TRACE_SCOPE("List::updateChildren");
+  Misc::Metrics::Timer tm("list.update_us");
   updateList();
   std::set<ParentBase*>::iterator it;
   for(it = children.begin(); it != children.end(); it++)
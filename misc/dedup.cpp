@@ -0,0 +1,242 @@
+#include "dedup.hpp"
+#include "filecopy.hpp"
+#include "filehash.hpp"
+#include "hashcache.hpp"
+
+#include <map>
+#include <boost/filesystem.hpp>
+
+#ifdef __linux__
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+using namespace Misc;
+using namespace Misc::Dedup;
+namespace bf = boost::filesystem;
+
+// Smallest file size worth looking at
+#define MIN_SIZE 4096
+
+typedef std::vector<std::string> StrList;
+
+#ifdef __linux__
+
+// Closes the file on scope exit
+struct FD
+{
+  int fd;
+  FD(int _fd) : fd(_fd) {}
+  ~FD() { if(fd != -1) close(fd); }
+};
+
+typedef std::vector<struct fiemap_extent> Extents;
+
+/* Get the physical extents of a file. Returns false if they can't be
+   read, or if any of them don't have a known location.
+ */
+static bool getExtents(const std::string &file, Extents &out)
+{
+  FD f(open(file.c_str(), O_RDONLY));
+  if(f.fd == -1) return false;
+
+  /* No FIEMAP_FLAG_SYNC. It would force a writeback of every file we
+     look at, and files we reflinked ourselves had their data flushed
+     by the clone already.
+   */
+  struct fiemap head;
+  memset(&head, 0, sizeof(head));
+  head.fm_length = ~0ULL;
+
+  // With no room for extents, this just counts them
+  if(ioctl(f.fd, FS_IOC_FIEMAP, &head) != 0 || head.fm_mapped_extents == 0)
+    return false;
+
+  int count = head.fm_mapped_extents;
+  std::vector<uint64_t> buf((sizeof(struct fiemap) +
+                             count*sizeof(struct fiemap_extent))/8 + 1);
+  struct fiemap *map = (struct fiemap*)&buf[0];
+  map->fm_length = ~0ULL;
+  map->fm_extent_count = count;
+
+  if(ioctl(f.fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0)
+    return false;
+
+  const uint32_t unknown = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+    FIEMAP_EXTENT_DATA_INLINE;
+
+  out.clear();
+  for(int i=0; i<map->fm_mapped_extents; i++)
+    {
+      const struct fiemap_extent &e = map->fm_extents[i];
+      if(e.fe_flags & unknown) return false;
+      out.push_back(e);
+    }
+
+  // The file changed between the two calls
+  return (out.back().fe_flags & FIEMAP_EXTENT_LAST) != 0;
+}
+
+/* Returns true if 'dup' already shares storage with 'master'. Used to
+   keep repeated runs from relinking (and re-counting) the same
+   files. Only counts if all of dup's data is in the same place as
+   master's. Being shared with some other file (a snapshot, or a
+   reflink from the file cache) doesn't count.
+ */
+static bool alreadyLinked(const std::string &master, const std::string &dup)
+{
+  struct stat s1, s2;
+  if(stat(master.c_str(), &s1) != 0 || stat(dup.c_str(), &s2) != 0)
+    return false;
+
+  // Hardlinked, by an older version or by the user
+  if(s1.st_dev == s2.st_dev && s1.st_ino == s2.st_ino)
+    return true;
+
+  if(s1.st_dev != s2.st_dev)
+    return false;
+
+  Extents e1, e2;
+  if(!getExtents(master, e1) || !getExtents(dup, e2) ||
+     e1.size() != e2.size())
+    return false;
+
+  for(int i=0; i<e1.size(); i++)
+    if(e1[i].fe_logical != e2[i].fe_logical ||
+       e1[i].fe_physical != e2[i].fe_physical ||
+       e1[i].fe_length != e2[i].fe_length)
+      return false;
+
+  return true;
+}
+
+/* Replace 'dup' with a reflink of 'master'. The new file is made
+   under a temporary name and then renamed over the old one, so 'dup'
+   is never missing or half-written.
+ */
+static bool reflink(const std::string &master, const std::string &dup)
+{
+  struct stat st;
+  if(stat(dup.c_str(), &st) != 0) return false;
+
+  std::string tmp = dup + ".tigdedup";
+  FD in(open(master.c_str(), O_RDONLY));
+  if(in.fd == -1) return false;
+
+  bool ok;
+  {
+    FD out(open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 07777));
+    if(out.fd == -1) return false;
+    ok = ioctl(out.fd, FICLONE, in.fd) == 0;
+
+    // Keep the original time stamps
+    if(ok)
+      {
+        struct timespec times[2];
+        times[0] = st.st_atim;
+        times[1] = st.st_mtim;
+        futimens(out.fd, times);
+      }
+  }
+
+  if(ok && rename(tmp.c_str(), dup.c_str()) == 0)
+    return true;
+
+  unlink(tmp.c_str());
+  return false;
+}
+
+#else
+
+static bool alreadyLinked(const std::string&, const std::string&) { return false; }
+static bool reflink(const std::string&, const std::string&) { return false; }
+
+#endif
+
+// Handle a set of files with equal size and hash
+static void linkGroup(const StrList &files, int64_t size, Mode mode,
+                      Report &rep)
+{
+  const std::string &master = files[0];
+  for(int i=1; i<files.size(); i++)
+    {
+      const std::string &dup = files[i];
+      try
+        {
+          if(alreadyLinked(master, dup)) continue;
+          if(!sameContent(master, dup)) continue;
+        }
+      catch(...) { continue; }
+
+      rep.dupes++;
+      rep.dupeBytes += size;
+
+      if(mode == DRY_RUN) continue;
+
+      if(reflink(master, dup))
+        {
+          rep.linked++;
+          rep.savedBytes += size;
+        }
+    }
+}
+
+bool Dedup::run(const StrList &dirs, Mode mode, Report &rep,
+                ProgressFunc progress)
+{
+  // List all files, grouped by size
+  std::map<int64_t, StrList> sizes;
+  for(int i=0; i<dirs.size(); i++)
+    {
+      if(!bf::is_directory(dirs[i])) continue;
+
+      std::vector<FileCopy::FileInfo> files;
+      FileCopy::index(dirs[i], files);
+      rep.files += files.size();
+
+      for(int k=0; k<files.size(); k++)
+        if(files[k].size >= MIN_SIZE)
+          sizes[files[k].size].push_back((bf::path(dirs[i])/files[k].name).string());
+    }
+
+  // Only files that share their size with another file need hashing
+  int64_t total = 0, done = 0;
+  std::map<int64_t, StrList>::iterator it;
+  for(it = sizes.begin(); it != sizes.end(); it++)
+    if(it->second.size() > 1)
+      total += it->second.size();
+
+  for(it = sizes.begin(); it != sizes.end(); it++)
+    {
+      const StrList &list = it->second;
+      if(list.size() < 2) continue;
+
+      std::map<uint64_t, StrList> hashes;
+      for(int i=0; i<list.size(); i++)
+        {
+          if(progress && !progress(done, total))
+            return false;
+          done++;
+
+          try { hashes[HashCache::hashFile(list[i])].push_back(list[i]); }
+          catch(...) {}
+        }
+
+      std::map<uint64_t, StrList>::iterator hit;
+      for(hit = hashes.begin(); hit != hashes.end(); hit++)
+        if(hit->second.size() > 1)
+          linkGroup(hit->second, it->first, mode, rep);
+    }
+
+  if(progress) progress(total, total);
+  return true;
+}
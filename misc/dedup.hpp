@@ -0,0 +1,72 @@
+#ifndef __MISC_DEDUP_HPP_
+#define __MISC_DEDUP_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/function.hpp>
+
+/* Find identical files in a set of directories, and make them share
+   their disk space.
+
+   Many games bundle the same runtimes and libraries, so a repository
+   with lots of installed games often contains many copies of the same
+   files.
+
+   Files are matched by size and content hash, and always compared
+   byte by byte before being linked. Very small files are ignored,
+   since they don't save enough space to be worth it.
+
+   Linking is currently only implemented on Linux. Elsewhere all
+   modes behave like DRY_RUN.
+ */
+
+namespace Misc
+{
+  namespace Dedup
+  {
+    enum Mode
+      {
+        /* Only find and report duplicates, don't change anything. */
+        DRY_RUN,
+
+        /* Reflink duplicates (btrfs, XFS and other copy-on-write
+           filesystems.) The files share data blocks, but writing to
+           one of them gives it its own copy, so this is always safe.
+           Files on filesystems without reflink support are left
+           alone.
+
+           There is deliberately no hardlink fallback. Hardlinked files
+           are one and the same file, so a game rewriting its config
+           or save files in place would change every other copy.
+        */
+        REFLINK
+      };
+
+    struct Report
+    {
+      // Number of files examined
+      int64_t files;
+
+      // Number of duplicates found, and how many of them we linked
+      int64_t dupes, linked;
+
+      // Bytes held by duplicate files, and bytes actually reclaimed
+      int64_t dupeBytes, savedBytes;
+
+      Report() : files(0), dupes(0), linked(0), dupeBytes(0), savedBytes(0) {}
+    };
+
+    // Called with (files done, files total). Return false to abort.
+    typedef boost::function<bool(int64_t,int64_t)> ProgressFunc;
+
+    /* Deduplicate all files within the given directories, across
+       directory boundaries. Non-existing directories are
+       ignored. Returns false if aborted.
+     */
+    bool run(const std::vector<std::string> &dirs, Mode mode,
+             Report &report, ProgressFunc progress = ProgressFunc());
+  }
+}
+
+#endif
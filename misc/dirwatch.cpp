@@ -0,0 +1,184 @@
+#include "dirwatch.hpp"
+
+#include <map>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+#ifdef __linux__
+
+#define EVENTS (IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM |     \
+                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef std::map<std::string, std::vector<int> > KeyMap;
+
+struct DirWatch::_Internal
+{
+  boost::mutex mutex;
+  int fd;
+
+  // Watch descriptors to keys and directories, and keys to all their
+  // descriptors.
+  std::map<int, std::string> keys, dirs;
+  KeyMap wds;
+
+  std::set<std::string> changed;
+
+  _Internal() { fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); }
+  ~_Internal() { if(fd != -1) close(fd); }
+
+  bool watchOne(const std::string &key, const bf::path &dir)
+  {
+    int wd = inotify_add_watch(fd, dir.string().c_str(), EVENTS);
+    if(wd == -1) return false;
+    keys[wd] = key;
+    dirs[wd] = dir.string();
+    wds[key].push_back(wd);
+    return true;
+  }
+
+  // Watch a directory and everything below it
+  bool watchTree(const std::string &key, const bf::path &dir)
+  {
+    if(fd == -1 || !watchOne(key, dir)) return false;
+
+    try
+      {
+        bf::recursive_directory_iterator iter(dir), end;
+        for(; iter != end; ++iter)
+          if(bf::is_directory(iter->symlink_status()) &&
+             !watchOne(key, iter->path()))
+            return false;
+      }
+    catch(...) { return false; }
+
+    return true;
+  }
+
+  void unwatch(const std::string &key)
+  {
+    KeyMap::iterator it = wds.find(key);
+    if(it == wds.end()) return;
+
+    const std::vector<int> &list = it->second;
+    for(int i=0; i<list.size(); i++)
+      {
+        inotify_rm_watch(fd, list[i]);
+        keys.erase(list[i]);
+        dirs.erase(list[i]);
+      }
+    wds.erase(it);
+  }
+
+  void handle(const struct inotify_event *ev)
+  {
+    // Events were lost, so assume everything has changed
+    if(ev->mask & IN_Q_OVERFLOW)
+      {
+        for(KeyMap::iterator it = wds.begin(); it != wds.end(); it++)
+          changed.insert(it->first);
+        return;
+      }
+
+    std::map<int, std::string>::iterator it = keys.find(ev->wd);
+    if(it == keys.end()) return;
+    const std::string key = it->second;
+
+    // The kernel dropped the watch, because the directory is gone
+    if(ev->mask & IN_IGNORED)
+      {
+        keys.erase(ev->wd);
+        dirs.erase(ev->wd);
+        return;
+      }
+
+    changed.insert(key);
+
+    /* Follow new subdirectories. If this fails (eg. because we hit
+       the watch limit) the new directory just goes unwatched. The
+       tree is already marked as changed, so nothing is missed right
+       now.
+     */
+    if((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) &&
+       ev->len > 0)
+      watchTree(key, bf::path(dirs[ev->wd]) / ev->name);
+  }
+
+  void readEvents()
+  {
+    if(fd == -1) return;
+
+    char buf[16*1024]
+      __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    while(true)
+      {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if(len <= 0) break;
+
+        for(char *p = buf; p < buf + len;)
+          {
+            const struct inotify_event *ev = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + ev->len;
+            handle(ev);
+          }
+      }
+  }
+};
+
+#else
+
+struct DirWatch::_Internal
+{
+  boost::mutex mutex;
+  std::set<std::string> changed, wds;
+
+  bool watchTree(const std::string&, const bf::path&) { return false; }
+  void unwatch(const std::string&) {}
+  void readEvents() {}
+};
+
+#endif
+
+DirWatch::DirWatch() : ptr(new _Internal) {}
+
+bool DirWatch::add(const std::string &key, const std::string &dir)
+{
+  boost::lock_guard<boost::mutex> lock(ptr->mutex);
+  ptr->unwatch(key);
+  if(ptr->watchTree(key, dir))
+    return true;
+
+  ptr->unwatch(key);
+  return false;
+}
+
+void DirWatch::remove(const std::string &key)
+{
+  boost::lock_guard<boost::mutex> lock(ptr->mutex);
+  ptr->unwatch(key);
+  ptr->changed.erase(key);
+}
+
+bool DirWatch::isWatched(const std::string &key) const
+{
+  boost::lock_guard<boost::mutex> lock(ptr->mutex);
+  return ptr->wds.count(key) != 0;
+}
+
+void DirWatch::getChanged(std::set<std::string> &keys)
+{
+  boost::lock_guard<boost::mutex> lock(ptr->mutex);
+  ptr->readEvents();
+  keys.insert(ptr->changed.begin(), ptr->changed.end());
+  ptr->changed.clear();
+}
@@ -0,0 +1,49 @@
+#ifndef __MISC_DIRWATCH_HPP_
+#define __MISC_DIRWATCH_HPP_
+
+#include <set>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+/* Watches directory trees for changes, so we know which ones need to
+   be looked at again, instead of walking all of them.
+
+   Each watched tree is registered under a key (eg. a game id), and
+   getChanged() reports the keys of all trees where something has
+   changed since the last call.
+
+   Only implemented on Linux (inotify). Elsewhere add() always fails,
+   and callers have to fall back to rescanning. It may also fail on
+   Linux if the system limit on watches is reached.
+ */
+
+namespace Misc
+{
+  class DirWatch
+  {
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+
+  public:
+    DirWatch();
+
+    /* Watch 'dir' and all its subdirectories. Replaces any existing
+       watch for 'key'. Returns false if the tree could not be
+       watched, in which case nothing is watched for 'key'.
+     */
+    bool add(const std::string &key, const std::string &dir);
+
+    // Stop watching 'key'
+    void remove(const std::string &key);
+
+    bool isWatched(const std::string &key) const;
+
+    /* Add the keys of all trees that have changed since the last call
+       to 'keys'. Does not block. New subdirectories are picked up
+       automatically.
+     */
+    void getChanged(std::set<std::string> &keys);
+  };
+}
+
+#endif
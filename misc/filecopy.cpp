@@ -0,0 +1,385 @@
+#include "filecopy.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#ifdef __linux__
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/falloc.h>
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+using namespace Misc;
+using namespace Misc::FileCopy;
+namespace bf = boost::filesystem;
+
+// Disks (especially spinning ones) don't gain anything from a huge
+// number of parallel requests.
+#define MAX_THREADS 8
+
+static int pickThreads(int threads, int work)
+{
+  if(threads <= 0)
+    {
+      threads = boost::thread::hardware_concurrency();
+      if(threads < 2) threads = 2;
+      if(threads > MAX_THREADS) threads = MAX_THREADS;
+    }
+  if(threads > work) threads = work;
+  if(threads < 1) threads = 1;
+  return threads;
+}
+
+#ifdef __linux__
+
+// Max bytes per copy_file_range/sendfile call
+#define CHUNK (64*1024*1024)
+
+static void copyFail(const std::string &msg, const std::string &file)
+{
+  throw std::runtime_error(msg + " " + file + ": " + strerror(errno));
+}
+
+// Errors meaning "this method isn't supported here, try the next one"
+static bool notSupported(int err)
+{
+  return err == ENOSYS || err == EXDEV || err == EINVAL ||
+    err == EOPNOTSUPP || err == ENOTTY || err == EPERM;
+}
+
+struct FileHandles
+{
+  int in, out;
+  std::string outName;
+  bool ok;
+
+  FileHandles() : in(-1), out(-1), ok(false) {}
+  ~FileHandles()
+  {
+    if(in != -1) close(in);
+    if(out != -1) close(out);
+    if(!ok && outName != "") unlink(outName.c_str());
+  }
+};
+
+void FileCopy::copyFile(const std::string &from, const std::string &to)
+{
+  FileHandles fh;
+
+  fh.in = open(from.c_str(), O_RDONLY);
+  if(fh.in == -1) copyFail("Failed to open", from);
+
+  struct stat st;
+  if(fstat(fh.in, &st) != 0) copyFail("Failed to stat", from);
+
+  fh.out = open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 0777);
+  if(fh.out == -1) copyFail("Failed to create", to);
+  fh.outName = to;
+
+  // Reflink. Shares the data blocks, so no data is copied at all.
+  if(ioctl(fh.out, FICLONE, fh.in) == 0)
+    {
+      fh.ok = true;
+      return;
+    }
+
+  /* Preallocate the whole file. Keeps it from being fragmented, and
+     if the disk is full we find out here rather than halfway through
+     a large copy. KEEP_SIZE leaves the file size alone, so it still
+     only grows as data is written.
+   */
+  if(st.st_size > 0 &&
+     fallocate(fh.out, FALLOC_FL_KEEP_SIZE, 0, st.st_size) != 0 &&
+     !notSupported(errno))
+    copyFail("Failed to allocate", to);
+
+  int64_t left = st.st_size;
+  bool useRange = true, useSendfile = true;
+
+#ifdef SYS_copy_file_range
+  // Copy inside the kernel. Called through syscall() so we don't
+  // depend on a recent libc.
+  while(left > 0 && useRange)
+    {
+      ssize_t res = syscall(SYS_copy_file_range, fh.in, NULL, fh.out, NULL,
+                            (size_t)(left < CHUNK ? left : CHUNK), 0);
+      if(res > 0) left -= res;
+      else if(res == 0) break;
+      else if(errno == EINTR) continue;
+      else if(notSupported(errno)) useRange = false;
+      else copyFail("Failed to copy", from);
+    }
+#endif
+
+  // sendfile() continues from the current file offsets, so it
+  // picks up wherever copy_file_range() stopped.
+  while(left > 0 && useSendfile)
+    {
+      ssize_t res = sendfile(fh.out, fh.in, NULL,
+                             (size_t)(left < CHUNK ? left : CHUNK));
+      if(res > 0) left -= res;
+      else if(res == 0) break;
+      else if(errno == EINTR) continue;
+      else if(notSupported(errno)) useSendfile = false;
+      else copyFail("Failed to copy", from);
+    }
+
+  // Plain old copy loop
+  char buf[64*1024];
+  while(left > 0)
+    {
+      ssize_t res = read(fh.in, buf, sizeof(buf));
+      if(res == 0) break;
+      if(res < 0)
+        {
+          if(errno == EINTR) continue;
+          copyFail("Failed to read", from);
+        }
+
+      char *p = buf;
+      while(res > 0)
+        {
+          ssize_t w = write(fh.out, p, res);
+          if(w < 0)
+            {
+              if(errno == EINTR) continue;
+              copyFail("Failed to write", to);
+            }
+          p += w;
+          res -= w;
+          left -= w;
+        }
+    }
+
+  if(close(fh.out) != 0)
+    {
+      fh.out = -1;
+      copyFail("Failed to write", to);
+    }
+  fh.out = -1;
+  fh.ok = true;
+}
+
+#else
+
+void FileCopy::copyFile(const std::string &from, const std::string &to)
+{
+  bf::copy_file(from, to);
+}
+
+#endif
+
+static bool nameLess(const FileInfo &a, const FileInfo &b)
+{ return a.name < b.name; }
+
+namespace
+{
+  struct Indexer
+  {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+
+    // Directories waiting to be scanned
+    std::vector<bf::path> queue;
+
+    // Directories queued or currently being scanned. We are done when
+    // this reaches zero.
+    int pending;
+
+    int baseLen;
+    std::vector<FileInfo> *out;
+    std::string error;
+
+    void run()
+    {
+      std::vector<bf::path> dirs;
+      std::vector<FileInfo> files;
+
+      while(true)
+        {
+          bf::path dir;
+          {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while(queue.empty() && pending > 0)
+              cond.wait(lock);
+            if(queue.empty()) break;
+
+            dir = queue.back();
+            queue.pop_back();
+          }
+
+          dirs.clear();
+          files.clear();
+          try
+            {
+              bf::directory_iterator iter(dir), end;
+              for(; iter != end; ++iter)
+                {
+                  const bf::path &p = iter->path();
+                  if(bf::is_directory(iter->symlink_status()))
+                    dirs.push_back(p);
+                  else if(bf::is_regular_file(iter->status()))
+                    {
+                      FileInfo fi;
+                      fi.name = p.string().substr(baseLen);
+                      fi.size = bf::file_size(p);
+                      files.push_back(fi);
+                    }
+                }
+            }
+          catch(std::exception &e)
+            {
+              boost::lock_guard<boost::mutex> lock(mutex);
+              if(error == "") error = e.what();
+            }
+
+          {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            out->insert(out->end(), files.begin(), files.end());
+            queue.insert(queue.end(), dirs.begin(), dirs.end());
+            pending += dirs.size();
+            pending--;
+          }
+          cond.notify_all();
+        }
+    }
+  };
+
+  struct Copier
+  {
+    boost::mutex mutex;
+    const std::vector<Entry> *list;
+    ProgressFunc progress;
+    DoneFunc done;
+
+    int next;
+    int64_t bytes, total;
+    bool abort;
+    std::string error;
+
+    void makeDir(const bf::path &dir)
+    {
+      if(dir.empty() || bf::is_directory(dir)) return;
+
+      // Other threads may be creating the same directory at the same
+      // time, so only complain if it still doesn't exist afterwards.
+      try { bf::create_directories(dir); }
+      catch(...)
+        {
+          if(!bf::is_directory(dir))
+            throw;
+        }
+    }
+
+    void run()
+    {
+      while(true)
+        {
+          int index;
+          {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if(abort || error != "" || next >= list->size())
+              break;
+
+            if(progress && !progress(bytes, total))
+              {
+                abort = true;
+                break;
+              }
+
+            index = next++;
+          }
+
+          const Entry &e = (*list)[index];
+          try
+            {
+              bf::path to = e.to;
+              makeDir(to.parent_path());
+              copyFile(e.from, e.to);
+              if(done) done(e);
+            }
+          catch(std::exception &ex)
+            {
+              boost::lock_guard<boost::mutex> lock(mutex);
+              if(error == "") error = ex.what();
+              break;
+            }
+
+          boost::lock_guard<boost::mutex> lock(mutex);
+          bytes += e.size;
+        }
+    }
+  };
+}
+
+void FileCopy::index(const std::string &dir, std::vector<FileInfo> &out,
+                     int threads)
+{
+  bf::path base = bf::absolute(dir);
+
+  // Base path without slash
+  std::string baseStr = (base/"tmp").parent_path().string();
+
+  Indexer ind;
+  ind.queue.push_back(base);
+  ind.pending = 1;
+  ind.baseLen = baseStr.size() + 1;
+  ind.out = &out;
+
+  threads = pickThreads(threads, MAX_THREADS);
+
+  boost::thread_group group;
+  for(int i=0; i<threads; i++)
+    group.create_thread(boost::bind(&Indexer::run, &ind));
+  group.join_all();
+
+  if(ind.error != "")
+    throw std::runtime_error(ind.error);
+
+  // Threads finish in random order, so sort the result to make it
+  // predictable.
+  std::sort(out.begin(), out.end(), nameLess);
+}
+
+bool FileCopy::copy(const std::vector<Entry> &list, ProgressFunc progress,
+                    DoneFunc done, int threads)
+{
+  Copier cp;
+  cp.list = &list;
+  cp.progress = progress;
+  cp.done = done;
+  cp.next = 0;
+  cp.bytes = 0;
+  cp.total = 0;
+  cp.abort = false;
+  for(int i=0; i<list.size(); i++)
+    cp.total += list[i].size;
+
+  threads = pickThreads(threads, list.size());
+
+  boost::thread_group group;
+  for(int i=0; i<threads; i++)
+    group.create_thread(boost::bind(&Copier::run, &cp));
+  group.join_all();
+
+  if(cp.error != "")
+    throw std::runtime_error(cp.error);
+
+  if(!cp.abort && progress)
+    progress(cp.bytes, cp.total);
+
+  return !cp.abort;
+}
@@ -0,0 +1,74 @@
+#ifndef __MISC_FILECOPY_HPP_
+#define __MISC_FILECOPY_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/function.hpp>
+
+/* Multi-threaded directory indexing and file copying. Used by the
+   importer, where repositories may contain hundreds of thousands of
+   small files, and doing one stat() or copy at a time leaves most of
+   the disk bandwidth unused.
+ */
+
+namespace Misc
+{
+  namespace FileCopy
+  {
+    struct FileInfo
+    {
+      // Path relative to the indexed directory
+      std::string name;
+      int64_t size;
+    };
+
+    struct Entry
+    {
+      std::string from, to;
+      int64_t size;
+    };
+
+    /* Called with (bytes done, bytes total). Return false to abort
+       the copy. Calls are serialized, but may come from any thread.
+     */
+    typedef boost::function<bool(int64_t,int64_t)> ProgressFunc;
+
+    /* Called from the worker threads after each file has been
+       copied. Must be thread safe.
+     */
+    typedef boost::function<void(const Entry&)> DoneFunc;
+
+    /* Copy a single file. Fails if the destination already exists.
+
+       On Linux this avoids moving the data through user space where
+       possible. It first tries to reflink the file (instant on
+       copy-on-write filesystems such as btrfs and XFS), then
+       copy_file_range() and sendfile(), and finally falls back to a
+       plain read/write loop. Other platforms use the boost copy.
+     */
+    void copyFile(const std::string &from, const std::string &to);
+
+    /* Recursively list all regular files in 'dir', sorted by
+       name. Subdirectories are scanned in parallel by 'threads'
+       threads (0 means pick a suitable number.) Symlinked directories
+       are not followed. Throws on error.
+     */
+    void index(const std::string &dir, std::vector<FileInfo> &out,
+               int threads=0);
+
+    /* Copy all files in 'list'. Each worker thread copies one file at
+       a time, so there are never more than 'threads' files in
+       flight. Destination directories are created as needed, and
+       existing destination files are never overwritten.
+
+       Returns false if aborted through the progress callback, true
+       otherwise. Throws on the first copy error.
+     */
+    bool copy(const std::vector<Entry> &list,
+              ProgressFunc progress = ProgressFunc(),
+              DoneFunc done = DoneFunc(), int threads=0);
+  }
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "filehash.hpp"
+
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define MMAP_HASH
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define BUF_SIZE (256*1024)
+
+static void fail(const std::string &msg)
+{
+  throw std::runtime_error(msg);
+}
+
+static inline uint64_t mix(uint64_t h, uint64_t v)
+{
+  h ^= v * 0x87c37b91114253d5ULL;
+  h = (h << 31) | (h >> 33);
+  return h * 0x4cf5ad432745937fULL;
+}
+
+// Hashes a stream of 64 bit words. Data is fed in blocks that are a
+// multiple of 8 bytes, except for the last one.
+struct Hasher
+{
+  uint64_t h, total;
+
+  Hasher() : h(0x9e3779b97f4a7c15ULL), total(0) {}
+
+  void add(const char *data, int64_t size)
+  {
+    total += size;
+
+    int64_t words = size/8;
+    for(int64_t i=0; i<words; i++)
+      {
+        uint64_t v;
+        memcpy(&v, data + i*8, 8);
+        h = mix(h, v);
+      }
+
+    // Zero-pad the last partial word
+    int rest = size%8;
+    if(rest)
+      {
+        uint64_t v = 0;
+        memcpy(&v, data + words*8, rest);
+        h = mix(h, v);
+      }
+  }
+
+  uint64_t finish()
+  {
+    // Include the length, so zero-padding can't cause collisions
+    uint64_t res = mix(h, total);
+    res ^= res >> 33;
+    return res;
+  }
+};
+
+#ifdef MMAP_HASH
+
+// Map files in windows of this size, to keep address space use down
+// on 32 bit systems.
+#define MAP_SIZE (64*1024*1024)
+
+/* Hash through a memory mapping. Avoids copying the data into a
+   buffer, and lets the kernel read ahead. Returns false if the file
+   can't be mapped, in which case the caller falls back to reading it.
+ */
+static bool mapHash(const std::string &file, uint64_t &res)
+{
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1) return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+      close(fd);
+      return false;
+    }
+
+  Hasher hs;
+  bool ok = true;
+  for(int64_t pos = 0; pos < st.st_size; pos += MAP_SIZE)
+    {
+      size_t len = MAP_SIZE;
+      if(st.st_size - pos < len) len = st.st_size - pos;
+
+      void *p = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, pos);
+      if(p == MAP_FAILED)
+        {
+          ok = false;
+          break;
+        }
+      madvise(p, len, MADV_SEQUENTIAL);
+      hs.add((const char*)p, len);
+      munmap(p, len);
+    }
+  close(fd);
+
+  if(ok) res = hs.finish();
+  return ok;
+}
+
+#endif
+
+uint64_t Misc::hashFile(const std::string &file)
+{
+#ifdef MMAP_HASH
+  uint64_t res;
+  if(mapHash(file, res))
+    return res;
+#endif
+
+  std::ifstream inp(file.c_str(), std::ios::binary);
+  if(!inp) fail("Cannot read " + file);
+
+  std::vector<char> buf(BUF_SIZE);
+  Hasher hs;
+
+  while(inp)
+    {
+      inp.read(&buf[0], BUF_SIZE);
+      int got = inp.gcount();
+      if(got == 0) break;
+      hs.add(&buf[0], got);
+    }
+
+  if(inp.bad()) fail("Error reading " + file);
+
+  return hs.finish();
+}
+
+bool Misc::sameContent(const std::string &file1, const std::string &file2)
+{
+  std::ifstream in1(file1.c_str(), std::ios::binary);
+  std::ifstream in2(file2.c_str(), std::ios::binary);
+  if(!in1) fail("Cannot read " + file1);
+  if(!in2) fail("Cannot read " + file2);
+
+  std::vector<char> buf1(BUF_SIZE), buf2(BUF_SIZE);
+  while(true)
+    {
+      in1.read(&buf1[0], BUF_SIZE);
+      in2.read(&buf2[0], BUF_SIZE);
+      int got1 = in1.gcount(), got2 = in2.gcount();
+
+      if(in1.bad()) fail("Error reading " + file1);
+      if(in2.bad()) fail("Error reading " + file2);
+
+      if(got1 != got2) return false;
+      if(got1 == 0) return true;
+      if(memcmp(&buf1[0], &buf2[0], got1) != 0) return false;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef __MISC_FILEHASH_HPP_
+#define __MISC_FILEHASH_HPP_
+
+#include <string>
+#include <stdint.h>
+
+namespace Misc
+{
+  /* Fast 64 bit hash of a file's contents. This is NOT a
+     cryptographic hash. Use it to find files that are likely to be
+     equal, and use sameContent() before relying on it.
+
+     Throws on read errors.
+   */
+  uint64_t hashFile(const std::string &file);
+
+  // Byte-by-byte comparison of two files. Throws on read errors.
+  bool sameContent(const std::string &file1, const std::string &file2);
+}
+
+#endif
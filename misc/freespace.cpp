@@ -1,7 +1,13 @@
 #include "freespace.hpp"
+#include <map>
+#include <stdio.h>
+#include <ctype.h>
 #include <stdexcept>
 #include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
 
+using namespace Misc;
 namespace bf = boost::filesystem;
 
 static void fail(const std::string &msg)
@@ -76,7 +82,161 @@ void Misc::getDiskSpace(const std::string &filePath, int64_t &free, int64_t &tot
        ::statfs(dirStr.c_str(),&stfs) == -1 )
     fail("Unable to stat " + dirStr);
 
-  free = stfs.f_bavail * stst.st_blksize;
-  total = stfs.f_blocks * stst.st_blksize;
+  // Block counts are in fragment size units, not the preferred IO
+  // size (st_blksize), though the two are usually the same.
+  int64_t unit = stfs.f_frsize ? stfs.f_frsize : stfs.f_bsize;
+  free = stfs.f_bavail * unit;
+  total = stfs.f_blocks * unit;
 #endif // _WIN32
 }
+
+/* Find the directory to stat for a given path. The path itself may
+   not exist yet (eg. a game about to be installed), so use the
+   nearest existing parent.
+ */
+static bf::path existingDir(const std::string &filePath)
+{
+  bf::path dir = bf::absolute(filePath);
+  while(!dir.empty() && !bf::is_directory(dir))
+    dir = dir.parent_path();
+
+  if(dir.empty())
+    fail("File or directory not found: " + filePath);
+  return dir;
+}
+
+// Returns a string identifying the filesystem the path is on
+static std::string getFSKey(const bf::path &dir)
+{
+#ifdef _WIN32
+  char buf[MAX_PATH+1];
+  if(!::GetVolumePathName(dir.string().c_str(), buf, sizeof(buf)))
+    throwError("Unable to find volume for " + dir.string());
+  std::string res = buf;
+  for(int i=0; i<res.size(); i++)
+    res[i] = tolower(res[i]);
+  return res;
+#else
+  struct stat stst;
+  if(::stat(dir.string().c_str(), &stst) == -1)
+    fail("Unable to stat " + dir.string());
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%llu", (unsigned long long)stst.st_dev);
+  return buf;
+#endif
+}
+
+int64_t Misc::getBlockSize(const std::string &filePath)
+{
+  bf::path dir = existingDir(filePath);
+
+#ifdef _WIN32
+  std::string dirStr = (dir/"tmp").parent_path().string() + "\\";
+  char vol[MAX_PATH+1];
+  if(::GetVolumePathName(dirStr.c_str(), vol, sizeof(vol)))
+    {
+      DWORD sectPerClust, bytesPerSect, freeClust, totalClust;
+      if(::GetDiskFreeSpace(vol, &sectPerClust, &bytesPerSect, &freeClust, &totalClust))
+        return (int64_t)sectPerClust * bytesPerSect;
+    }
+#else
+  // Same unit as getDiskSpace() uses for the free space
+  struct statfs stfs;
+  if(::statfs(dir.string().c_str(), &stfs) == 0)
+    {
+      int64_t unit = stfs.f_frsize ? stfs.f_frsize : stfs.f_bsize;
+      if(unit > 0) return unit;
+    }
+#endif
+
+  // Most common default
+  return 4096;
+}
+
+int64_t Misc::allocSize(int64_t size, int64_t block)
+{
+  if(block <= 0) return size;
+  return (size + block - 1) / block * block;
+}
+
+/* The ledger. Maps filesystems to the number of bytes that have been
+   promised away but not yet written.
+ */
+static boost::mutex ledgerMutex;
+static std::map<std::string, int64_t> ledger;
+
+int64_t Misc::getAvailable(const std::string &filePath)
+{
+  bf::path dir = existingDir(filePath);
+  int64_t free, total;
+  getDiskSpace(dir.string(), free, total);
+
+  std::string key = getFSKey(dir);
+  boost::lock_guard<boost::mutex> lock(ledgerMutex);
+  std::map<std::string, int64_t>::iterator it = ledger.find(key);
+  if(it != ledger.end())
+    free -= it->second;
+  return free;
+}
+
+SpaceReservation::SpaceReservation()
+  : reserved(0), outstanding(0) {}
+
+SpaceReservation::~SpaceReservation()
+{
+  try { release(); }
+  catch(...) {}
+}
+
+bool SpaceReservation::reserve(const std::string &path, int64_t bytes)
+{
+  release();
+
+  bf::path dir = existingDir(path);
+  std::string key = getFSKey(dir);
+  int64_t free, total;
+  getDiskSpace(dir.string(), free, total);
+
+  // Check and reserve in one step, so two jobs can't both grab the
+  // same free space.
+  boost::lock_guard<boost::mutex> lock(ledgerMutex);
+  int64_t &held = ledger[key];
+  if(free - held < bytes)
+    return false;
+
+  held += bytes;
+  fsKey = key;
+  reserved = outstanding = bytes;
+  return true;
+}
+
+void SpaceReservation::setProgress(int64_t current, int64_t total)
+{
+  if(fsKey == "" || total <= 0) return;
+
+  // Whatever has been written is already gone from the free space
+  // reported by the OS, so stop counting it here.
+  if(current > total) current = total;
+  int64_t left = reserved - (int64_t)(reserved * ((double)current / total));
+
+  boost::lock_guard<boost::mutex> lock(ledgerMutex);
+  if(left < outstanding)
+    {
+      ledger[fsKey] -= outstanding - left;
+      outstanding = left;
+    }
+}
+
+void SpaceReservation::release()
+{
+  if(fsKey == "") return;
+
+  boost::lock_guard<boost::mutex> lock(ledgerMutex);
+  ledger[fsKey] -= outstanding;
+  if(ledger[fsKey] <= 0)
+    ledger.erase(fsKey);
+
+  fsKey = "";
+  reserved = outstanding = 0;
+}
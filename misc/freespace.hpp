@@ -9,6 +9,60 @@ namespace Misc
   /* Get total and free disk space for any given file or directory.
    */
   void getDiskSpace(const std::string &filePath, int64_t &free, int64_t &total);
+
+  /* Get the allocation block (cluster) size of the filesystem
+     containing the given path. The path does not have to exist, its
+     nearest existing parent directory is used.
+   */
+  int64_t getBlockSize(const std::string &filePath);
+
+  // Space actually taken up on disk by a file of the given size
+  int64_t allocSize(int64_t size, int64_t block);
+
+  /* Free space on the filesystem containing 'filePath', minus what
+     has been reserved by running jobs.
+   */
+  int64_t getAvailable(const std::string &filePath);
+
+  /* Disk space reservation.
+
+     Checking free space separately in each job lets parallel installs
+     and imports all see the same free space, and together fill up the
+     disk. Instead, jobs reserve the space they need up front in a
+     process wide ledger, and later jobs only see what is left over.
+
+     As data gets written, the job reports its progress, and the
+     written part is released from the ledger (since the OS already
+     counts it as used.) The rest is released when the object is
+     destroyed.
+   */
+  class SpaceReservation
+  {
+    std::string fsKey;
+    int64_t reserved, outstanding;
+
+    SpaceReservation(const SpaceReservation&);
+    SpaceReservation &operator=(const SpaceReservation&);
+
+  public:
+    SpaceReservation();
+    ~SpaceReservation();
+
+    /* Reserve 'bytes' on the filesystem containing 'path'. Returns
+       false, and reserves nothing, if there is not enough space
+       left. Releases any earlier reservation held by this object.
+     */
+    bool reserve(const std::string &path, int64_t bytes);
+
+    // Report how much of the job is done, as (current, total).
+    void setProgress(int64_t current, int64_t total);
+
+    // Release everything that's left
+    void release();
+
+    bool isActive() const { return fsKey != ""; }
+    int64_t getSize() const { return reserved; }
+  };
 }
 
 #endif
@@ -0,0 +1,225 @@
+#include "hashcache.hpp"
+#include "filehash.hpp"
+#include "metrics.hpp"
+
+#include <map>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+typedef boost::lock_guard<boost::mutex> Lock;
+
+namespace
+{
+  // What stat() tells us about a file
+  struct Stamp
+  {
+    int64_t size, mtime, mtimeNs;
+    uint64_t inode;
+
+    bool operator==(const Stamp &o) const
+    {
+      return size == o.size && mtime == o.mtime && mtimeNs == o.mtimeNs &&
+        inode == o.inode;
+    }
+  };
+
+  struct Entry
+  {
+    Stamp st;
+    uint64_t hash;
+
+    // Time (in seconds) when hashing started
+    int64_t checked;
+
+    /* The entry is only good if the file hasn't changed, and it was
+       last modified before we started hashing it. If it was modified
+       in that same second, a later change might not show up in the
+       timestamp.
+     */
+    bool trusted(const Stamp &now) const
+    { return st == now && st.mtime < checked; }
+  };
+
+  typedef std::map<std::string, Entry> Table;
+
+  boost::mutex mutex;
+  Table table;
+  std::string tableFile;
+  bool dirty = false, readOnly = false;
+}
+
+static bool getStamp(const std::string &file, Stamp &st)
+{
+#ifdef _WIN32
+  boost::system::error_code ec;
+  st.size = bf::file_size(file, ec);
+  if(ec) return false;
+  st.mtime = bf::last_write_time(file, ec);
+  if(ec) return false;
+  st.mtimeNs = 0;
+  st.inode = 0;
+#else
+  struct stat s;
+  if(stat(file.c_str(), &s) != 0 || !S_ISREG(s.st_mode))
+    return false;
+  st.size = s.st_size;
+  st.mtime = s.st_mtime;
+#if defined(__linux__)
+  st.mtimeNs = s.st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+  st.mtimeNs = s.st_mtimespec.tv_nsec;
+#else
+  st.mtimeNs = 0;
+#endif
+  st.inode = s.st_ino;
+#endif
+  return true;
+}
+
+static std::string absPath(const std::string &file)
+{
+  try { return bf::absolute(file).string(); }
+  catch(...) { return file; }
+}
+
+void HashCache::load(const std::string &file, bool ro)
+{
+  Lock lock(mutex);
+  tableFile = file;
+  readOnly = ro;
+  table.clear();
+  dirty = false;
+
+  std::ifstream inp(file.c_str());
+  std::string line;
+  if(!std::getline(inp, line) || line != "hashcache 1")
+    return;
+
+  while(std::getline(inp, line))
+    {
+      std::istringstream str(line);
+      Entry e;
+      str >> std::hex >> e.hash >> std::dec >> e.st.size >> e.st.mtime
+          >> e.st.mtimeNs >> e.st.inode >> e.checked;
+
+      // The path is the rest of the line, and may contain spaces
+      std::string path;
+      str.get();
+      std::getline(str, path);
+      if(!str.fail() && path != "")
+        table[path] = e;
+    }
+}
+
+void HashCache::save()
+{
+  Lock lock(mutex);
+  if(!dirty || tableFile == "" || readOnly) return;
+
+  try
+    {
+      bf::path dir = bf::path(tableFile).parent_path();
+      if(!dir.empty()) bf::create_directories(dir);
+
+      std::string tmp = tableFile + ".tmp";
+      {
+        std::ofstream out(tmp.c_str());
+        out << "hashcache 1\n";
+        for(Table::iterator it = table.begin(); it != table.end(); it++)
+          {
+            const Entry &e = it->second;
+            out << std::hex << e.hash << std::dec << " " << e.st.size << " "
+                << e.st.mtime << " " << e.st.mtimeNs << " " << e.st.inode
+                << " " << e.checked << " " << it->first << "\n";
+          }
+        if(!out) return;
+      }
+      bf::rename(tmp, tableFile);
+      dirty = false;
+    }
+  catch(...) {}
+}
+
+uint64_t HashCache::hashFile(const std::string &file, bool reuse)
+{
+  std::string path = absPath(file);
+
+  // Not a regular file, or not there at all. Let hashFile() deal with
+  // it.
+  Stamp before;
+  if(!getStamp(path, before))
+    return Misc::hashFile(file);
+
+  if(reuse)
+    {
+      Lock lock(mutex);
+      Table::iterator it = table.find(path);
+      if(it != table.end() && it->second.trusted(before))
+        {
+          Metrics::count("hashcache.hits");
+          return it->second.hash;
+        }
+    }
+
+  Metrics::count("hashcache.misses");
+
+  Entry e;
+  e.checked = time(NULL);
+  e.hash = Misc::hashFile(file);
+  e.st = before;
+
+  // Only keep the result if the file didn't change under us
+  Stamp after;
+  if(getStamp(path, after) && after == before)
+    {
+      Lock lock(mutex);
+      table[path] = e;
+      dirty = true;
+    }
+
+  return e.hash;
+}
+
+bool HashCache::lookup(const std::string &file, uint64_t &hash)
+{
+  std::string path = absPath(file);
+  Stamp st;
+  if(!getStamp(path, st)) return false;
+
+  Lock lock(mutex);
+  Table::iterator it = table.find(path);
+  if(it == table.end() || !it->second.trusted(st))
+    return false;
+
+  hash = it->second.hash;
+  return true;
+}
+
+void HashCache::forget(const std::string &dir)
+{
+  std::string path = absPath(dir);
+  std::string prefix = path;
+  if(prefix != "" && prefix[prefix.size()-1] != '/' &&
+     prefix[prefix.size()-1] != bf::path::preferred_separator)
+    prefix += bf::path::preferred_separator;
+
+  Lock lock(mutex);
+  if(table.erase(path)) dirty = true;
+  Table::iterator it = table.lower_bound(prefix);
+  while(it != table.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+    {
+      table.erase(it++);
+      dirty = true;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef __MISC_HASHCACHE_HPP_
+#define __MISC_HASHCACHE_HPP_
+
+#include <string>
+#include <stdint.h>
+
+/* Process-wide table of file hashes (see filehash.hpp), persisted
+   between runs, so that files which have not changed are never read
+   and hashed again.
+
+   Entries are keyed by path, and are only trusted as long as the
+   file's size, modification time and inode are the same as when it
+   was hashed. Checking this costs a single stat() call.
+
+   Files modified within the same second as they were hashed can't be
+   told apart from unchanged files by their timestamp, so entries for
+   those are not trusted, and the file is hashed again the next time
+   it is looked up.
+
+   All functions are thread safe.
+ */
+
+namespace Misc
+{
+  namespace HashCache
+  {
+    /* Set the file the table is stored in, and load it. Until this is
+       called the table is only kept in memory. Errors are ignored.
+
+       With 'readOnly', the loaded entries are used but save() does
+       nothing, for processes that share the file with its owner.
+     */
+    void load(const std::string &file, bool readOnly=false);
+
+    // Write the table back, if anything has changed. Errors are
+    // ignored.
+    void save();
+
+    /* Get the hash of a file. If 'reuse' is false, the file is always
+       hashed, and the result is stored for later. Throws on read
+       errors.
+     */
+    uint64_t hashFile(const std::string &file, bool reuse=true);
+
+    // Look up a file without hashing it. Returns false if the file is
+    // unknown or has changed.
+    bool lookup(const std::string &file, uint64_t &hash);
+
+    // Forget all files in the given directory and below
+    void forget(const std::string &dir);
+  }
+}
+
+#endif
@@ -1,64 +1,238 @@
 #include "lockfile.hpp"
 
-#include <boost/filesystem.hpp>
 #include <fstream>
+#include <sstream>
+#include <string.h>
 #include <assert.h>
 
 #ifdef _WIN32
 #include "windows.h"
-int getPID() { return GetCurrentProcessId(); }
+static int getPID() { return GetCurrentProcessId(); }
 #else
-#ifdef __unix
 #include <unistd.h>
-int getPID() { return getpid(); }
-#endif
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/file.h>
+static int getPID() { return getpid(); }
 #endif
 
 using namespace Misc;
-using namespace boost::filesystem;
 using namespace std;
 
-int LockFile::counter = 0;
+#ifdef _WIN32
 
-bool LockFile::lock(bool force)
+static HANDLE openHandle(const string &file, DWORD access, DWORD create)
+{
+  return CreateFileA(file.c_str(), access,
+                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                     NULL, create, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+// Readers only open the file for reading, see the Unix version
+static intptr_t openFile(const string &file, bool exclusive)
+{
+  HANDLE h;
+  if(exclusive)
+    h = openHandle(file, GENERIC_READ | GENERIC_WRITE, OPEN_ALWAYS);
+  else
+    {
+      h = openHandle(file, GENERIC_READ, OPEN_EXISTING);
+      if(h == INVALID_HANDLE_VALUE && GetLastError() == ERROR_FILE_NOT_FOUND)
+        h = openHandle(file, GENERIC_READ, OPEN_ALWAYS);
+    }
+  if(h == INVALID_HANDLE_VALUE) return -1;
+  return (intptr_t)h;
+}
+
+static bool fileExists(const string &file)
+{
+  return GetFileAttributesA(file.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+static void closeFile(intptr_t fd) { CloseHandle((HANDLE)fd); }
+
+/* Windows locks are mandatory for the locked range, so we lock a byte
+   far past the end of the file. That leaves the PID readable by
+   everyone.
+ */
+static void lockRange(OVERLAPPED &ov)
+{
+  memset(&ov, 0, sizeof(ov));
+  ov.OffsetHigh = 1;
+}
+
+static bool osLock(intptr_t fd, bool exclusive)
+{
+  OVERLAPPED ov;
+  lockRange(ov);
+  DWORD flags = LOCKFILE_FAIL_IMMEDIATELY;
+  if(exclusive) flags |= LOCKFILE_EXCLUSIVE_LOCK;
+  return LockFileEx((HANDLE)fd, flags, 0, 1, 0, &ov) != 0;
+}
+
+static void osUnlock(intptr_t fd)
+{
+  OVERLAPPED ov;
+  lockRange(ov);
+  UnlockFileEx((HANDLE)fd, 0, 1, 0, &ov);
+}
+
+static void writeAll(intptr_t fd, const string &data)
+{
+  HANDLE h = (HANDLE)fd;
+  SetFilePointer(h, 0, NULL, FILE_BEGIN);
+  DWORD written;
+  if(!data.empty())
+    WriteFile(h, data.c_str(), data.size(), &written, NULL);
+  SetEndOfFile(h);
+}
+
+bool LockFile::isAlive(int pid)
+{
+  if(pid <= 0) return false;
+  HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, pid);
+
+  // The process exists, but belongs to someone else
+  if(!h) return GetLastError() == ERROR_ACCESS_DENIED;
+
+  bool alive = WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+  CloseHandle(h);
+  return alive;
+}
+
+#else
+
+/* Readers only need read access, so they can lock repositories they
+   can't write to. The file is still created if it's missing and we
+   are allowed to, so a writer starting after us sees our lock.
+ */
+static intptr_t openFile(const string &file, bool exclusive)
+{
+  if(exclusive)
+    return open(file.c_str(), O_RDWR | O_CREAT, 0666);
+
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1 && errno == ENOENT)
+    fd = open(file.c_str(), O_RDONLY | O_CREAT, 0666);
+  return fd;
+}
+
+static bool fileExists(const string &file)
+{
+  return access(file.c_str(), F_OK) == 0;
+}
+
+static void closeFile(intptr_t fd) { close(fd); }
+
+/* flock() rather than fcntl() locks, since fcntl() locks belong to the
+   process, and two LockFiles in the same process would not exclude
+   each other.
+ */
+static bool osLock(intptr_t fd, bool exclusive)
+{
+  return flock(fd, (exclusive ? LOCK_EX : LOCK_SH) | LOCK_NB) == 0;
+}
+
+static void osUnlock(intptr_t fd) { flock(fd, LOCK_UN); }
+
+static void writeAll(intptr_t fd, const string &data)
+{
+  if(ftruncate(fd, 0) != 0) return;
+  if(!data.empty() && pwrite(fd, data.c_str(), data.size(), 0) < 0)
+    return;
+}
+
+bool LockFile::isAlive(int pid)
+{
+  if(pid <= 0) return false;
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+#endif
+
+bool LockFile::doLock(bool exclusive)
 {
   assert(!locked);
   assert(file != "");
 
-  int lockValue = (getPID()&0xffffff) | (ID << 24);
-
-  // Is the resource already locked?
-  if(exists(file) && !force)
-    return false;
+  fd = openFile(file, exclusive);
+  if(fd == -1)
+    {
+      /* A reader that can't create a missing lock file has nothing to
+         lock. No writer holds it, since writers always create it, so
+         there is nothing to wait for either.
+       */
+      if(!exclusive && !fileExists(file))
+        {
+          held = false;
+          return true;
+        }
+      return false;
+    }
 
-  // Write our lock value
-  {
-    ofstream ofs(file.c_str(), ios::binary);
+  held = osLock(fd, exclusive);
+  return held;
+}
 
-    // Could we create the lock file?
-    if(!ofs)
+bool LockFile::lock(bool force)
+{
+  if(!doLock(true) && !(force && fd != -1))
+    {
+      unlock();
       return false;
+    }
 
-    ofs.write((char*)&lockValue, 4);
-  }
+  locked = true;
+  shared = false;
 
-  // Confirm our lock value
-  ifstream ifs(file.c_str(), ios::binary);
-  if(!ifs)
-    return false;
+  // Tell others who we are
+  ostringstream str;
+  str << getPID() << "\n";
+  writeAll(fd, str.str());
+  return true;
+}
 
-  int rval;
-  ifs.read((char*)&rval, 4);
+bool LockFile::lockShared()
+{
+  if(!doLock(false))
+    {
+      unlock();
+      return false;
+    }
 
-  locked = (rval == lockValue);
-  return locked;
+  locked = true;
+  shared = true;
+  return true;
 }
 
 void LockFile::unlock()
 {
-  if(locked)
+  if(fd != -1)
     {
-      remove(file);
-      locked = false;
+      // We wrote our PID. A forced lock overwrote someone else's, but
+      // they are not supposed to be around anyway.
+      if(locked && !shared)
+        writeAll(fd, "");
+
+      if(held) osUnlock(fd);
+      closeFile(fd);
     }
+
+  fd = -1;
+  locked = shared = held = false;
+}
+
+int LockFile::getOwner() const
+{
+  if(file == "") return 0;
+
+  ifstream inp(file.c_str());
+  int pid = 0;
+  if(!(inp >> pid)) return 0;
+
+  // Left behind by a process that died, or by an older version that
+  // wrote binary lock values
+  if(!isAlive(pid)) return 0;
+  return pid;
 }
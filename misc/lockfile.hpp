@@ -2,10 +2,21 @@
 #define __LOCKFILE_HPP_
 
 #include <string>
+#include <stdint.h>
 
-/* A lockfile is used to secure sole ownership of a resource. It's
-   used to lock repositories so multiple processes won't manipulate it
-   at the same time.
+/* A lockfile is used to secure ownership of a resource. It's used to
+   lock repositories so multiple processes won't manipulate it at the
+   same time.
+
+   The lock is an OS advisory lock on the file (flock() on Unix,
+   LockFileEx() on Windows), so it goes away by itself when the owner
+   dies. A lock that can't be taken is always held by a live process,
+   never left over from a crash.
+
+   Writers take an exclusive lock. Readers may take a shared lock
+   instead, which any number of processes can hold at once, but not
+   together with an exclusive lock. The exclusive owner writes its
+   process ID into the file, see getOwner().
  */
 
 namespace Misc
@@ -13,17 +24,25 @@ namespace Misc
   struct LockFile
   {
     LockFile(const std::string &_file = "")
-      : file(_file), locked(false)
-    { ID = counter++; }
+      : file(_file), locked(false), shared(false), held(false), fd(-1) {}
     ~LockFile() { unlock(); }
 
-    /* Lock function. Returns false if the lock failed.
+    /* Take an exclusive lock. Returns false if the lock failed.
 
-       In case of a stale lock file (the dead remains of a terminated
-       process that failed to clean up after itself), you can attempt
-       to force the lock by ignoring existing files. Use with caution.
+       Forcing takes the lock even if another process holds it, by
+       ignoring the OS lock. Only use this if you know the other owner
+       won't touch the resource, eg. on filesystems without working
+       locks. Use with caution.
      */
     bool lock(bool force=false);
+
+    /* Take a shared (read) lock. Returns false if a writer holds the
+       lock. Only needs read access to the lock file. If the file is
+       missing and can't be created, there is no writer to lock out,
+       and the lock is granted without an OS lock.
+     */
+    bool lockShared();
+
     void unlock();
     bool lock(const std::string &file, bool force=false)
     { setFile(file); return lock(force); }
@@ -31,14 +50,32 @@ namespace Misc
     void setFile(const std::string &_file)
     { unlock(); file = _file; }
     bool isLocked() const { return locked; }
+    bool isShared() const { return locked && shared; }
+
+    /* Process ID of the current exclusive owner, or 0 if there is
+       none. Works whether or not we hold a lock ourselves.
+     */
+    int getOwner() const;
+
+    // Check if a process is still running
+    static bool isAlive(int pid);
 
   private:
 
     std::string file;
-    bool locked;
-    int ID;
+    bool locked, shared;
+
+    // True if we actually hold the OS lock, false if it was forced
+    bool held;
+
+    // Open file descriptor or handle
+    intptr_t fd;
+
+    bool doLock(bool exclusive);
 
-    static int counter;
+    // Non-copyable, since we own the open file
+    LockFile(const LockFile&);
+    LockFile &operator=(const LockFile&);
   };
 }
 
@@ -1,10 +1,411 @@
 #include "logger.hpp"
 #include <iostream>
+#include <ctime>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <assert.h>
+#include <string.h>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
 
 using namespace Misc;
 namespace bf = boost::filesystem;
 
+// Max number of lines waiting to be written. Callers will block if
+// the queue is full, until the writer thread has caught up. Must be a
+// power of two, so positions can wrap around.
+#define QUEUE_SIZE 1024
+
+// Max number of simultaneously open loggers we are able to rescue on
+// fatal signals.
+#define MAX_LOGGERS 16
+
+// Length of a formatted time stamp, "YYYY-MM-DD HH:MM:SS"
+#define STAMP_LEN 19
+
+/* The log is written with plain file descriptors rather than streams,
+   since the signal handler below may only use write().
+ */
+#ifdef _WIN32
+static int openLog(const std::string &file)
+{
+  return _open(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_TEXT,
+               _S_IREAD | _S_IWRITE);
+}
+static void closeLog(int fd) { _close(fd); }
+
+static void writeAll(int fd, const char *data, size_t size)
+{
+  while(size > 0)
+    {
+      int w = _write(fd, data, size);
+      if(w <= 0) return;
+      data += w;
+      size -= w;
+    }
+}
+#else
+static int openLog(const std::string &file)
+{
+  return open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+static void closeLog(int fd) { close(fd); }
+
+static void writeAll(int fd, const char *data, size_t size)
+{
+  while(size > 0)
+    {
+      ssize_t w = write(fd, data, size);
+      if(w < 0 && errno == EINTR) continue;
+      if(w <= 0) return;
+      data += w;
+      size -= w;
+    }
+}
+#endif
+
+static void putNum(char *out, int64_t val, int digits)
+{
+  for(int i=digits-1; i>=0; i--)
+    {
+      out[i] = '0' + val%10;
+      val /= 10;
+    }
+}
+
+/* Format a UTC time stamp into 'out' (STAMP_LEN chars, no
+   terminator). Done by hand instead of with gmtime() and strftime(),
+   which are neither thread safe nor async-signal-safe. The date
+   conversion is Howard Hinnant's civil_from_days().
+ */
+static void formatTime(time_t time, char *out)
+{
+  int64_t days = time / 86400, secs = time % 86400;
+  if(secs < 0) { secs += 86400; days--; }
+
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int64_t doe = days - era * 146097;
+  int64_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+  int64_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+  int64_t mp = (5*doy + 2) / 153;
+  int64_t day = doy - (153*mp + 2)/5 + 1;
+  int64_t month = mp < 10 ? mp+3 : mp-9;
+  int64_t year = yoe + era*400 + (month <= 2);
+
+  putNum(out, year, 4);
+  out[4] = '-';
+  putNum(out+5, month, 2);
+  out[7] = '-';
+  putNum(out+8, day, 2);
+  out[10] = ' ';
+  putNum(out+11, secs/3600, 2);
+  out[13] = ':';
+  putNum(out+14, (secs/60)%60, 2);
+  out[16] = ':';
+  putNum(out+17, secs%60, 2);
+}
+
+/* One line in the queue. 'seq' tells who owns the slot: if it equals
+   the slot's next queue position, it is free for a producer to fill
+   in. Once filled in, it is set to position+1, which hands it to the
+   writer thread. The writer hands it back by adding QUEUE_SIZE.
+ */
+struct Slot
+{
+  boost::atomic<unsigned> seq;
+  time_t time;
+  std::string msg;
+};
+
+struct Logger::_Internal
+{
+  int fd;
+
+  /* Bounded lock-free queue, with any number of producers and the
+     writer thread as the only consumer. Producers claim a position by
+     advancing 'tail', fill in the slot, and then publish it through
+     its 'seq'. Only the writer thread moves 'head'.
+   */
+  Slot ring[QUEUE_SIZE];
+  boost::atomic<unsigned> head, tail;
+
+  /* The writer thread sleeps when the queue is empty. It sets
+     'sleeping' before its last look at the queue, and producers check
+     it after publishing a line, so one of them always sees the other.
+     The mutex is only used for sleeping and waking up.
+   */
+  boost::atomic<bool> sleeping, quit;
+  boost::mutex mutex;
+  boost::condition_variable wake, hasRoom, isIdle;
+  boost::thread thread;
+
+  _Internal(const std::string &file)
+    : head(0), tail(0), sleeping(false), quit(false)
+  {
+    for(unsigned i=0; i<QUEUE_SIZE; i++)
+      ring[i].seq.store(i, boost::memory_order_relaxed);
+
+    fd = openLog(file);
+    addLive(this);
+    thread = boost::thread(boost::bind(&_Internal::run, this));
+  }
+
+  ~_Internal()
+  {
+    quit = true;
+    wakeWriter();
+    thread.join();
+    removeLive(this);
+    if(fd != -1) closeLog(fd);
+  }
+
+  void wakeWriter()
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    wake.notify_one();
+  }
+
+  bool isFull(unsigned pos)
+  {
+    return (int)(ring[pos % QUEUE_SIZE].seq.load(boost::memory_order_acquire)
+                 - pos) < 0;
+  }
+
+  void push(const std::string &msg)
+  {
+    Slot *s;
+    unsigned pos = tail.load(boost::memory_order_relaxed);
+    while(true)
+      {
+        s = &ring[pos % QUEUE_SIZE];
+        int dif = (int)(s->seq.load(boost::memory_order_acquire) - pos);
+
+        if(dif == 0)
+          {
+            // The slot is free, try to claim it
+            if(tail.compare_exchange_weak(pos, pos+1, boost::memory_order_relaxed))
+              break;
+          }
+        else if(dif < 0)
+          {
+            // Queue is full. Wait for the writer to make room.
+            boost::unique_lock<boost::mutex> lock(mutex);
+            wake.notify_one();
+            if(isFull(pos))
+              hasRoom.wait(lock);
+            pos = tail.load(boost::memory_order_relaxed);
+          }
+        else
+          // Someone else claimed it first
+          pos = tail.load(boost::memory_order_relaxed);
+      }
+
+    s->time = std::time(NULL);
+    s->msg = msg;
+    s->seq.store(pos+1);
+
+    if(sleeping.load())
+      wakeWriter();
+  }
+
+  // True if the line at 'pos' has been published to the writer
+  bool isReady(unsigned pos)
+  {
+    return ring[pos % QUEUE_SIZE].seq.load(boost::memory_order_acquire) == pos+1;
+  }
+
+  void flush()
+  {
+    unsigned target = tail.load();
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while((int)(head.load() - target) < 0)
+      isIdle.wait(lock);
+  }
+
+  // Writer thread
+  void run()
+  {
+    std::string batch;
+    time_t lastTime = 0;
+    char stamp[STAMP_LEN];
+    formatTime(lastTime, stamp);
+
+    while(true)
+      {
+        // Grab everything in the queue, and format it into one buffer
+        unsigned pos = head.load(boost::memory_order_relaxed);
+        unsigned end = pos;
+        batch.clear();
+        while(end - pos < QUEUE_SIZE && isReady(end))
+          {
+            const Slot &s = ring[end % QUEUE_SIZE];
+            if(s.time != lastTime)
+              {
+                lastTime = s.time;
+                formatTime(lastTime, stamp);
+              }
+            batch.append(stamp, STAMP_LEN);
+            batch += ":   ";
+            batch += s.msg;
+            batch += '\n';
+            end++;
+          }
+
+        if(end == pos)
+          {
+            // Nothing to write. Sleep until a producer wakes us up.
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if(quit) break;
+            sleeping = true;
+            if(ring[pos % QUEUE_SIZE].seq.load() != pos+1 && !quit)
+              wake.wait(lock);
+            sleeping = false;
+            continue;
+          }
+
+        // One write per batch. Since the writer never lags far behind,
+        // we still get most of the log on disk in case of crashes.
+        if(fd != -1)
+          writeAll(fd, batch.c_str(), batch.size());
+
+        // Hand the slots back to the producers. The strings keep their
+        // buffers, so the next lines usually don't need to allocate.
+        for(unsigned i=pos; i!=end; i++)
+          ring[i % QUEUE_SIZE].seq.store(i + QUEUE_SIZE, boost::memory_order_release);
+        head.store(end);
+
+        {
+          boost::lock_guard<boost::mutex> lock(mutex);
+        }
+        hasRoom.notify_all();
+        isIdle.notify_all();
+      }
+  }
+
+  /* Fatal signal handling. We keep a list of all live loggers, and
+     write out their queued lines before the process dies.
+
+     The handler only reads the queue and calls write(), so it is safe
+     to run at any point. Lines the writer thread is writing at the
+     same moment may end up in the log twice.
+   */
+  static boost::atomic<_Internal*> live[MAX_LOGGERS];
+
+  static void addLive(_Internal *p)
+  {
+    for(int i=0; i<MAX_LOGGERS; i++)
+      {
+        _Internal *empty = NULL;
+        if(live[i].compare_exchange_strong(empty, p))
+          return;
+      }
+  }
+
+  static void removeLive(_Internal *p)
+  {
+    for(int i=0; i<MAX_LOGGERS; i++)
+      {
+        _Internal *mine = p;
+        live[i].compare_exchange_strong(mine, NULL);
+      }
+  }
+
+  void rescue()
+  {
+    if(fd == -1) return;
+
+    char stamp[STAMP_LEN + 4];
+    unsigned pos = head.load();
+    for(unsigned i=0; i<QUEUE_SIZE && isReady(pos+i); i++)
+      {
+        const Slot &s = ring[(pos+i) % QUEUE_SIZE];
+        formatTime(s.time, stamp);
+        memcpy(stamp + STAMP_LEN, ":   ", 4);
+        writeAll(fd, stamp, sizeof(stamp));
+        writeAll(fd, s.msg.data(), s.msg.size());
+        writeAll(fd, "\n", 1);
+      }
+  }
+
+  static void rescueAll()
+  {
+    for(int i=0; i<MAX_LOGGERS; i++)
+      {
+        _Internal *p = live[i].load();
+        if(p) p->rescue();
+      }
+  }
+};
+
+boost::atomic<Logger::_Internal*> Logger::_Internal::live[MAX_LOGGERS];
+
+static const int crashSignals[] = { SIGSEGV, SIGABRT, SIGFPE, SIGILL };
+#define NUM_SIGNALS (sizeof(crashSignals)/sizeof(crashSignals[0]))
+
+#ifdef _WIN32
+typedef void (*Handler)(int);
+static Handler oldHandlers[NUM_SIGNALS];
+
+static void restoreHandler(int sig)
+{
+  for(int i=0; i<NUM_SIGNALS; i++)
+    if(crashSignals[i] == sig)
+      signal(sig, oldHandlers[i] == SIG_ERR ? SIG_DFL : oldHandlers[i]);
+}
+#else
+static struct sigaction oldHandlers[NUM_SIGNALS];
+
+static void restoreHandler(int sig)
+{
+  for(int i=0; i<NUM_SIGNALS; i++)
+    if(crashSignals[i] == sig)
+      sigaction(sig, &oldHandlers[i], NULL);
+}
+#endif
+
+/* Write out the queues, then pass the signal on to whoever handled it
+   before us (usually the default handler, which ends the process.)
+   On POSIX the raised signal is blocked until we return. Faults like
+   SIGSEGV would also simply happen again on return.
+ */
+void Logger::onSignal(int sig)
+{
+  _Internal::rescueAll();
+  restoreHandler(sig);
+  raise(sig);
+}
+
+void Logger::catchCrashes()
+{
+  static bool installed = false;
+  if(installed) return;
+  installed = true;
+
+  for(int i=0; i<NUM_SIGNALS; i++)
+    {
+#ifdef _WIN32
+      oldHandlers[i] = signal(crashSignals[i], onSignal);
+#else
+      struct sigaction act;
+      memset(&act, 0, sizeof(act));
+      act.sa_handler = onSignal;
+      sigemptyset(&act.sa_mask);
+      sigaction(crashSignals[i], &act, &oldHandlers[i]);
+#endif
+    }
+}
+
 Logger::Logger(const std::string &file)
   : filename(file), print(false)
 {
@@ -15,18 +416,21 @@ Logger::Logger(const std::string &file)
         bf::remove(old);
       bf::rename(file, old);
     }
-  log.open(file.c_str());
+  ptr.reset(new _Internal(file));
 }
 
+Logger::~Logger()
+{
+  // Make sure the writer thread is shut down before any other
+  // members go away.
+  ptr.reset();
+}
+
+void Logger::flush() { ptr->flush(); }
+
 void Logger::operator()(const std::string &msg)
 {
   if(print)
     std::cout << filename << ": " << msg << "\n";
-  char buf[100];
-  time_t now = std::time(NULL);
-  std::strftime(buf, 100, "%Y-%m-%d %H:%M:%S", gmtime(&now));
-  log << buf << ":   " << msg << "\n";
-  // Flush after each line in case of crashes
-  log.flush();
+  ptr->push(msg);
 }
-
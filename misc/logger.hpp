@@ -2,20 +2,56 @@
 #define __MISC_LOGGER_HPP_
 
 #include <string>
-#include <fstream>
+#include <boost/shared_ptr.hpp>
 
 namespace Misc
 {
+  /* Simple time stamped log file writer.
+
+     Log lines are queued in memory, and written to disk in batches by
+     a background thread. This keeps file I/O out of the calling
+     thread, so it's fine to log from inside busy loops such as file
+     copying. Several threads may log through the same Logger at
+     once.
+
+     The queue is lock-free, so logging threads never wait for each
+     other or for the writer, unless the queue is full.
+
+     All queued lines are written when the Logger is destroyed. Call
+     catchCrashes() to also have them written if the process is
+     killed by a fatal signal (segfault, abort etc.)
+   */
   struct Logger
   {
-    std::ofstream log;
     std::string filename;
 
     // Set to true to write to stdout as well as to the log file
     bool print;
 
     Logger(const std::string &file);
+    ~Logger();
+
     void operator()(const std::string &msg);
+
+    // Wait until all queued lines have been written to disk
+    void flush();
+
+    /* Write out the queues of all loggers on SIGSEGV, SIGABRT, SIGFPE
+       and SIGILL, before passing the signal on to the previously
+       installed handlers. Affects the whole process, so this is left
+       to the application to call, once, at startup.
+     */
+    static void catchCrashes();
+
+  private:
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+
+    static void onSignal(int sig);
+
+    // Not copyable
+    Logger(const Logger&);
+    Logger &operator=(const Logger&);
   };
 }
 
@@ -0,0 +1,214 @@
+#include "metrics.hpp"
+
+#include <map>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <stdio.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace Misc;
+
+/* Histogram bucket layout. Values below SUB_COUNT get a bucket each.
+   Above that, each power of two is split into SUB_COUNT linear
+   sub-buckets, giving a relative precision of 1/SUB_COUNT.
+ */
+#define SUB_BITS 3
+#define SUB_COUNT (1<<SUB_BITS)
+#define BUCKETS (62*SUB_COUNT)
+
+namespace
+{
+  struct Histogram
+  {
+    std::vector<int64_t> buckets;
+    int64_t count, sum, min, max;
+
+    Histogram() : count(0), sum(0), min(0), max(0) {}
+
+    static int getBucket(int64_t val)
+    {
+      if(val < SUB_COUNT) return (int)val;
+
+      int msb = 0;
+      for(int64_t v = val; v > 1; v >>= 1) msb++;
+      int shift = msb - SUB_BITS;
+      int sub = (int)((val >> shift) & (SUB_COUNT-1));
+      return (shift+1)*SUB_COUNT + sub;
+    }
+
+    // Representative value (middle) of a given bucket
+    static int64_t bucketValue(int index)
+    {
+      if(index < SUB_COUNT) return index;
+
+      int shift = index/SUB_COUNT - 1;
+      int sub = index%SUB_COUNT;
+      int64_t low = (int64_t)(SUB_COUNT + sub) << shift;
+      int64_t width = (int64_t)1 << shift;
+      return low + width/2;
+    }
+
+    void add(int64_t val)
+    {
+      if(val < 0) val = 0;
+      if(buckets.empty()) buckets.resize(BUCKETS);
+
+      int b = getBucket(val);
+      if(b >= BUCKETS) b = BUCKETS-1;
+      buckets[b]++;
+
+      if(count == 0 || val < min) min = val;
+      if(count == 0 || val > max) max = val;
+      count++;
+      sum += val;
+    }
+
+    // Get the value at the given percentile (0-100)
+    int64_t percentile(double pc) const
+    {
+      if(count == 0) return 0;
+
+      int64_t want = (int64_t)(count * pc / 100.0);
+      if(want >= count) want = count-1;
+
+      int64_t seen = 0;
+      for(int i=0; i<buckets.size(); i++)
+        {
+          seen += buckets[i];
+          if(seen > want)
+            {
+              int64_t val = bucketValue(i);
+              if(val < min) val = min;
+              if(val > max) val = max;
+              return val;
+            }
+        }
+      return max;
+    }
+  };
+
+  typedef std::map<std::string, int64_t> ValueMap;
+  typedef std::map<std::string, Histogram> HistMap;
+
+  boost::mutex mutex;
+  ValueMap counters, gauges;
+  HistMap hists;
+
+  const boost::posix_time::ptime epoch =
+    boost::posix_time::microsec_clock::universal_time();
+}
+
+int64_t Metrics::now()
+{
+  using namespace boost::posix_time;
+  return (microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+void Metrics::count(const std::string &name, int64_t add)
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  counters[name] += add;
+}
+
+void Metrics::gauge(const std::string &name, int64_t value)
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  gauges[name] = value;
+}
+
+void Metrics::sample(const std::string &name, int64_t value)
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  hists[name].add(value);
+}
+
+void Metrics::throughput(const std::string &name, int64_t bytes, int64_t micros)
+{
+  if(bytes <= 0 || micros <= 0) return;
+  sample(name, (int64_t)(bytes * 1000000.0 / micros));
+}
+
+std::string Metrics::toText()
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  std::ostringstream out;
+
+  out << "Counters:\n";
+  for(ValueMap::iterator it = counters.begin(); it != counters.end(); it++)
+    out << "  " << it->first << " = " << it->second << "\n";
+
+  out << "\nGauges:\n";
+  for(ValueMap::iterator it = gauges.begin(); it != gauges.end(); it++)
+    out << "  " << it->first << " = " << it->second << "\n";
+
+  out << "\nHistograms:\n";
+  for(HistMap::iterator it = hists.begin(); it != hists.end(); it++)
+    {
+      const Histogram &h = it->second;
+      out << "  " << it->first << ": count=" << h.count;
+      if(h.count)
+        out << " min=" << h.min << " avg=" << h.sum/h.count
+            << " p50=" << h.percentile(50) << " p90=" << h.percentile(90)
+            << " p99=" << h.percentile(99) << " max=" << h.max;
+      out << "\n";
+    }
+
+  return out.str();
+}
+
+// Quote a metric name for JSON. Names may contain game ids, so they
+// can't be trusted to be plain identifiers.
+static std::string quote(const std::string &name)
+{
+  std::string res = "\"";
+  for(int i=0; i<name.size(); i++)
+    {
+      unsigned char c = name[i];
+      if(c == '"' || c == '\\')
+        {
+          res += '\\';
+          res += c;
+        }
+      else if(c < 0x20)
+        {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          res += buf;
+        }
+      else res += c;
+    }
+  return res + "\"";
+}
+
+void Metrics::writeJson(const std::string &file)
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  std::ofstream out(file.c_str());
+  if(!out) return;
+
+  out << "{\n  \"counters\": {";
+  for(ValueMap::iterator it = counters.begin(); it != counters.end(); it++)
+    out << (it == counters.begin() ? "\n" : ",\n")
+        << "    " << quote(it->first) << ": " << it->second;
+
+  out << "\n  },\n  \"gauges\": {";
+  for(ValueMap::iterator it = gauges.begin(); it != gauges.end(); it++)
+    out << (it == gauges.begin() ? "\n" : ",\n")
+        << "    " << quote(it->first) << ": " << it->second;
+
+  out << "\n  },\n  \"histograms\": {";
+  for(HistMap::iterator it = hists.begin(); it != hists.end(); it++)
+    {
+      const Histogram &h = it->second;
+      out << (it == hists.begin() ? "\n" : ",\n")
+          << "    " << quote(it->first) << ": { \"count\": " << h.count
+          << ", \"sum\": " << h.sum << ", \"min\": " << h.min
+          << ", \"max\": " << h.max << ", \"p50\": " << h.percentile(50)
+          << ", \"p90\": " << h.percentile(90) << ", \"p99\": "
+          << h.percentile(99) << " }";
+    }
+  out << "\n  }\n}\n";
+}
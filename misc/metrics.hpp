@@ -0,0 +1,62 @@
+#ifndef __MISC_METRICS_HPP_
+#define __MISC_METRICS_HPP_
+
+#include <string>
+#include <stdint.h>
+
+/* Simple process-wide metrics registry. Used to find out how long
+   things like data loading, downloads and list refreshes take on
+   real user machines.
+
+   There are three kinds of metrics, all identified by name:
+
+   - counters, which only ever increase (eg. total bytes copied)
+   - gauges, which hold the last value set (eg. number of running jobs)
+   - histograms, which collect a distribution of samples (eg. the time
+     taken by each list refresh)
+
+   Histograms use logarithmic buckets with linear sub-buckets (similar
+   to HDR histograms), so they have roughly constant relative
+   precision over the entire value range, and use a fixed amount of
+   memory no matter how many samples are added.
+
+   All functions are thread safe.
+ */
+
+namespace Misc
+{
+  namespace Metrics
+  {
+    void count(const std::string &name, int64_t add=1);
+    void gauge(const std::string &name, int64_t value);
+    void sample(const std::string &name, int64_t value);
+
+    // Microseconds since an arbitrary starting point
+    int64_t now();
+
+    /* Records the lifetime of the object, in microseconds, into the
+       named histogram.
+     */
+    struct Timer
+    {
+      const char *name;
+      int64_t start;
+
+      Timer(const char *_name) : name(_name), start(now()) {}
+      ~Timer() { sample(name, now()-start); }
+    };
+
+    /* Record a throughput sample (in bytes per second) into the named
+       histogram. Ignored if the elapsed time or byte count is zero.
+     */
+    void throughput(const std::string &name, int64_t bytes, int64_t micros);
+
+    // Get a human readable summary of all metrics
+    std::string toText();
+
+    // Write all metrics to a JSON file. Errors are ignored.
+    void writeJson(const std::string &file);
+  }
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "prewarm.hpp"
+#include "filecopy.hpp"
+#include "metrics.hpp"
+#include "priority.hpp"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <stdio.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+// Read size used where we can't just advise the OS
+#define CHUNK (256*1024)
+
+// Most we read through there, whatever the budget
+#define READ_MAX (32*1024*1024)
+
+static bool getATime(const std::string &file, int64_t &atime)
+{
+#ifdef _WIN32
+  struct _stati64 st;
+  if(_stati64(file.c_str(), &st) != 0) return false;
+  atime = (int64_t)st.st_atime * 1000000000;
+#else
+  struct stat st;
+  if(stat(file.c_str(), &st) != 0) return false;
+#ifdef __linux__
+  atime = (int64_t)st.st_atim.tv_sec * 1000000000 + st.st_atim.tv_nsec;
+#else
+  atime = (int64_t)st.st_atime * 1000000000;
+#endif
+#endif
+  return true;
+}
+
+static std::string fullPath(const std::string &dir, const std::string &rel)
+{ return (bf::path(dir) / rel).string(); }
+
+bool Prewarm::load(const std::string &file, Profile &prof)
+{
+  prof.clear();
+  std::ifstream inp(file.c_str());
+  std::string line;
+  if(!std::getline(inp, line) || line != "prewarm 1")
+    return false;
+
+  while(std::getline(inp, line))
+    if(line != "")
+      prof.push_back(line);
+  return !prof.empty();
+}
+
+void Prewarm::save(const std::string &file, const Profile &prof)
+{
+  try
+    {
+      bf::path dir = bf::path(file).parent_path();
+      if(!dir.empty()) bf::create_directories(dir);
+
+      std::string tmp = file + ".tmp";
+      {
+        std::ofstream out(tmp.c_str());
+        out << "prewarm 1\n";
+        for(int i=0; i<prof.size(); i++)
+          out << prof[i] << "\n";
+        if(!out) return;
+      }
+      bf::rename(tmp, file);
+    }
+  catch(...) {}
+}
+
+void Prewarm::snapshot(const std::string &dir, Snapshot &snap)
+{
+  snap.atimes.clear();
+
+  std::vector<FileCopy::FileInfo> files;
+  try { FileCopy::index(dir, files); }
+  catch(...) { return; }
+
+  for(int i=0; i<files.size(); i++)
+    {
+      int64_t atime;
+      if(getATime(fullPath(dir, files[i].name), atime))
+        snap.atimes[files[i].name] = atime;
+    }
+}
+
+typedef std::pair<int64_t, std::string> Access;
+
+bool Prewarm::learn(const std::string &dir, const Snapshot &snap, Profile &prof)
+{
+  prof.clear();
+
+  Snapshot now;
+  snapshot(dir, now);
+
+  // Files created after the snapshot (eg. saved games) were not read
+  // at startup, so only look at the old ones
+  std::vector<Access> read;
+  std::map<std::string, int64_t>::const_iterator it, old;
+  for(it = now.atimes.begin(); it != now.atimes.end(); it++)
+    {
+      old = snap.atimes.find(it->first);
+      if(old != snap.atimes.end() && it->second > old->second)
+        read.push_back(Access(it->second, it->first));
+    }
+
+  std::sort(read.begin(), read.end());
+  for(int i=0; i<read.size(); i++)
+    prof.push_back(read[i].second);
+  return !prof.empty();
+}
+
+static bool smallerFirst(const FileCopy::FileInfo &a, const FileCopy::FileInfo &b)
+{
+  if(a.size != b.size) return a.size < b.size;
+  return a.name < b.name;
+}
+
+void Prewarm::guess(const std::string &dir, const std::string &exe, Profile &prof)
+{
+  prof.clear();
+  prof.push_back(exe);
+
+  // Files next to the executable
+  bf::path exeDir = bf::path(exe).parent_path();
+  std::vector<FileCopy::FileInfo> files, near;
+  try { FileCopy::index(dir, files); }
+  catch(...) { return; }
+
+  for(int i=0; i<files.size(); i++)
+    if(bf::path(files[i].name).parent_path() == exeDir &&
+       files[i].name != exe)
+      near.push_back(files[i]);
+
+  std::sort(near.begin(), near.end(), smallerFirst);
+  for(int i=0; i<near.size(); i++)
+    prof.push_back(near[i].name);
+}
+
+// Get one file into the cache. Returns the bytes requested.
+static int64_t warmFile(const std::string &file, int64_t maxBytes)
+{
+#if defined(POSIX_FADV_WILLNEED)
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1) return 0;
+
+  struct stat st;
+  int64_t size = 0;
+  if(fstat(fd, &st) == 0) size = st.st_size;
+  if(size > maxBytes) size = maxBytes;
+
+  // Queues the reads and returns. The data stays cached after close.
+  if(size > 0 && posix_fadvise(fd, 0, size, POSIX_FADV_WILLNEED) != 0)
+    size = 0;
+  close(fd);
+  return size;
+#else
+  FILE *f = fopen(file.c_str(), "rb");
+  if(!f) return 0;
+
+  std::vector<char> buf(CHUNK);
+  int64_t total = 0;
+  while(total < maxBytes)
+    {
+      size_t got = fread(&buf[0], 1, CHUNK, f);
+      if(got == 0) break;
+      total += got;
+    }
+  fclose(f);
+  return total;
+#endif
+}
+
+int64_t Prewarm::warm(const std::string &dir, const Profile &prof, int64_t budget)
+{
+  Metrics::Timer tm("prewarm.warm_us");
+
+#ifndef POSIX_FADV_WILLNEED
+  /* Reading through competes with the game for the disk, so do it at
+     low priority, and only for the hottest files.
+   */
+  lowerThreadPriority();
+  if(budget > READ_MAX) budget = READ_MAX;
+#endif
+
+  int64_t total = 0;
+  for(int i=0; i<prof.size() && total < budget; i++)
+    total += warmFile(fullPath(dir, prof[i]), budget - total);
+
+  Metrics::count("prewarm.bytes", total);
+  return total;
+}
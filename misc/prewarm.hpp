@@ -0,0 +1,67 @@
+#ifndef __MISC_PREWARM_HPP_
+#define __MISC_PREWARM_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/* Read a game's files into the OS file cache before it starts, so a
+   cold launch doesn't wait for the disk one file at a time.
+
+   Which files to read comes from an access profile: the files the
+   game read during an earlier launch, in the order it first read them.
+   Profiles are learned from file access times. Take a snapshot()
+   before launching, and call learn() once the game has been running
+   for a while. Filesystems mounted with noatime (and Windows, where
+   access times are mostly off) record no accesses. In that case
+   guess() gives a rough profile instead.
+ */
+
+namespace Misc
+{
+  namespace Prewarm
+  {
+    // Paths relative to the game directory, hottest first
+    typedef std::vector<std::string> Profile;
+
+    // Access times (in nanoseconds) of all files in a directory
+    struct Snapshot
+    {
+      std::map<std::string, int64_t> atimes;
+    };
+
+    // Load and save profiles. load() returns false if there is no
+    // usable profile.
+    bool load(const std::string &file, Profile &prof);
+    void save(const std::string &file, const Profile &prof);
+
+    // Record the access times of all files in 'dir'
+    void snapshot(const std::string &dir, Snapshot &snap);
+
+    /* Make a profile of the files read since the snapshot was taken,
+       in the order they were read. Returns false if no file was read,
+       usually because access times aren't recorded.
+     */
+    bool learn(const std::string &dir, const Snapshot &snap, Profile &prof);
+
+    /* A profile for a game we know nothing about: the executable
+       first, then the other files in its directory, smallest first.
+       Games usually load their libraries and small data files from
+       there early on. 'exe' is relative to 'dir'.
+     */
+    void guess(const std::string &dir, const std::string &exe, Profile &prof);
+
+    /* Ask the OS to read the files in 'prof' into its cache, in
+       order, until 'budget' bytes have been requested. Where the OS
+       supports it (posix_fadvise) this only queues the reads and
+       returns at once. Elsewhere the files are read through, at most
+       32 MB of them, and the priority of the calling thread is
+       lowered first. So run this in a background thread. Returns the
+       number of bytes requested. Errors are ignored.
+     */
+    int64_t warm(const std::string &dir, const Profile &prof, int64_t budget);
+  }
+}
+
+#endif
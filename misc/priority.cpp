@@ -0,0 +1,24 @@
+#include "priority.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+void Misc::lowerThreadPriority()
+{
+#ifdef _WIN32
+  SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+  int tid = syscall(SYS_gettid);
+  setpriority(PRIO_PROCESS, tid, 10);
+
+#ifdef SYS_ioprio_set
+  // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+  syscall(SYS_ioprio_set, 1, tid, 3 << 13);
+#endif
+#endif
+}
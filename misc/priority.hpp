@@ -0,0 +1,13 @@
+#ifndef __MISC_PRIORITY_HPP_
+#define __MISC_PRIORITY_HPP_
+
+namespace Misc
+{
+  /* Lower the CPU and IO priority of the calling thread, for
+     background work that should not slow down the rest of the system.
+     Does nothing where the OS doesn't support it.
+   */
+  void lowerThreadPriority();
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "ratemeter.hpp"
+#include "metrics.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+using namespace Misc;
+
+// Shortest time between samples, in microseconds
+#define MIN_INTERVAL 100000
+
+RateMeter::RateMeter(double _halfLife)
+  : halfLife(_halfLife) { reset(); }
+
+void RateMeter::reset()
+{
+  rate = 0;
+  lastBytes = lastTime = 0;
+  started = hasRate = false;
+}
+
+void RateMeter::update(int64_t current, int64_t now)
+{
+  if(now < 0) now = Metrics::now();
+
+  // Progress went backwards, so this is a new job
+  if(started && current < lastBytes)
+    reset();
+
+  if(!started)
+    {
+      lastBytes = current;
+      lastTime = now;
+      started = true;
+      return;
+    }
+
+  int64_t dt = now - lastTime;
+  if(dt < MIN_INTERVAL) return;
+
+  double secs = dt / 1000000.0;
+  double sample = (current - lastBytes) / secs;
+  lastBytes = current;
+  lastTime = now;
+
+  if(!hasRate)
+    {
+      rate = sample;
+      hasRate = true;
+      return;
+    }
+
+  // Older measurements lose half their weight every 'halfLife'
+  // seconds
+  double alpha = 1 - std::pow(0.5, secs / halfLife);
+  rate += alpha * (sample - rate);
+}
+
+int64_t RateMeter::getETA(int64_t current, int64_t total) const
+{
+  if(!hasRate || rate <= 0 || total <= 0 || current > total)
+    return -1;
+  return (int64_t)((total - current) / rate + 0.5);
+}
+
+std::string RateMeter::rateString() const
+{
+  double r = getRate();
+  char buf[50];
+  if(r >= 1024*1024)
+    snprintf(buf, sizeof(buf), "%.1f MB/s", r/(1024*1024));
+  else if(r >= 1024)
+    snprintf(buf, sizeof(buf), "%.1f KB/s", r/1024);
+  else
+    snprintf(buf, sizeof(buf), "%d B/s", (int)r);
+  return buf;
+}
+
+std::string RateMeter::etaString(int64_t secs)
+{
+  if(secs < 0) return "";
+
+  char buf[50];
+  int h = (int)(secs/3600), m = (int)(secs/60%60), s = (int)(secs%60);
+  if(h)
+    snprintf(buf, sizeof(buf), "%d:%02d:%02d", h, m, s);
+  else
+    snprintf(buf, sizeof(buf), "%d:%02d", m, s);
+  return buf;
+}
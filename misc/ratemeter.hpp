@@ -0,0 +1,52 @@
+#ifndef __MISC_RATEMETER_HPP_
+#define __MISC_RATEMETER_HPP_
+
+#include <string>
+#include <stdint.h>
+
+/* Smoothed throughput and time-left estimates for progress displays.
+
+   The rate is an exponentially weighted moving average of the
+   measured speed, weighted by time rather than by sample, so it
+   behaves the same no matter how often update() is called. A
+   half-life of a few seconds gives numbers that follow real changes
+   in speed without jumping around on every sample.
+ */
+
+namespace Misc
+{
+  class RateMeter
+  {
+    double halfLife, rate;
+    int64_t lastBytes, lastTime;
+    bool started, hasRate;
+
+  public:
+    // 'halfLife' is in seconds
+    RateMeter(double halfLife=3.0);
+
+    // Forget all measurements, eg. when a new job starts
+    void reset();
+
+    /* Feed the current progress. 'now' is in microseconds (see
+       Metrics::now()), and defaults to the current time. Samples
+       closer together than 100ms are combined.
+     */
+    void update(int64_t current, int64_t now=-1);
+
+    // Smoothed rate in units (usually bytes) per second. Zero if not
+    // yet known.
+    double getRate() const { return hasRate ? rate : 0; }
+
+    // Estimated seconds left, or -1 if unknown
+    int64_t getETA(int64_t current, int64_t total) const;
+
+    // Eg. "2.1 MB/s"
+    std::string rateString() const;
+
+    // Eg. "1:02:03", "2:05", or "" if unknown
+    static std::string etaString(int64_t secs);
+  };
+}
+
+#endif
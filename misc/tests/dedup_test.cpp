@@ -0,0 +1,82 @@
+#include "dedup.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+void write(const bf::path &p, const string &data)
+{
+  bf::create_directories(p.parent_path());
+  ofstream out(p.string().c_str(), ios::binary);
+  out << data;
+}
+
+/* Whether anything gets linked depends on the filesystem the test
+   runs on, so only print what doesn't.
+ */
+void print(const string &what, const Dedup::Report &r)
+{
+  cout << what << ": files=" << r.files << " dupes=" << r.dupes
+       << " dupeBytes=" << r.dupeBytes
+       << " savedMatchesLinked=" << (r.savedBytes == r.linked*10000)
+       << endl;
+}
+
+int main()
+{
+  bf::remove_all("_dd");
+
+  string runtime(10000, 'r');
+  string other(10000, 'o');
+  string small = "tiny file";
+
+  write("_dd/game1/lib/runtime.dll", runtime);
+  write("_dd/game1/game.exe", "game one");
+  write("_dd/game1/small.txt", small);
+  write("_dd/game2/runtime.dll", runtime);
+  write("_dd/game2/small.txt", small);
+  write("_dd/game3/bin/runtime.dll", runtime);
+
+  // Same size, different content
+  write("_dd/game3/data.pak", other);
+
+  vector<string> dirs;
+  dirs.push_back("_dd/game1");
+  dirs.push_back("_dd/game2");
+  dirs.push_back("_dd/game3");
+  dirs.push_back("_dd/missing");
+
+  Dedup::Report r1, r2, r3;
+  Dedup::run(dirs, Dedup::DRY_RUN, r1);
+  print("Dry run", r1);
+
+  cout << "Dry run linked: " << r1.linked << endl;
+
+  Dedup::run(dirs, Dedup::REFLINK, r2);
+  print("Linking", r2);
+
+  // Content must be unchanged
+  ifstream inp("_dd/game3/bin/runtime.dll", ios::binary);
+  string data((istreambuf_iterator<char>(inp)), istreambuf_iterator<char>());
+  cout << "Content intact: " << (data == runtime) << endl;
+
+  // Files that were linked are not found again
+  Dedup::run(dirs, Dedup::REFLINK, r3);
+  cout << "Second run: dupes left=" << (r3.dupes == r2.dupes - r2.linked)
+       << endl;
+
+  // Dedup must never leave shared files writable through each other
+  {
+    ofstream out("_dd/game2/runtime.dll", ios::binary);
+    out << other;
+  }
+  ifstream inp2("_dd/game1/lib/runtime.dll", ios::binary);
+  string data2((istreambuf_iterator<char>(inp2)), istreambuf_iterator<char>());
+  cout << "Other copies unchanged after write: " << (data2 == runtime) << endl;
+
+  bf::remove_all("_dd");
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include "dirwatch.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+DirWatch watch;
+
+void write(const string &file, const string &data)
+{
+  ofstream out(file.c_str());
+  out << data;
+}
+
+void print(const string &what)
+{
+  set<string> keys;
+  watch.getChanged(keys);
+  cout << what << ":";
+  for(set<string>::iterator it = keys.begin(); it != keys.end(); it++)
+    cout << " " << *it;
+  cout << endl;
+}
+
+int main()
+{
+  bf::remove_all("_watch");
+  bf::create_directories("_watch/game1/sub/deep");
+  bf::create_directories("_watch/game2");
+  write("_watch/game1/sub/deep/file", "hello");
+
+  cout << "Add game1: " << watch.add("game1", "_watch/game1") << endl;
+  cout << "Add game2: " << watch.add("game2", "_watch/game2") << endl;
+  cout << "Add missing: " << watch.add("game3", "_watch/game3") << endl;
+  cout << "Watched: " << watch.isWatched("game1") << watch.isWatched("game2")
+       << watch.isWatched("game3") << endl;
+
+  print("Nothing yet");
+
+  write("_watch/game1/sub/deep/file", "changed");
+  print("Changed deep file");
+  print("Again");
+
+  write("_watch/game2/new", "new file");
+  bf::remove("_watch/game1/sub/deep/file");
+  print("Both");
+
+  // New directories are watched as well
+  bf::create_directories("_watch/game2/newdir");
+  print("New dir");
+  write("_watch/game2/newdir/file", "in new dir");
+  print("File in new dir");
+
+  watch.remove("game1");
+  cout << "Removed: " << watch.isWatched("game1") << endl;
+  write("_watch/game1/sub/other", "ignored");
+  print("After remove");
+
+  bf::remove_all("_watch");
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "filecopy.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+void write(const bf::path &p, const string &data)
+{
+  bf::create_directories(p.parent_path());
+  ofstream out(p.string().c_str());
+  out << data;
+}
+
+void printDir(const string &dir)
+{
+  vector<FileCopy::FileInfo> files;
+  FileCopy::index(dir, files);
+  cout << dir << ": " << files.size() << " files\n";
+  for(int i=0; i<files.size(); i++)
+    cout << "  " << files[i].name << " (" << files[i].size << ")\n";
+}
+
+bool abortAfter(int64_t cur, int64_t tot, int64_t limit)
+{
+  return cur < limit;
+}
+
+int main()
+{
+  bf::remove_all("_fc_in");
+  bf::remove_all("_fc_out");
+
+  write("_fc_in/a.txt", "hello");
+  write("_fc_in/b/c.txt", "world!");
+  write("_fc_in/b/d/e.txt", "");
+  bf::create_directories("_fc_in/empty");
+
+  // Lots of small files spread over a few directories
+  for(int i=0; i<200; i++)
+    {
+      stringstream name;
+      name << "_fc_in/many/" << (i%7) << "/file" << i;
+      write(name.str(), "xyz");
+    }
+
+  vector<FileCopy::FileInfo> files;
+  FileCopy::index("_fc_in", files);
+  cout << "Indexed " << files.size() << " files\n";
+  int64_t total = 0;
+  for(int i=0; i<files.size(); i++)
+    total += files[i].size;
+  cout << "Total size " << total << endl;
+
+  // Copy everything except the 'many' dir
+  vector<FileCopy::Entry> lst;
+  for(int i=0; i<files.size(); i++)
+    {
+      if(files[i].name.substr(0,4) == "many") continue;
+      FileCopy::Entry e;
+      e.from = (bf::path("_fc_in")/files[i].name).string();
+      e.to = (bf::path("_fc_out")/files[i].name).string();
+      e.size = files[i].size;
+      lst.push_back(e);
+    }
+  cout << "Copy: " << FileCopy::copy(lst) << endl;
+  printDir("_fc_out");
+
+  cout << "Copy again (should fail):\n";
+  try { FileCopy::copy(lst); }
+  catch(exception &e) { cout << "  Got error\n"; }
+
+  // Aborting partway through
+  bf::remove_all("_fc_out");
+  lst.clear();
+  for(int i=0; i<files.size(); i++)
+    {
+      FileCopy::Entry e;
+      e.from = (bf::path("_fc_in")/files[i].name).string();
+      e.to = (bf::path("_fc_out")/files[i].name).string();
+      e.size = files[i].size;
+      lst.push_back(e);
+    }
+  bool res = FileCopy::copy(lst, boost::bind(&abortAfter, _1, _2, 100));
+  vector<FileCopy::FileInfo> out;
+  FileCopy::index("_fc_out", out);
+  cout << "Aborted copy: " << res << ", partial=" << (out.size() < files.size()) << endl;
+
+  // Full copy
+  bf::remove_all("_fc_out");
+  cout << "Full copy: " << FileCopy::copy(lst) << endl;
+  out.clear();
+  FileCopy::index("_fc_out", out);
+  cout << "Copied " << out.size() << " files\n";
+
+  cout << "Index non-existing dir:\n";
+  try { printDir("_fc_nothing"); }
+  catch(exception &e) { cout << "  Got error\n"; }
+
+  bf::remove_all("_fc_in");
+  bf::remove_all("_fc_out");
+  return 0;
+}
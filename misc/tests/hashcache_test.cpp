@@ -0,0 +1,90 @@
+#include "hashcache.hpp"
+#include "filehash.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <ctime>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+void write(const string &file, const string &data)
+{
+  bf::create_directories(bf::path(file).parent_path());
+  ofstream out(file.c_str(), ios::binary);
+  out << data;
+}
+
+// Pretend the file was written a while ago
+void age(const string &file)
+{
+  bf::last_write_time(file, time(NULL) - 100);
+}
+
+void check(const string &file)
+{
+  uint64_t hash = 0;
+  bool found = HashCache::lookup(file, hash);
+  cout << "  " << file << ": known=" << found;
+  if(found) cout << " correct=" << (hash == hashFile(file));
+  cout << endl;
+}
+
+int main()
+{
+  bf::remove_all("_hashcache");
+  write("_hashcache/dir/a.txt", "hello");
+  write("_hashcache/dir/sub/b.txt", "world");
+  write("_hashcache/other.txt", "other");
+
+  cout << "Nothing hashed yet:\n";
+  check("_hashcache/dir/a.txt");
+
+  cout << "Just written, so not trusted:\n";
+  HashCache::hashFile("_hashcache/dir/a.txt");
+  check("_hashcache/dir/a.txt");
+
+  age("_hashcache/dir/a.txt");
+  age("_hashcache/dir/sub/b.txt");
+  age("_hashcache/other.txt");
+  cout << "Same hash as hashFile(): "
+       << (HashCache::hashFile("_hashcache/dir/a.txt") ==
+           hashFile("_hashcache/dir/a.txt")) << endl;
+  HashCache::hashFile("_hashcache/dir/sub/b.txt");
+  HashCache::hashFile("_hashcache/other.txt");
+  cout << "Old files:\n";
+  check("_hashcache/dir/a.txt");
+  check("_hashcache/dir/sub/b.txt");
+  check("_hashcache/other.txt");
+
+  cout << "After change:\n";
+  write("_hashcache/dir/sub/b.txt", "changed");
+  age("_hashcache/dir/sub/b.txt");
+  check("_hashcache/dir/sub/b.txt");
+  HashCache::hashFile("_hashcache/dir/sub/b.txt");
+  check("_hashcache/dir/sub/b.txt");
+
+  cout << "Reloaded:\n";
+  HashCache::load("_hashcache/table.txt");
+  check("_hashcache/dir/a.txt");
+  HashCache::hashFile("_hashcache/dir/a.txt");
+  HashCache::hashFile("_hashcache/dir/sub/b.txt");
+  HashCache::hashFile("_hashcache/other.txt");
+  HashCache::save();
+  HashCache::load("_hashcache/table.txt");
+  check("_hashcache/dir/a.txt");
+  check("_hashcache/dir/sub/b.txt");
+
+  cout << "Forget dir:\n";
+  HashCache::forget("_hashcache/dir");
+  check("_hashcache/dir/a.txt");
+  check("_hashcache/dir/sub/b.txt");
+  check("_hashcache/other.txt");
+
+  cout << "Missing file:\n";
+  check("_hashcache/nothing.txt");
+
+  bf::remove_all("_hashcache");
+  return 0;
+}
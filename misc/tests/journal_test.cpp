@@ -0,0 +1,125 @@
+#include "tiglib/journalconf.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace TigLib;
+namespace bf = boost::filesystem;
+
+#define CONF "_journal/test.conf"
+#define JOURNAL CONF ".journal"
+
+void show(const string &what)
+{
+  JournalConf conf;
+  conf.load(CONF, true);
+  cout << what << ": a=" << conf.get("a", "-") << " b=" << conf.get("b", "-")
+       << " c=" << conf.get("c", "-") << endl;
+}
+
+void append(const string &file, const string &data)
+{
+  ofstream out(file.c_str(), ios::binary | ios::app);
+  out << data;
+}
+
+void copy(const string &from, const string &to)
+{
+  bf::remove(to);
+  bf::copy_file(from, to);
+}
+
+int main()
+{
+  bf::remove_all("_journal");
+  bf::create_directories("_journal");
+
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    conf.set("a", "1");
+    conf.set("b", "2");
+    conf.flush();
+    cout << "Journal after flush: " << bf::exists(JOURNAL) << endl;
+    cout << "Main file after flush: " << bf::exists(CONF) << endl;
+  }
+  show("Reloaded");
+
+  // Loading folds the journal into the main file
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    cout << "Journal after load: " << bf::exists(JOURNAL) << endl;
+    cout << "Main file after load: " << bf::exists(CONF) << endl;
+  }
+
+  // A crash in the middle of a write leaves a torn record at the end
+  append(JOURNAL, "1 1 c3\n");
+  append(JOURNAL, "1 5 a12");
+  show("Torn record");
+
+  // New changes must still be readable after the torn record
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    cout << "Journal after torn load: " << bf::exists(JOURNAL) << endl;
+    conf.set("b", "4");
+    conf.flush();
+  }
+  show("After torn record");
+
+  // Nothing but a torn record
+  {
+    JournalConf conf;
+    conf.load(CONF);
+  }
+  append(JOURNAL, "1 1");
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    cout << "Journal with only a torn record: " << bf::exists(JOURNAL) << endl;
+    conf.set("c", "5");
+  }
+  show("After only a torn record");
+
+  /* A crash after the new main file is in place, but before the
+     journal is removed. Replaying the journal over the new file must
+     give the same result as over the old one.
+   */
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    conf.set("a", "6");
+    conf.set("b", "7");
+    conf.flush();
+    copy(JOURNAL, "_journal/saved");
+    conf.compact();
+    cout << "Journal after compact: " << bf::exists(JOURNAL) << endl;
+  }
+  show("After compact");
+  copy("_journal/saved", JOURNAL);
+  show("Old journal over new file");
+
+  // Changes still pending when compacting are not lost
+  {
+    JournalConf conf;
+    conf.load(CONF);
+    conf.set("a", "8");
+    conf.compact();
+    cout << "Journal after compacting pending: " << bf::exists(JOURNAL) << endl;
+  }
+  show("Compacted pending");
+
+  // A crash before the rename leaves a temporary file, which is ignored
+  append(CONF ".tmp", "garbage");
+  show("Leftover temp file");
+  {
+    JournalConf conf;
+    conf.load(CONF);
+  }
+  show("Reloaded again");
+
+  bf::remove_all("_journal");
+  return 0;
+}
@@ -38,5 +38,42 @@ int main()
   cout << "Checking:\n";
   w(lockA.isLocked());
   w(lockB.isLocked());
+
+  lockA.unlock();
+  lockB.unlock();
+
+  Misc::LockFile read1("_lock2"), read2("_lock2"), write("_lock2");
+
+  cout << "Shared locks:\n";
+  w(read1.lockShared());
+  w(read2.lockShared());
+  w(read1.isShared());
+
+  cout << "Writer waits for readers:\n";
+  w(write.lock());
+  read1.unlock();
+  w(write.lock());
+  read2.unlock();
+  w(write.lock());
+
+  cout << "Readers wait for writer:\n";
+  w(read1.lockShared());
+
+  cout << "Owner:\n";
+  w(read1.getOwner() != 0);
+  w(Misc::LockFile::isAlive(read1.getOwner()));
+  write.unlock();
+  w(read1.getOwner() != 0);
+  w(read1.lockShared());
+  read1.unlock();
+
+  cout << "Missing lock file:\n";
+  Misc::LockFile missing("_nodir/_lock3");
+  w(missing.lockShared());
+  w(missing.isShared());
+  w(missing.getOwner() != 0);
+  missing.unlock();
+  w(missing.isLocked());
+  w(missing.lock());
   return 0;
 }
@@ -0,0 +1,69 @@
+#include "logger.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+using namespace std;
+
+void spam(Misc::Logger *log, int id, int lines)
+{
+  for(int i=0; i<lines; i++)
+    {
+      stringstream str;
+      str << "thread " << id << " line " << i;
+      (*log)(str.str());
+    }
+}
+
+// Print the log file without time stamps
+void dump(const std::string &file, int maxLines=1000000)
+{
+  ifstream inp(file.c_str());
+  string line;
+  int lines = 0;
+  while(getline(inp, line))
+    {
+      if(lines++ < maxLines)
+        cout << "  " << line.substr(line.find(":   ")+4) << endl;
+    }
+  cout << "Total lines: " << lines << endl;
+}
+
+int main()
+{
+  {
+    Misc::Logger log("_log1.txt");
+    log("Hello");
+    log("World");
+    log.flush();
+    cout << "After flush:\n";
+    dump("_log1.txt");
+    log("Last line");
+  }
+  cout << "After destruction:\n";
+  dump("_log1.txt");
+
+  cout << "Reopened:\n";
+  {
+    Misc::Logger log("_log1.txt");
+    log("New file");
+  }
+  dump("_log1.txt");
+  cout << "Old file:\n";
+  dump("_log1.txt.old");
+
+  cout << "Logging from several threads:\n";
+  {
+    Misc::Logger log("_log2.txt");
+    boost::thread t1(boost::bind(&spam, &log, 1, 3000));
+    boost::thread t2(boost::bind(&spam, &log, 2, 3000));
+    spam(&log, 0, 3000);
+    t1.join();
+    t2.join();
+  }
+  dump("_log2.txt", 0);
+
+  return 0;
+}
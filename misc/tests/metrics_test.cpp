@@ -0,0 +1,47 @@
+#include "metrics.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+using namespace Misc;
+
+int main()
+{
+  cout << "Empty:\n" << Metrics::toText() << endl;
+
+  Metrics::count("files");
+  Metrics::count("files");
+  Metrics::count("bytes", 12345);
+  Metrics::gauge("jobs", 5);
+  Metrics::gauge("jobs", 3);
+
+  // 1..1000, so percentiles are easy to check
+  for(int i=1; i<=1000; i++)
+    Metrics::sample("linear", i);
+
+  // Wide range of values
+  for(int i=0; i<40; i++)
+    Metrics::sample("powers", (int64_t)1 << i);
+
+  Metrics::sample("negative", -10);
+
+  // Names that need escaping in JSON
+  Metrics::gauge("quote\"back\\slash", 1);
+  Metrics::gauge("tab\tname", 2);
+
+  Metrics::throughput("speed", 1000000, 500000);
+  Metrics::throughput("speed", 0, 1000);
+  Metrics::throughput("speed", 1000, 0);
+
+  cout << "Filled:\n" << Metrics::toText() << endl;
+
+  Metrics::writeJson("_metrics.json");
+  ifstream inp("_metrics.json");
+  string line;
+  cout << "JSON:\n";
+  while(getline(inp, line))
+    cout << line << endl;
+
+  return 0;
+}
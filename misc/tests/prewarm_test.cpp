@@ -0,0 +1,83 @@
+#include "prewarm.hpp"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+#include <utime.h>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+#define DIR "_prewarm"
+
+void make(const string &name, int size)
+{
+  string file = string(DIR) + "/" + name;
+  bf::create_directories(bf::path(file).parent_path());
+  ofstream out(file.c_str(), ios::binary);
+  out << string(size, 'x');
+}
+
+// Pretend a file was read at time 't'
+void touch(const string &name, time_t t)
+{
+  string file = string(DIR) + "/" + name;
+  struct utimbuf ut;
+  ut.actime = t;
+  ut.modtime = 1000;
+  utime(file.c_str(), &ut);
+}
+
+void print(const Prewarm::Profile &prof)
+{
+  for(int i=0; i<prof.size(); i++)
+    cout << "  " << prof[i] << endl;
+}
+
+int main()
+{
+  bf::remove_all(DIR);
+  make("game.exe", 10);
+  make("lib.dll", 5);
+  make("readme.txt", 20);
+  make("data/big.pak", 100);
+  make("data/unused.pak", 30);
+
+  const char *all[] = { "game.exe", "lib.dll", "readme.txt", "data/big.pak",
+                        "data/unused.pak" };
+  for(int i=0; i<5; i++)
+    touch(all[i], 1000);
+
+  Prewarm::Snapshot snap;
+  Prewarm::snapshot(DIR, snap);
+  cout << "Snapshot: " << snap.atimes.size() << " files\n";
+
+  Prewarm::Profile prof;
+  cout << "Nothing read: " << Prewarm::learn(DIR, snap, prof) << endl;
+
+  // The game reads a few files, in this order
+  touch("game.exe", 2000);
+  touch("data/big.pak", 2001);
+  touch("lib.dll", 2002);
+  make("save.dat", 50);
+
+  cout << "Learned: " << Prewarm::learn(DIR, snap, prof) << endl;
+  print(prof);
+
+  Prewarm::save(DIR "/profile.txt", prof);
+  Prewarm::Profile loaded;
+  cout << "Loaded: " << Prewarm::load(DIR "/profile.txt", loaded)
+       << " same=" << (loaded == prof) << endl;
+  Prewarm::Profile none;
+  cout << "Missing: " << Prewarm::load(DIR "/none.txt", none) << endl;
+
+  cout << "Guessed:\n";
+  Prewarm::guess(DIR, "game.exe", prof);
+  print(prof);
+
+  cout << "Warm all: " << Prewarm::warm(DIR, loaded, 1000) << endl;
+  cout << "Warm 50: " << Prewarm::warm(DIR, loaded, 50) << endl;
+
+  bf::remove_all(DIR);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "ratemeter.hpp"
+
+#include <iostream>
+using namespace std;
+using namespace Misc;
+
+#define SEC 1000000
+
+void print(const RateMeter &m, int64_t cur, int64_t total)
+{
+  cout << "  " << cur << "/" << total << ": " << m.rateString()
+       << " eta=" << m.getETA(cur, total) << " ("
+       << RateMeter::etaString(m.getETA(cur, total)) << ")\n";
+}
+
+int main()
+{
+  RateMeter m(2.0);
+  const int64_t total = 100*1024*1024;
+
+  cout << "Nothing yet:\n";
+  print(m, 0, total);
+  m.update(0, 0);
+  print(m, 0, total);
+
+  cout << "Steady 1MB/s:\n";
+  int64_t cur = 0, t = 0;
+  for(int i=0; i<4; i++)
+    {
+      t += SEC/2;
+      cur += 512*1024;
+      m.update(cur, t);
+      print(m, cur, total);
+    }
+
+  cout << "Too soon, ignored:\n";
+  m.update(cur + 10*1024*1024, t + 1000);
+  print(m, cur, total);
+
+  cout << "Speeds up to 4MB/s:\n";
+  for(int i=0; i<8; i++)
+    {
+      t += SEC;
+      cur += 4*1024*1024;
+      m.update(cur, t);
+      print(m, cur, total);
+    }
+
+  cout << "Stalls:\n";
+  for(int i=0; i<3; i++)
+    {
+      t += SEC;
+      m.update(cur, t);
+      print(m, cur, total);
+    }
+
+  cout << "Goes backwards (new job):\n";
+  m.update(0, t + SEC);
+  print(m, 0, total);
+
+  cout << "Formatting:\n";
+  cout << "  " << RateMeter::etaString(-1) << "|" << RateMeter::etaString(0)
+       << "|" << RateMeter::etaString(75) << "|"
+       << RateMeter::etaString(3600*2+61) << endl;
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include "freespace.hpp"
+
+#include <iostream>
+using namespace std;
+using namespace Misc;
+
+int main()
+{
+  cout << "allocSize(0) = " << allocSize(0, 4096) << endl;
+  cout << "allocSize(1) = " << allocSize(1, 4096) << endl;
+  cout << "allocSize(4096) = " << allocSize(4096, 4096) << endl;
+  cout << "allocSize(4097) = " << allocSize(4097, 4096) << endl;
+
+  int64_t block = getBlockSize(".");
+  cout << "Block size is a power of two: "
+       << (block > 0 && (block & (block-1)) == 0) << endl;
+
+  // Non-existing paths use their nearest existing parent
+  cout << "Same block size for new dir: "
+       << (getBlockSize("./does/not/exist") == block) << endl;
+
+  int64_t avail = getAvailable(".");
+  int64_t half = avail/2 + avail/4;
+
+  {
+    SpaceReservation r1, r2;
+    cout << "\nReserving 3/4 of the free space: " << r1.reserve(".", half) << endl;
+    cout << "Reserving it again: " << r2.reserve(".", half) << endl;
+    cout << "Too much: " << r2.reserve("./does/not/exist", avail) << endl;
+    cout << "Active: " << r1.isActive() << " " << r2.isActive() << endl;
+
+    // Pretend the first job wrote everything. The OS would now count
+    // the space as used, but in this test it's still free.
+    r1.setProgress(100, 100);
+    cout << "After first job is done: " << r2.reserve(".", half) << endl;
+    r2.release();
+    cout << "Released: " << r2.isActive() << endl;
+  }
+
+  cout << "All released: " << (getAvailable(".") > half) << endl;
+
+  return 0;
+}
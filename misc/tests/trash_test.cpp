@@ -0,0 +1,49 @@
+#include "trash.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+void makeTree(const string &dir, int files)
+{
+  for(int i=0; i<files; i++)
+    {
+      stringstream name;
+      name << dir << "/sub" << (i%5) << "/deeper" << (i%3) << "/file" << i;
+      bf::create_directories(bf::path(name.str()).parent_path());
+      ofstream out(name.str().c_str());
+      out << "data " << i;
+    }
+}
+
+int main()
+{
+  bf::remove_all("_trash");
+  bf::remove_all("_game1");
+  bf::remove_all("_game2");
+
+  makeTree("_game1", 500);
+  makeTree("_game2", 10);
+
+  cout << "Trash has items: " << Trash::hasItems("_trash") << endl;
+  cout << "Move game1: " << Trash::moveTo("_trash", "_game1") << endl;
+  cout << "game1 exists: " << bf::exists("_game1") << endl;
+  cout << "Trash has items: " << Trash::hasItems("_trash") << endl;
+  cout << "Move missing: " << Trash::moveTo("_trash", "_nothing") << endl;
+
+  Trash::empty("_trash");
+  cout << "After emptying: " << Trash::hasItems("_trash") << endl;
+
+  Trash::removeTree("_game2");
+  cout << "game2 exists: " << bf::exists("_game2") << endl;
+
+  // Removing something that isn't there is not an error
+  Trash::removeTree("_game2");
+
+  bf::remove_all("_trash");
+  return 0;
+}
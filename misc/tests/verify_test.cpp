@@ -0,0 +1,83 @@
+#include "verify.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <boost/filesystem.hpp>
+using namespace std;
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+void write(const string &file, const string &data)
+{
+  bf::create_directories(bf::path(file).parent_path());
+  ofstream out(file.c_str(), ios::binary);
+  out << data;
+}
+
+void print(const Verify::Report &rep)
+{
+  cout << "  files=" << rep.files << " bytes=" << rep.bytes
+       << " ok=" << rep.isOk() << endl;
+  for(int i=0; i<rep.changed.size(); i++)
+    cout << "  Changed: " << rep.changed[i] << endl;
+  for(int i=0; i<rep.missing.size(); i++)
+    cout << "  Missing: " << rep.missing[i] << endl;
+}
+
+bool abortAt(int64_t cur, int64_t tot)
+{
+  return cur < 10;
+}
+
+int main()
+{
+  bf::remove_all("_verify");
+  write("_verify/game/data.bin", string(100000, 'x'));
+  write("_verify/game/sub/a.txt", "hello");
+  write("_verify/game/sub/b.txt", "world");
+  write("_verify/game/sub/deeper/c.txt", "more data");
+
+  Verify::Manifest man, man2;
+  Verify::build("_verify/game", man);
+  cout << "Manifest has " << man.size() << " files\n";
+
+  Verify::save("_verify/man/game.conf", man);
+  cout << "Loaded: " << Verify::load("_verify/man/game.conf", man2) << endl;
+  cout << "Same after reload: " << (man.size() == man2.size()) << endl;
+  Verify::Manifest::iterator it;
+  for(it = man2.begin(); it != man2.end(); it++)
+    cout << "  " << it->first << " " << it->second.size << " "
+         << (it->second.hash == man[it->first].hash) << endl;
+  cout << "Load missing: " << Verify::load("_verify/nothing.conf", man2) << endl;
+
+  cout << "\nUnchanged:\n";
+  {
+    Verify::Report rep;
+    Verify::check("_verify/game", man, rep);
+    print(rep);
+  }
+
+  // Same size, different content
+  write("_verify/game/sub/a.txt", "jello");
+  // Different size
+  write("_verify/game/sub/deeper/c.txt", "less");
+  bf::remove("_verify/game/sub/b.txt");
+  // New files are ignored
+  write("_verify/game/save.dat", "saved game");
+
+  cout << "\nDamaged:\n";
+  {
+    Verify::Report rep;
+    Verify::check("_verify/game", man, rep);
+    print(rep);
+  }
+
+  cout << "\nAborted: ";
+  {
+    Verify::Report rep;
+    cout << !Verify::check("_verify/game", man, rep, abortAt) << endl;
+  }
+
+  bf::remove_all("_verify");
+  return 0;
+}
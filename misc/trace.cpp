@@ -0,0 +1,150 @@
+#include "trace.hpp"
+
+#ifdef TIGGIT_TRACE
+
+#include <vector>
+#include <map>
+#include <fstream>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace Misc;
+
+// Stop recording after this many events, to keep memory usage sane if
+// tracing is left on for a long time.
+#define MAX_EVENTS 1000000
+
+namespace
+{
+  struct Event
+  {
+    const char *name;
+    char type; // 'X' for spans, 'C' for counters
+    int tid;
+    int64_t ts;
+
+    // Duration for spans, value for counters
+    int64_t val;
+    std::string detail;
+  };
+
+  boost::mutex mutex;
+  bool active = false;
+  std::string outFile;
+  std::vector<Event> events;
+
+  // Map thread ids to small numbers, for readability
+  std::map<boost::thread::id, int> threads;
+
+  const boost::posix_time::ptime epoch =
+    boost::posix_time::microsec_clock::universal_time();
+
+  // Must be called with the mutex held
+  int getTid()
+  {
+    boost::thread::id id = boost::this_thread::get_id();
+    std::map<boost::thread::id, int>::iterator it = threads.find(id);
+    if(it != threads.end())
+      return it->second;
+    int num = threads.size() + 1;
+    threads[id] = num;
+    return num;
+  }
+
+  void add(const char *name, char type, int64_t ts, int64_t val,
+           const std::string &detail)
+  {
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if(!active || events.size() >= MAX_EVENTS) return;
+
+    events.resize(events.size()+1);
+    Event &e = events.back();
+    e.name = name;
+    e.type = type;
+    e.tid = getTid();
+    e.ts = ts;
+    e.val = val;
+    e.detail = detail;
+  }
+
+  // Minimal JSON string escaping
+  void writeStr(std::ostream &out, const std::string &str)
+  {
+    out << '"';
+    for(int i=0; i<str.size(); i++)
+      {
+        char c = str[i];
+        if(c == '"' || c == '\\') out << '\\' << c;
+        else if(c == '\n') out << "\\n";
+        else if((unsigned char)c < 32) out << ' ';
+        else out << c;
+      }
+    out << '"';
+  }
+}
+
+int64_t Trace::now()
+{
+  using namespace boost::posix_time;
+  return (microsec_clock::universal_time() - epoch).total_microseconds();
+}
+
+void Trace::start(const std::string &file)
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  outFile = file;
+  events.clear();
+  events.reserve(10000);
+  active = true;
+}
+
+void Trace::span(const char *name, int64_t start, int64_t dur,
+                 const std::string &detail)
+{ add(name, 'X', start, dur, detail); }
+
+void Trace::counter(const char *name, int64_t value)
+{
+  add(name, 'C', now(), value, "");
+}
+
+void Trace::stop()
+{
+  boost::lock_guard<boost::mutex> lock(mutex);
+  if(!active) return;
+  active = false;
+
+  std::ofstream out(outFile.c_str());
+  if(!out) return;
+
+  out << "{\"traceEvents\":[\n";
+  for(int i=0; i<events.size(); i++)
+    {
+      const Event &e = events[i];
+      if(i) out << ",\n";
+
+      out << "{\"name\":";
+      writeStr(out, e.name);
+      out << ",\"ph\":\"" << e.type << "\",\"pid\":1,\"tid\":" << e.tid
+          << ",\"ts\":" << e.ts;
+
+      if(e.type == 'X')
+        {
+          out << ",\"dur\":" << e.val;
+          if(e.detail != "")
+            {
+              out << ",\"args\":{\"detail\":";
+              writeStr(out, e.detail);
+              out << "}";
+            }
+        }
+      else
+        out << ",\"args\":{\"value\":" << e.val << "}";
+
+      out << "}";
+    }
+  out << "\n]}\n";
+
+  events.clear();
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef __MISC_TRACE_HPP_
+#define __MISC_TRACE_HPP_
+
+/* Lightweight span tracing, used to record a timeline of what the
+   program is doing (loading data, running jobs, handling UI events
+   etc.)
+
+   Tracing is only compiled in if TIGGIT_TRACE is defined (see the
+   TRACE option in CMakeLists.txt). Otherwise all the macros below
+   expand to nothing, and their parameters are never evaluated.
+
+   Usage:
+
+     TRACE_START("trace.json");      // start recording
+
+     void someFunction()
+     {
+       TRACE_SCOPE("someFunction");  // records a span until end of scope
+       TRACE_SCOPE2("install", idname);   // same, with a detail string
+       TRACE_COUNTER("queued", num);       // record a counter value
+     }
+
+     TRACE_STOP();                   // write the file
+
+   The output is in the Chrome trace event format, and can be viewed
+   in chrome://tracing or https://ui.perfetto.dev/ .
+ */
+
+#ifdef TIGGIT_TRACE
+
+#include <string>
+#include <stdint.h>
+
+namespace Misc
+{
+  namespace Trace
+  {
+    // Start recording events. Nothing is recorded until this is
+    // called.
+    void start(const std::string &file);
+
+    // Stop recording, and write all recorded events to the file given
+    // to start().
+    void stop();
+
+    // Microseconds since an arbitrary starting point
+    int64_t now();
+
+    // Record a finished span or a counter value. Usually called
+    // through the macros.
+    void span(const char *name, int64_t start, int64_t dur,
+              const std::string &detail = "");
+    void counter(const char *name, int64_t value);
+
+    struct Scope
+    {
+      const char *name;
+      std::string detail;
+      int64_t start;
+
+      Scope(const char *_name, const std::string &_detail = "")
+        : name(_name), detail(_detail), start(now()) {}
+      ~Scope() { span(name, start, now()-start, detail); }
+    };
+  }
+}
+
+#define TRACE_CAT2(a,b) a##b
+#define TRACE_CAT(a,b) TRACE_CAT2(a,b)
+
+#define TRACE_START(file) Misc::Trace::start(file)
+#define TRACE_STOP() Misc::Trace::stop()
+#define TRACE_SCOPE(name) Misc::Trace::Scope TRACE_CAT(_trace,__LINE__)(name)
+#define TRACE_SCOPE2(name,detail) Misc::Trace::Scope TRACE_CAT(_trace,__LINE__)(name,detail)
+#define TRACE_COUNTER(name,value) Misc::Trace::counter(name,value)
+
+#else
+
+#define TRACE_START(file)
+#define TRACE_STOP()
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE2(name,detail)
+#define TRACE_COUNTER(name,value)
+
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+#include "trash.hpp"
+#include "priority.hpp"
+
+#include <set>
+#include <vector>
+#include <sstream>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+using namespace Misc;
+namespace bf = boost::filesystem;
+
+#define DELETE_THREADS 4
+
+// Throttling: pause for PAUSE_MS after every PAUSE_EVERY deleted files,
+// in each thread.
+#define PAUSE_EVERY 200
+#define PAUSE_MS 10
+
+namespace
+{
+  struct Deleter
+  {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::vector<bf::path> queue;
+    int pending;
+
+    void run()
+    {
+      lowerThreadPriority();
+
+      int count = 0;
+      std::vector<bf::path> dirs;
+      while(true)
+        {
+          bf::path dir;
+          {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while(queue.empty() && pending > 0)
+              cond.wait(lock);
+            if(queue.empty()) break;
+
+            dir = queue.back();
+            queue.pop_back();
+          }
+
+          // Delete all files, and queue up the subdirectories. The
+          // (by then empty) directories themselves are removed
+          // afterwards.
+          dirs.clear();
+          try
+            {
+              bf::directory_iterator iter(dir), end;
+              for(; iter != end; ++iter)
+                {
+                  if(bf::is_directory(iter->symlink_status()))
+                    dirs.push_back(iter->path());
+                  else
+                    {
+                      boost::system::error_code ec;
+                      bf::remove(iter->path(), ec);
+
+                      if(++count % PAUSE_EVERY == 0)
+                        boost::this_thread::sleep(boost::posix_time::milliseconds(PAUSE_MS));
+                    }
+                }
+            }
+          catch(...) {}
+
+          {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            queue.insert(queue.end(), dirs.begin(), dirs.end());
+            pending += dirs.size();
+            pending--;
+          }
+          cond.notify_all();
+        }
+    }
+  };
+
+  boost::mutex emptyMutex;
+  std::set<std::string> busy, again;
+}
+
+void Trash::removeTree(const std::string &path)
+{
+  bf::path p = path;
+  if(!bf::exists(bf::symlink_status(p)))
+    return;
+
+  if(bf::is_directory(bf::symlink_status(p)))
+    {
+      Deleter del;
+      del.queue.push_back(p);
+      del.pending = 1;
+
+      boost::thread_group group;
+      for(int i=0; i<DELETE_THREADS; i++)
+        group.create_thread(boost::bind(&Deleter::run, &del));
+      group.join_all();
+    }
+
+  // Remove what's left, which should only be empty directories. Also
+  // reports any errors from files we couldn't delete above.
+  bf::remove_all(p);
+}
+
+bool Trash::moveTo(const std::string &trashDir, const std::string &path,
+                   std::string *destStr)
+{
+  static int counter = 0;
+
+  try
+    {
+      bf::create_directories(trashDir);
+
+      // Find a unique name for it
+      bf::path dest;
+      do
+        {
+          std::stringstream name;
+          name << std::time(NULL) << "-" << counter++ << "-"
+               << bf::path(path).filename().string();
+          dest = bf::path(trashDir) / name.str();
+        }
+      while(bf::exists(dest));
+
+      bf::rename(path, dest);
+      if(destStr) *destStr = dest.string();
+    }
+  catch(...) { return false; }
+
+  return true;
+}
+
+bool Trash::hasItems(const std::string &trashDir)
+{
+  try
+    {
+      if(!bf::is_directory(trashDir)) return false;
+      return bf::directory_iterator(trashDir) != bf::directory_iterator();
+    }
+  catch(...) {}
+  return false;
+}
+
+void Trash::empty(const std::string &trashDir)
+{
+  {
+    boost::lock_guard<boost::mutex> lock(emptyMutex);
+    if(busy.count(trashDir))
+      {
+        // Make the running thread look again when it's done
+        again.insert(trashDir);
+        return;
+      }
+    busy.insert(trashDir);
+  }
+
+  while(true)
+    {
+      std::vector<bf::path> items;
+      try
+        {
+          if(bf::is_directory(trashDir))
+            {
+              bf::directory_iterator iter(trashDir), end;
+              for(; iter != end; ++iter)
+                items.push_back(iter->path());
+            }
+        }
+      catch(...) {}
+
+      for(int i=0; i<items.size(); i++)
+        {
+          try { removeTree(items[i].string()); }
+          catch(...) {}
+        }
+
+      boost::lock_guard<boost::mutex> lock(emptyMutex);
+      if(again.erase(trashDir)) continue;
+      busy.erase(trashDir);
+      break;
+    }
+}
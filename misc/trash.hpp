@@ -0,0 +1,48 @@
+#ifndef __MISC_TRASH_HPP_
+#define __MISC_TRASH_HPP_
+
+#include <string>
+
+/* Fast removal of large directory trees.
+
+   Deleting a big game one file at a time can take minutes. Instead,
+   we rename it into a trash directory, which is instant and makes it
+   disappear from the user's point of view, and then delete the
+   contents in the background.
+
+   Background deletion uses several threads, runs at low CPU and IO
+   priority where the OS supports it, and is throttled so it doesn't
+   saturate the disk. Anything left in the trash (eg. after a crash)
+   is picked up the next time the trash is emptied.
+ */
+
+namespace Misc
+{
+  namespace Trash
+  {
+    /* Move 'path' into the trash directory 'trashDir'. Returns false
+       if that is not possible, usually because the two are on
+       different filesystems. 'path' is left untouched in that case.
+
+       The new location is stored in 'dest', if given.
+     */
+    bool moveTo(const std::string &trashDir, const std::string &path,
+                std::string *dest = NULL);
+
+    /* Delete everything in 'trashDir'. If another thread is already
+       emptying the same trash, this returns immediately and leaves
+       the work to that thread. Errors are ignored.
+     */
+    void empty(const std::string &trashDir);
+
+    // Returns true if there is anything in the trash
+    bool hasItems(const std::string &trashDir);
+
+    /* Delete a directory tree (or single file) using several threads,
+       at low priority. Throws on error.
+     */
+    void removeTree(const std::string &path);
+  }
+}
+
+#endif
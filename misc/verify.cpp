@@ -0,0 +1,234 @@
+#include "verify.hpp"
+#include "filecopy.hpp"
+#include "hashcache.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+using namespace Misc;
+using namespace Misc::Verify;
+namespace bf = boost::filesystem;
+
+// Hashing is mostly limited by the disk, so more threads than this
+// won't help.
+#define MAX_THREADS 8
+
+namespace
+{
+  struct Job
+  {
+    std::string file;
+    int64_t size;
+    uint64_t hash;
+    bool ok;
+  };
+
+  struct Hasher
+  {
+    boost::mutex mutex;
+    std::vector<Job> *jobs;
+    ProgressFunc progress;
+    bool reuse;
+
+    int next;
+    int64_t bytes, total;
+    bool abort;
+
+    void run()
+    {
+      while(true)
+        {
+          int index;
+          {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            if(abort || next >= jobs->size())
+              break;
+
+            if(progress && !progress(bytes, total))
+              {
+                abort = true;
+                break;
+              }
+
+            index = next++;
+          }
+
+          Job &j = (*jobs)[index];
+          try
+            {
+              j.hash = HashCache::hashFile(j.file, reuse);
+              j.ok = true;
+            }
+          catch(...) { j.ok = false; }
+
+          boost::lock_guard<boost::mutex> lock(mutex);
+          bytes += j.size;
+        }
+    }
+  };
+}
+
+// Hash all the jobs in parallel. Returns false if aborted.
+static bool hashAll(std::vector<Job> &jobs, ProgressFunc progress,
+                    int threads, bool reuse)
+{
+  Hasher hs;
+  hs.jobs = &jobs;
+  hs.progress = progress;
+  hs.reuse = reuse;
+  hs.next = 0;
+  hs.bytes = hs.total = 0;
+  hs.abort = false;
+  for(int i=0; i<jobs.size(); i++)
+    hs.total += jobs[i].size;
+
+  if(threads <= 0)
+    {
+      threads = boost::thread::hardware_concurrency();
+      if(threads < 2) threads = 2;
+      if(threads > MAX_THREADS) threads = MAX_THREADS;
+    }
+  if(threads > jobs.size()) threads = jobs.size();
+  if(threads < 1) threads = 1;
+
+  boost::thread_group group;
+  for(int i=0; i<threads; i++)
+    group.create_thread(boost::bind(&Hasher::run, &hs));
+  group.join_all();
+
+  if(!hs.abort && progress)
+    progress(hs.bytes, hs.total);
+
+  return !hs.abort;
+}
+
+bool Verify::build(const std::string &dir, Manifest &out,
+                   ProgressFunc progress, int threads)
+{
+  std::vector<FileCopy::FileInfo> files;
+  FileCopy::index(dir, files);
+
+  std::vector<Job> jobs(files.size());
+  for(int i=0; i<files.size(); i++)
+    {
+      jobs[i].file = (bf::path(dir)/files[i].name).string();
+      jobs[i].size = files[i].size;
+    }
+
+  if(!hashAll(jobs, progress, threads, true))
+    return false;
+
+  out.clear();
+  for(int i=0; i<jobs.size(); i++)
+    {
+      if(!jobs[i].ok)
+        throw std::runtime_error("Cannot read " + jobs[i].file);
+
+      FileSum &s = out[files[i].name];
+      s.size = jobs[i].size;
+      s.hash = jobs[i].hash;
+    }
+  return true;
+}
+
+bool Verify::check(const std::string &dir, const Manifest &man, Report &rep,
+                   ProgressFunc progress, int threads, bool quick)
+{
+  int64_t start = Metrics::now();
+
+  // Files with the wrong size don't need hashing
+  std::vector<Job> jobs;
+  std::vector<std::string> names;
+  Manifest::const_iterator it;
+  for(it = man.begin(); it != man.end(); it++)
+    {
+      bf::path file = bf::path(dir)/it->first;
+      boost::system::error_code ec;
+      int64_t size = bf::file_size(file, ec);
+
+      if(ec)
+        rep.missing.push_back(it->first);
+      else if(size != it->second.size)
+        rep.changed.push_back(it->first);
+      else
+        {
+          Job j;
+          j.file = file.string();
+          j.size = size;
+          jobs.push_back(j);
+          names.push_back(it->first);
+        }
+    }
+
+  if(!hashAll(jobs, progress, threads, quick))
+    return false;
+
+  for(int i=0; i<jobs.size(); i++)
+    {
+      rep.files++;
+      rep.bytes += jobs[i].size;
+
+      // Unreadable files count as changed
+      if(!jobs[i].ok || jobs[i].hash != man.find(names[i])->second.hash)
+        rep.changed.push_back(names[i]);
+    }
+  std::sort(rep.changed.begin(), rep.changed.end());
+
+  rep.time = Metrics::now() - start;
+  Metrics::throughput("verify.bytes_per_sec", rep.bytes, rep.time);
+  Metrics::count("verify.bytes", rep.bytes);
+  return true;
+}
+
+void Verify::save(const std::string &file, const Manifest &man)
+{
+  bf::path p = file;
+  if(p.has_parent_path())
+    bf::create_directories(p.parent_path());
+
+  // Write to a temporary file first, so a crash never leaves a
+  // half-written manifest behind.
+  std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp.c_str());
+    if(!out) throw std::runtime_error("Cannot write " + tmp);
+
+    Manifest::const_iterator it;
+    for(it = man.begin(); it != man.end(); it++)
+      out << std::hex << it->second.hash << std::dec << " "
+          << it->second.size << " " << it->first << "\n";
+
+    if(!out) throw std::runtime_error("Error writing " + tmp);
+  }
+  bf::rename(tmp, file);
+}
+
+bool Verify::load(const std::string &file, Manifest &man)
+{
+  man.clear();
+  if(!bf::exists(file)) return false;
+
+  std::ifstream inp(file.c_str());
+  if(!inp) throw std::runtime_error("Cannot read " + file);
+
+  std::string line;
+  while(std::getline(inp, line))
+    {
+      std::istringstream str(line);
+      FileSum s;
+      str >> std::hex >> s.hash >> std::dec >> s.size;
+      str.get();
+
+      std::string name;
+      std::getline(str, name);
+      if(!str.fail() && name != "")
+        man[name] = s;
+    }
+  return true;
+}
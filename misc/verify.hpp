@@ -0,0 +1,96 @@
+#ifndef __MISC_VERIFY_HPP_
+#define __MISC_VERIFY_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/function.hpp>
+
+/* Integrity checking of installed directories.
+
+   A manifest lists the size and content hash (see filehash.hpp) of
+   every file in a directory. It is recorded when a game is installed,
+   and later compared against what is actually on disk.
+
+   Files are hashed by several threads at once, since a single thread
+   can't keep a fast disk busy, and large libraries would otherwise
+   take hours to check. Hashes are shared with the rest of the program
+   through hashcache.hpp.
+ */
+
+namespace Misc
+{
+  namespace Verify
+  {
+    struct FileSum
+    {
+      int64_t size;
+      uint64_t hash;
+    };
+
+    // Maps file names, relative to the directory, to their sums
+    typedef std::map<std::string, FileSum> Manifest;
+
+    struct Report
+    {
+      // Files and bytes hashed
+      int64_t files, bytes;
+
+      // Time spent, in microseconds
+      int64_t time;
+
+      // Files that differ from the manifest, and files that are gone
+      std::vector<std::string> changed, missing;
+
+      // Not set by check(). Used by callers that repair damaged files.
+      int64_t repaired;
+
+      /* Not set by check(). True if there was nothing to check
+         against, and the current files were recorded as the
+         reference instead. Nothing was verified in that case.
+       */
+      bool baseline;
+
+      Report() : files(0), bytes(0), time(0), repaired(0), baseline(false) {}
+
+      // True if the files were checked and found undamaged
+      bool isOk() const
+      { return !baseline && changed.empty() && missing.empty(); }
+
+      // Hashing throughput in bytes per second
+      int64_t speed() const
+      { return time > 0 ? (int64_t)(bytes * 1000000.0 / time) : 0; }
+    };
+
+    // Called with (bytes done, bytes total). Return false to abort.
+    typedef boost::function<bool(int64_t,int64_t)> ProgressFunc;
+
+    /* Hash all files in 'dir' into 'out'. Files that haven't changed
+       since they were last hashed are not read again. Returns false if
+       aborted. Throws on error.
+     */
+    bool build(const std::string &dir, Manifest &out,
+               ProgressFunc progress = ProgressFunc(), int threads=0);
+
+    /* Compare the contents of 'dir' against a manifest. Files that are
+       not in the manifest (such as saved games and settings) are
+       ignored. Returns false if aborted.
+
+       Normally every file is read. If 'quick' is set, files that look
+       unchanged since they were last hashed are skipped. This still
+       finds files that were modified or replaced, but not silent disk
+       corruption.
+     */
+    bool check(const std::string &dir, const Manifest &man, Report &report,
+               ProgressFunc progress = ProgressFunc(), int threads=0,
+               bool quick=false);
+
+    // Write and read manifest files. load() returns false if the file
+    // doesn't exist, and throws on other errors.
+    void save(const std::string &file, const Manifest &man);
+    bool load(const std::string &file, Manifest &man);
+  }
+}
+
+#endif
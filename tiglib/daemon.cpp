@@ -0,0 +1,521 @@
+#include "daemon.hpp"
+#include "repo.hpp"
+#include "liveinfo.hpp"
+#include "misc/metrics.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <map>
+#include <set>
+#include <list>
+#include <ctime>
+
+using namespace TigLib;
+namespace ba = boost::asio;
+namespace bf = boost::filesystem;
+using ba::ip::tcp;
+
+typedef boost::lock_guard<boost::mutex> Lock;
+typedef boost::shared_ptr<tcp::socket> SocketPtr;
+
+// How often watchers are sent progress, in milliseconds
+#define WATCH_INTERVAL 500
+
+// How long to wait for aborted jobs to stop on exit, in seconds
+#define EXIT_WAIT 3
+
+namespace
+{
+  // A job started through the daemon
+  struct Job
+  {
+    Spread::JobInfoPtr info;
+    bool install;
+
+    Job() : install(false) {}
+    Job(Spread::JobInfoPtr i, bool inst) : info(i), install(inst) {}
+  };
+
+  typedef std::map<std::string, Job> JobMap;
+
+  // A connected client, and the thread serving it
+  struct Client
+  {
+    SocketPtr sock;
+    boost::shared_ptr<boost::thread> thread;
+  };
+
+  typedef std::list<Client> ClientList;
+
+  bool readLine(tcp::socket &sock, ba::streambuf &buf, std::string &line)
+  {
+    boost::system::error_code ec;
+    ba::read_until(sock, buf, '\n', ec);
+    if(ec) return false;
+
+    std::istream is(&buf);
+    std::getline(is, line);
+    if(!line.empty() && line[line.size()-1] == '\r')
+      line.erase(line.size()-1);
+    return true;
+  }
+
+  bool writeStr(tcp::socket &sock, const std::string &str)
+  {
+    boost::system::error_code ec;
+    ba::write(sock, ba::buffer(str), ec);
+    return !ec;
+  }
+}
+
+struct Daemon::_Internal
+{
+  Repo &repo;
+  ba::io_service io;
+  tcp::acceptor acceptor;
+  boost::thread acceptThread;
+  std::string portFile, token;
+  int port;
+
+  /* Clients being served. Only used by acceptLoop(), and by run()
+     once the accept thread has exited, so it needs no locking.
+   */
+  ClientList clients;
+
+  // Protects everything below, and all use of the Repo and its
+  // LiveInfo structs.
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  JobMap jobs;
+  bool done;
+
+  _Internal(Repo &r) : repo(r), acceptor(io), port(0), done(false) {}
+
+  bool isDone()
+  {
+    Lock lock(mutex);
+    return done;
+  }
+
+  void setDone()
+  {
+    Lock lock(mutex);
+    done = true;
+    cond.notify_all();
+  }
+
+  // Find a game by idname or urlname. Call with the mutex held.
+  LiveInfo *find(const std::string &name)
+  {
+    const InfoLookup &list = repo.getList();
+    InfoLookup::const_iterator it = list.find(name);
+    if(it != list.end()) return it->second;
+
+    for(it = list.begin(); it != list.end(); it++)
+      if(it->second->ent->urlname == name)
+        return it->second;
+    return NULL;
+  }
+
+  // The job to report for a game. Call with the mutex held.
+  Spread::JobInfoPtr getJob(const LiveInfo *inf)
+  {
+    JobMap::const_iterator it = jobs.find(inf->ent->idname);
+    if(it != jobs.end() && it->second.info)
+      return it->second.info;
+    return inf->getStatus();
+  }
+
+  // Call with the mutex held
+  bool isWorking(const LiveInfo *inf)
+  {
+    Spread::JobInfoPtr job = getJob(inf);
+    return job && job->isCreated() && !job->isFinished();
+  }
+
+  // Make a status line. Call with the mutex held.
+  std::string status(const LiveInfo *inf)
+  {
+    Spread::JobInfoPtr job = getJob(inf);
+    std::string state = "none", msg;
+    int64_t cur = 0, total = 0;
+
+    if(job && job->isCreated() && !job->isFinished())
+      {
+        state = "working";
+        cur = job->getCurrent();
+        total = job->getTotal();
+        msg = job->getMessage();
+      }
+    else if(job && job->isCreated() && job->isNonSuccess())
+      {
+        state = "failed";
+        msg = job->isAbort() ? "Aborted" : job->getMessage();
+      }
+    else if(inf->isInstalled())
+      state = "installed";
+
+    // Messages must stay on one line
+    for(int i=0; i<msg.size(); i++)
+      if(msg[i] == '\n' || msg[i] == '\r') msg[i] = ' ';
+
+    std::ostringstream out;
+    out << inf->ent->idname << " " << state << " " << cur << " "
+        << total << " " << msg << "\n";
+    return out.str();
+  }
+
+  // Abort all running jobs. Returns the games that were being
+  // installed. Call with the mutex held.
+  std::vector<std::string> abortAll()
+  {
+    std::vector<std::string> res;
+    for(JobMap::iterator it = jobs.begin(); it != jobs.end(); it++)
+      {
+        Spread::JobInfoPtr info = it->second.info;
+        if(!info || info->isFinished()) continue;
+        info->abort();
+        if(it->second.install)
+          res.push_back(it->first);
+      }
+    return res;
+  }
+
+  // Start a job. Returns an error message, or "" on success. Call
+  // with the mutex held.
+  std::string startJob(const std::string &cmd, LiveInfo *inf)
+  {
+    const std::string &id = inf->ent->idname;
+
+    if(cmd == "abort")
+      {
+        Spread::JobInfoPtr job = getJob(inf);
+        if(job && job->isCreated() && !job->isFinished())
+          job->abort();
+        return "";
+      }
+
+    if(isWorking(inf))
+      return id + " is busy";
+
+    if(cmd == "install")
+      {
+        if(!inf->isUninstalled()) return id + " is already installed";
+        jobs[id] = Job(inf->install(true), true);
+      }
+    else if(cmd == "update")
+      {
+        if(!inf->isInstalled()) return id + " is not installed";
+        jobs[id] = Job(inf->update(true), false);
+      }
+    else if(cmd == "uninstall")
+      {
+        if(!inf->isInstalled()) return id + " is not installed";
+        jobs[id] = Job(inf->uninstall(true), false);
+      }
+    return "";
+  }
+
+  void watch(tcp::socket &sock)
+  {
+    std::set<std::string> working;
+    while(!isDone())
+      {
+        std::string out;
+        {
+          Lock lock(mutex);
+          std::set<std::string> now;
+          const InfoLookup &list = repo.getList();
+          for(JobMap::iterator it = jobs.begin(); it != jobs.end(); it++)
+            {
+              InfoLookup::const_iterator li = list.find(it->first);
+              if(li == list.end()) continue;
+              const LiveInfo *inf = li->second;
+
+              // Send progress for running jobs, and a last line when
+              // a job ends
+              bool busy = isWorking(inf);
+              if(busy) now.insert(it->first);
+              if(busy || working.count(it->first))
+                out += status(inf);
+            }
+          working.swap(now);
+        }
+
+        if(out != "" && !writeStr(sock, out))
+          return;
+
+        boost::this_thread::sleep(boost::posix_time::milliseconds(WATCH_INTERVAL));
+      }
+  }
+
+  // Handle one request. Returns false if the connection should be
+  // closed.
+  bool handle(tcp::socket &sock, const std::string &line)
+  {
+    std::istringstream in(line);
+    std::string cmd, arg;
+    in >> cmd >> arg;
+
+    std::string out, error;
+
+    if(cmd == "ping")
+      out = "tiggit-daemon 1\n";
+
+    else if(cmd == "watch")
+      {
+        watch(sock);
+        return false;
+      }
+
+    else if(cmd == "handoff" || cmd == "shutdown")
+      {
+        {
+          Lock lock(mutex);
+          std::vector<std::string> games = abortAll();
+          if(cmd == "handoff")
+            for(int i=0; i<games.size(); i++)
+              out += games[i] + "\n";
+        }
+        writeStr(sock, out + "ok\n");
+        setDone();
+        return false;
+      }
+
+    else if(cmd == "list")
+      {
+        if(arg != "" && arg != "installed" && arg != "working")
+          error = "Unknown list: " + arg;
+        else
+          {
+            Lock lock(mutex);
+            const InfoLookup &list = repo.getList();
+            for(InfoLookup::const_iterator it = list.begin();
+                it != list.end(); it++)
+              {
+                const LiveInfo *inf = it->second;
+                if(arg == "installed" && !inf->isInstalled()) continue;
+                if(arg == "working" && !isWorking(inf)) continue;
+                out += status(inf);
+              }
+          }
+      }
+
+    else if(cmd == "outdated")
+      {
+        /* Not under 'mutex'. This asks Spread about every installed
+           game, which would stall all other clients meanwhile. It
+           only reads the game list and the installed/version
+           registries, which are thread safe on their own, and
+           checkUpdates() takes the SpreadLock itself.
+         */
+        std::vector<UpdateInfo> list = repo.checkUpdates();
+        for(int i=0; i<list.size(); i++)
+          out += list[i].idname + " outdated 0 0 " + list[i].installed +
+            " -> " + list[i].available + "\n";
+      }
+
+    else if(cmd == "status" || cmd == "install" || cmd == "update" ||
+            cmd == "uninstall" || cmd == "abort")
+      {
+        Lock lock(mutex);
+        LiveInfo *inf = find(arg);
+        if(!inf)
+          error = "Unknown game: " + arg;
+        else
+          {
+            if(cmd != "status")
+              error = startJob(cmd, inf);
+            if(error == "")
+              out = status(inf);
+          }
+      }
+
+    else
+      error = "Unknown command: " + cmd;
+
+    if(error != "")
+      out += "error " + error + "\n";
+    else
+      out += "ok\n";
+
+    return writeStr(sock, out);
+  }
+
+  void serve(SocketPtr sock)
+  {
+    ba::streambuf buf;
+    std::string line;
+
+    // Clients must prove they can read the repository
+    if(!readLine(*sock, buf, line) || line != token)
+      {
+        writeStr(*sock, "error Access denied\n");
+        return;
+      }
+
+    while(!isDone() && readLine(*sock, buf, line))
+      if(line != "" && !handle(*sock, line))
+        break;
+
+    /* Let the client know we're done. The socket is closed by whoever
+       joins this thread, since run() may be shutting it down from
+       another thread at the same time.
+     */
+    boost::system::error_code ec;
+    sock->shutdown(tcp::socket::shutdown_both, ec);
+  }
+
+  // Join and forget clients whose threads have exited
+  void reapClients(bool wait)
+  {
+    ClientList::iterator it = clients.begin();
+    while(it != clients.end())
+      {
+        if(wait) it->thread->join();
+        else if(!it->thread->timed_join(boost::posix_time::seconds(0)))
+          {
+            it++;
+            continue;
+          }
+
+        boost::system::error_code ec;
+        it->sock->close(ec);
+        it = clients.erase(it);
+      }
+  }
+
+  void acceptLoop()
+  {
+    while(true)
+      {
+        SocketPtr sock(new tcp::socket(io));
+        boost::system::error_code ec;
+        acceptor.accept(*sock, ec);
+        if(isDone()) break;
+        reapClients(false);
+        if(ec) continue;
+
+        // Each client gets its own thread. Clients are few, and most
+        // requests are quick.
+        Client c;
+        c.sock = sock;
+        c.thread.reset(new boost::thread(boost::bind(&_Internal::serve, this, sock)));
+        clients.push_back(c);
+      }
+  }
+};
+
+Daemon::Daemon(Repo &repo) : ptr(new _Internal(repo)) {}
+
+void Daemon::start()
+{
+  // Only accept local connections, on any free port
+  tcp::endpoint ep(ba::ip::address_v4::loopback(), 0);
+  ptr->acceptor.open(ep.protocol());
+  ptr->acceptor.bind(ep);
+  ptr->acceptor.listen();
+  ptr->port = ptr->acceptor.local_endpoint().port();
+
+  ptr->token = boost::lexical_cast<std::string>(boost::uuids::random_generator()());
+
+  // Tell clients where to find us
+  ptr->portFile = ptr->repo.getPath("daemon.port");
+  {
+    std::ofstream out(ptr->portFile.c_str());
+    out << ptr->port << " " << ptr->token << "\n";
+    if(!out)
+      throw std::runtime_error("Failed to write " + ptr->portFile);
+  }
+
+  ptr->acceptThread = boost::thread(boost::bind(&_Internal::acceptLoop, ptr.get()));
+}
+
+void Daemon::resume(const std::vector<std::string> &games)
+{
+  Lock lock(ptr->mutex);
+  for(int i=0; i<games.size(); i++)
+    {
+      LiveInfo *inf = ptr->find(games[i]);
+      if(inf && inf->isUninstalled())
+        ptr->startJob("install", inf);
+    }
+}
+
+void Daemon::stop() { ptr->setDone(); }
+
+void Daemon::run()
+{
+  time_t lastFlush = std::time(NULL);
+  Spread::JobInfoPtr sizeJob;
+
+  {
+    boost::unique_lock<boost::mutex> lock(ptr->mutex);
+    while(!ptr->done)
+      {
+        ptr->cond.timed_wait(lock, boost::posix_time::seconds(1));
+
+        // Housekeeping, like StatusNotifier::tick() in the GUI
+        time_t now = std::time(NULL);
+        if(difftime(now, lastFlush) >= 60)
+          {
+            lastFlush = now;
+            ptr->repo.flushConfig();
+            Misc::Metrics::writeJson(ptr->repo.getPath("metrics.json"));
+            if(!sizeJob || sizeJob->isFinished())
+              sizeJob = ptr->repo.refreshSizes();
+          }
+      }
+
+    ptr->abortAll();
+    if(sizeJob) sizeJob->abort();
+  }
+  ptr->repo.stopCacheJobs();
+
+  // Wake up the accept thread with a dummy connection, so it sees
+  // that we are done
+  {
+    boost::system::error_code ec;
+    tcp::socket sock(ptr->io);
+    sock.connect(tcp::endpoint(ba::ip::address_v4::loopback(), ptr->port), ec);
+  }
+  ptr->acceptThread.join();
+  boost::system::error_code ec;
+  ptr->acceptor.close(ec);
+
+  /* Client threads use our internals, so they must all be gone before
+     we return. Shutting down their sockets wakes up any that are
+     waiting for input, and watchers notice 'done' on their own.
+   */
+  ClientList::iterator it;
+  for(it = ptr->clients.begin(); it != ptr->clients.end(); it++)
+    it->sock->shutdown(tcp::socket::shutdown_both, ec);
+  ptr->reapClients(true);
+
+  // Give aborted jobs a moment to clean up
+  for(int i=0; i<EXIT_WAIT*10; i++)
+    {
+      bool busy = false;
+      {
+        Lock lock(ptr->mutex);
+        for(JobMap::iterator it = ptr->jobs.begin(); it != ptr->jobs.end(); it++)
+          if(it->second.info && !it->second.info->isFinished())
+            busy = true;
+      }
+      if(!busy) break;
+      boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    }
+
+  ptr->repo.flushConfig();
+  Misc::Metrics::writeJson(ptr->repo.getPath("metrics.json"));
+  bf::remove(ptr->portFile, ec);
+}
@@ -0,0 +1,88 @@
+#ifndef __TIGLIB_DAEMON_HPP_
+#define __TIGLIB_DAEMON_HPP_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+/* Background service mode.
+
+   The daemon owns a locked and loaded Repo, and serves a small line
+   based protocol on a localhost TCP port. Several front-ends (the CLI,
+   or a restarted wx client) can then share one set of install jobs,
+   and the jobs keep running when the front-ends go away.
+
+   Running jobs can not move between processes. When the repository
+   changes owner (see "handoff" below, and "background_jobs" in the wx
+   client), unfinished installs are aborted and restarted from
+   scratch by the new owner. The wx client asks the user before it
+   takes over from a daemon that has jobs running.
+
+   The port and an access token are written to "daemon.port" in the
+   repository, so only users that can read the repository can
+   connect. The first line sent by a client must be the token.
+
+   After that, each request is a single line. The reply is any number
+   of data lines, followed by "ok" or "error <message>". Commands:
+
+     ping                      - check that the daemon is alive
+     list [installed|working]  - status lines for all (or some) games
+     status <game>             - status line for one game
+     outdated                  - status lines for games with updates,
+                                 see Repo::checkUpdates()
+     install <game>            - start installing a game
+     update <game>             - start updating a game
+     uninstall <game>          - uninstall, or abort an install
+     abort <game>              - abort the current job for a game
+     watch                     - stream status lines for running jobs,
+                                 and one final line when each job
+                                 ends. Never replies with "ok"; runs
+                                 until the client disconnects.
+     handoff                   - abort all jobs, reply with the games
+                                 that were being installed, and exit.
+                                 Used when another process wants to
+                                 take over the repository. The jobs
+                                 themselves are not handed over: the
+                                 new owner has to start them again,
+                                 and Spread downloads them again from
+                                 the beginning.
+     shutdown                  - abort all jobs and exit
+
+   Games are given by idname or urlname. Status lines look like
+
+     <idname> <state> <current> <total> <message>
+
+   where state is one of: installed, working, failed, outdated, none.
+ */
+
+namespace TigLib
+{
+  class Repo;
+
+  struct Daemon
+  {
+    // The repo must be locked (initRepo) and loaded (loadData and
+    // doneLoading) before calling start().
+    Daemon(Repo &repo);
+
+    // Start listening. Throws on error.
+    void start();
+
+    // Start installing the given games. Used to pick up jobs that
+    // were handed over from another process.
+    void resume(const std::vector<std::string> &games);
+
+    // Serve requests until stop() is called, or a client asks us to
+    // exit. Running jobs are aborted before returning.
+    void run();
+
+    // Make run() return. Safe to call from any thread.
+    void stop();
+
+  private:
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+  };
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "daemon_client.hpp"
+
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace TigLib;
+namespace ba = boost::asio;
+namespace bf = boost::filesystem;
+using ba::ip::tcp;
+
+bool DaemonStatus::parse(const std::string &line)
+{
+  std::istringstream in(line);
+  if(!(in >> idname >> state >> current >> total))
+    return false;
+
+  // The rest of the line is the message
+  std::getline(in, message);
+  if(!message.empty() && message[0] == ' ')
+    message.erase(0, 1);
+  return true;
+}
+
+struct DaemonClient::_Internal
+{
+  ba::io_service io;
+  tcp::socket sock;
+  ba::streambuf buf;
+  bool connected;
+
+  _Internal() : sock(io), connected(false) {}
+};
+
+DaemonClient::DaemonClient() : ptr(new _Internal) {}
+
+bool DaemonClient::isConnected() const { return ptr->connected; }
+
+void DaemonClient::close()
+{
+  boost::system::error_code ec;
+  ptr->sock.close(ec);
+  ptr->connected = false;
+}
+
+bool DaemonClient::connect(const std::string &repoDir)
+{
+  close();
+
+  std::ifstream inf((bf::path(repoDir) / "daemon.port").string().c_str());
+  int port = 0;
+  std::string token;
+  if(!(inf >> port >> token))
+    return false;
+
+  // A left-over port file from a daemon that died is harmless, the
+  // connection just fails.
+  boost::system::error_code ec;
+  ptr->sock.connect(tcp::endpoint(ba::ip::address_v4::loopback(), port), ec);
+  if(ec) return false;
+  ptr->connected = true;
+
+  // Make sure we are actually talking to the right daemon
+  try
+    {
+      send(token);
+      std::vector<std::string> lines;
+      std::string error;
+      if(request("ping", lines, error))
+        return true;
+    }
+  catch(...) {}
+
+  close();
+  return false;
+}
+
+void DaemonClient::send(const std::string &cmd)
+{
+  if(!ptr->connected)
+    throw std::runtime_error("Not connected to daemon");
+
+  boost::system::error_code ec;
+  ba::write(ptr->sock, ba::buffer(cmd + "\n"), ec);
+  if(ec)
+    {
+      close();
+      throw std::runtime_error("Lost connection to daemon: " + ec.message());
+    }
+}
+
+bool DaemonClient::readLine(std::string &line)
+{
+  if(!ptr->connected) return false;
+
+  boost::system::error_code ec;
+  ba::read_until(ptr->sock, ptr->buf, '\n', ec);
+  if(ec)
+    {
+      close();
+      return false;
+    }
+
+  std::istream is(&ptr->buf);
+  std::getline(is, line);
+  if(!line.empty() && line[line.size()-1] == '\r')
+    line.erase(line.size()-1);
+  return true;
+}
+
+bool DaemonClient::request(const std::string &cmd,
+                           std::vector<std::string> &lines,
+                           std::string &error)
+{
+  send(cmd);
+
+  lines.clear();
+  std::string line;
+  while(readLine(line))
+    {
+      if(line == "ok")
+        return true;
+      if(line.compare(0, 6, "error ") == 0)
+        {
+          error = line.substr(6);
+          return false;
+        }
+      lines.push_back(line);
+    }
+
+  throw std::runtime_error("Lost connection to daemon");
+}
+
+bool DaemonClient::handoff(const std::string &repoDir,
+                           std::vector<std::string> &games)
+{
+  games.clear();
+  DaemonClient cli;
+  if(!cli.connect(repoDir))
+    return false;
+
+  std::string error;
+  try { cli.request("handoff", games, error); }
+  catch(...) {}
+  return true;
+}
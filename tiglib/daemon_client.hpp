@@ -0,0 +1,68 @@
+#ifndef __TIGLIB_DAEMON_CLIENT_HPP_
+#define __TIGLIB_DAEMON_CLIENT_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+/* Connection to a running Daemon (see daemon.hpp). Does not need a
+   Repo, only the repository path, so it can be used while the daemon
+   holds the repository lock.
+ */
+
+namespace TigLib
+{
+  // A parsed status line
+  struct DaemonStatus
+  {
+    std::string idname, state, message;
+    int64_t current, total;
+
+    DaemonStatus() : current(0), total(0) {}
+
+    // Returns false if the line is malformed
+    bool parse(const std::string &line);
+  };
+
+  struct DaemonClient
+  {
+    DaemonClient();
+
+    /* Connect to the daemon serving the given repository. Returns
+       false if no daemon is running there.
+     */
+    bool connect(const std::string &repoDir);
+    bool isConnected() const;
+    void close();
+
+    /* Send a request and collect the data lines of the reply. Returns
+       false if the daemon replied with an error, and puts the error
+       message in 'error'. Throws if the connection is lost.
+     */
+    bool request(const std::string &cmd, std::vector<std::string> &lines,
+                 std::string &error);
+
+    // Send a request without reading the reply. Use readLine() to
+    // read it, eg. for "watch".
+    void send(const std::string &cmd);
+
+    // Read the next line. Returns false if the connection closed.
+    bool readLine(std::string &line);
+
+    /* Ask the daemon serving 'repoDir', if any, to hand over the
+       repository. Returns false if no daemon was running. Otherwise
+       'games' is set to the games it was installing, so the caller
+       can restart them. The daemon releases the repository lock
+       shortly after replying.
+     */
+    static bool handoff(const std::string &repoDir,
+                        std::vector<std::string> &games);
+
+  private:
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+  };
+}
+
+#endif
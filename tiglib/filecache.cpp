@@ -0,0 +1,281 @@
+#include "filecache.hpp"
+#include "misc/filecopy.hpp"
+#include "misc/hashcache.hpp"
+
+#include <map>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace TigLib;
+namespace bf = boost::filesystem;
+
+typedef boost::lock_guard<boost::mutex> Lock;
+
+struct CacheEntry
+{
+  int64_t size;
+
+  // Value of the use counter when the file was last used. Lower
+  // values are evicted first.
+  int64_t lastUse;
+};
+
+typedef std::map<std::string, CacheEntry> Index;
+
+struct FileCache::_Internal
+{
+  boost::mutex mutex;
+  std::string dir;
+  Index index;
+
+  int64_t clock, hits, misses, savedBytes;
+  int tmpCount;
+
+  _Internal() : clock(0), hits(0), misses(0), savedBytes(0), tmpCount(0) {}
+
+  std::string indexFile() const { return (bf::path(dir)/"index.txt").string(); }
+
+  std::string dataFile(const std::string &key) const
+  { return (bf::path(dir)/"data"/key.substr(0,2)/key).string(); }
+
+  void touch(const std::string &key, int64_t size)
+  {
+    CacheEntry &e = index[key];
+    e.size = size;
+    e.lastUse = ++clock;
+  }
+
+  void load()
+  {
+    index.clear();
+    clock = hits = misses = savedBytes = 0;
+
+    std::ifstream inp(indexFile().c_str());
+    std::string line;
+    while(std::getline(inp, line))
+      {
+        std::istringstream str(line);
+        std::string key;
+        str >> key;
+        if(key == "stats")
+          str >> clock >> hits >> misses >> savedBytes;
+        else
+          {
+            CacheEntry e;
+            str >> e.size >> e.lastUse;
+            if(!str.fail()) index[key] = e;
+          }
+      }
+  }
+
+  void save()
+  {
+    if(dir == "") return;
+    bf::create_directories(dir);
+
+    std::string file = indexFile();
+    std::string tmp = file + ".tmp";
+    {
+      std::ofstream out(tmp.c_str());
+      out << "stats " << clock << " " << hits << " " << misses << " "
+          << savedBytes << "\n";
+      for(Index::iterator it = index.begin(); it != index.end(); it++)
+        out << it->first << " " << it->second.size << " "
+            << it->second.lastUse << "\n";
+      if(!out) return;
+    }
+    bf::rename(tmp, file);
+  }
+};
+
+FileCache::FileCache() : ptr(new _Internal) {}
+
+void FileCache::setDir(const std::string &dir)
+{
+  Lock lock(ptr->mutex);
+  ptr->dir = dir;
+  ptr->load();
+}
+
+std::string FileCache::getDir() const
+{
+  Lock lock(ptr->mutex);
+  return ptr->dir;
+}
+
+std::string FileCache::makeKey(uint64_t hash, int64_t size)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%016llx-%lld", (unsigned long long)hash,
+           (long long)size);
+  return buf;
+}
+
+bool FileCache::store(const std::string &file, uint64_t hash, int64_t size,
+                      bool move)
+{
+  std::string key = makeKey(hash, size);
+  std::string dest, tmp;
+  {
+    Lock lock(ptr->mutex);
+    if(ptr->dir == "") return false;
+
+    dest = ptr->dataFile(key);
+    if(ptr->index.count(key) && bf::exists(dest))
+      {
+        ptr->touch(key, size);
+        return true;
+      }
+
+    std::ostringstream str;
+    str << dest << "." << ptr->tmpCount++ << ".tmp";
+    tmp = str.str();
+  }
+
+  try
+    {
+      bf::create_directories(bf::path(dest).parent_path());
+
+      boost::system::error_code ec;
+      if(move)
+        bf::rename(file, tmp, ec);
+      if(!move || ec)
+        {
+          bf::remove(tmp, ec);
+          Misc::FileCopy::copyFile(file, tmp);
+        }
+      bf::rename(tmp, dest);
+    }
+  catch(...)
+    {
+      boost::system::error_code ec;
+      bf::remove(tmp, ec);
+      return false;
+    }
+
+  Lock lock(ptr->mutex);
+  ptr->touch(key, size);
+  return true;
+}
+
+bool FileCache::restore(uint64_t hash, int64_t size, const std::string &dest)
+{
+  // Never overwrite anything
+  if(bf::exists(bf::symlink_status(dest)))
+    return false;
+
+  std::string key = makeKey(hash, size);
+  std::string src;
+  {
+    Lock lock(ptr->mutex);
+    if(!ptr->index.count(key))
+      {
+        ptr->misses++;
+        return false;
+      }
+    src = ptr->dataFile(key);
+  }
+
+  bool ok = false;
+  try
+    {
+      bf::path dir = bf::path(dest).parent_path();
+      if(!dir.empty()) bf::create_directories(dir);
+      Misc::FileCopy::copyFile(src, dest);
+
+      /* Don't trust the cache blindly. Anything could have happened
+         to the file since it was stored. This also records the hash of
+         the new file, so it isn't hashed again when it is checked.
+       */
+      ok = Misc::HashCache::hashFile(dest, false) == hash &&
+        (int64_t)bf::file_size(dest) == size;
+    }
+  catch(...) {}
+
+  Lock lock(ptr->mutex);
+  if(!ok)
+    {
+      boost::system::error_code ec;
+      bf::remove(dest, ec);
+      bf::remove(src, ec);
+      ptr->index.erase(key);
+      ptr->misses++;
+      return false;
+    }
+
+  ptr->touch(key, size);
+  ptr->hits++;
+  ptr->savedBytes += size;
+  return true;
+}
+
+static bool oldestFirst(const std::pair<int64_t, std::string> &a,
+                        const std::pair<int64_t, std::string> &b)
+{ return a.first < b.first; }
+
+int64_t FileCache::gc(int64_t budget, const std::set<std::string> &pinned)
+{
+  std::vector<std::string> evict;
+  int64_t freed = 0;
+  {
+    Lock lock(ptr->mutex);
+
+    int64_t total = 0;
+    std::vector<std::pair<int64_t, std::string> > lru;
+    for(Index::iterator it = ptr->index.begin(); it != ptr->index.end(); it++)
+      {
+        total += it->second.size;
+        if(!pinned.count(it->first))
+          lru.push_back(std::make_pair(it->second.lastUse, it->first));
+      }
+    std::sort(lru.begin(), lru.end(), oldestFirst);
+
+    for(int i=0; i<lru.size() && total > budget; i++)
+      {
+        const std::string &key = lru[i].second;
+        int64_t size = ptr->index[key].size;
+        total -= size;
+        freed += size;
+        evict.push_back(ptr->dataFile(key));
+        ptr->index.erase(key);
+      }
+
+    try { ptr->save(); }
+    catch(...) {}
+  }
+
+  // Delete outside the lock
+  for(int i=0; i<evict.size(); i++)
+    {
+      boost::system::error_code ec;
+      bf::remove(evict[i], ec);
+    }
+
+  return freed;
+}
+
+FileCache::Stats FileCache::getStats() const
+{
+  Lock lock(ptr->mutex);
+  Stats s;
+  s.files = ptr->index.size();
+  s.bytes = 0;
+  for(Index::iterator it = ptr->index.begin(); it != ptr->index.end(); it++)
+    s.bytes += it->second.size;
+  s.hits = ptr->hits;
+  s.misses = ptr->misses;
+  s.savedBytes = ptr->savedBytes;
+  return s;
+}
+
+void FileCache::save()
+{
+  Lock lock(ptr->mutex);
+  ptr->save();
+}
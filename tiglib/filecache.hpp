@@ -0,0 +1,79 @@
+#ifndef __TIGLIB_FILECACHE_HPP_
+#define __TIGLIB_FILECACHE_HPP_
+
+#include <set>
+#include <string>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+namespace TigLib
+{
+  /* Content addressed file store, used to keep the files of
+     uninstalled games around for a while. Reinstalling or repairing a
+     game can then take its files from here instead of downloading
+     them again.
+
+     Files are named by their size and content hash (Misc::hashFile),
+     so identical files are only stored once. The store is kept within
+     a size budget by gc(), which evicts the least recently used files
+     first, except for pinned files (those still used by installed
+     games.)
+
+     All functions are thread safe.
+   */
+  class FileCache
+  {
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+
+  public:
+    struct Stats
+    {
+      // Files and bytes currently stored
+      int64_t files, bytes;
+
+      // Successful and failed lookups, and bytes served from the
+      // cache (and thus not downloaded)
+      int64_t hits, misses, savedBytes;
+
+      double hitRate() const
+      { return hits+misses ? hits / (double)(hits+misses) : 0; }
+    };
+
+    FileCache();
+
+    // Set the cache directory, and load the index from it
+    void setDir(const std::string &dir);
+    std::string getDir() const;
+
+    // Key used for a file in the cache, and in pin lists
+    static std::string makeKey(uint64_t hash, int64_t size);
+
+    /* Add a file to the cache. The caller must supply the file's
+       hash. If 'move' is set, the file is moved into the cache if
+       possible (on the same filesystem this costs no IO), otherwise
+       it is copied. Returns false if the file was not added.
+     */
+    bool store(const std::string &file, uint64_t hash, int64_t size,
+               bool move);
+
+    /* Copy a file out of the cache to 'dest'. The copy is checked
+       against the hash, and bad cache entries are thrown out. Returns
+       false on a miss.
+     */
+    bool restore(uint64_t hash, int64_t size, const std::string &dest);
+
+    /* Evict least recently used files until the cache is no bigger
+       than 'budget' bytes. Files in 'pinned' (see makeKey) are never
+       evicted. Returns the number of bytes freed.
+     */
+    int64_t gc(int64_t budget, const std::set<std::string> &pinned);
+
+    Stats getStats() const;
+
+    // Write the index to disk. Called automatically by gc().
+    void save();
+  };
+}
+
+#endif
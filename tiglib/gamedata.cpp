@@ -47,15 +47,11 @@ void GameData::createLiveData(Repo *repo)
   repo->setLastTime(maxTime);
 
   // Apply install status
-  std::vector<std::string> games = repo->getGameList();
+  std::vector<std::string> games = repo->getInstalledGames();
   for(int i=0; i<games.size(); i++)
     {
-      const std::string &id = games[i];
-      if(repo->getGameDir(id) != "")
-        {
-          LiveInfo *l = get(id);
-          if(l) l->markAsInstalled();
-        }
+      LiveInfo *l = get(games[i]);
+      if(l) l->markAsInstalled();
     }
 
   // Signal child lists that data has changed
@@ -12,11 +12,13 @@ static DLSort dlSort;
 static TitleSort titleSort;
 static RateSort rateSort;
 static DateSort dateSort;
+static SizeSort sizeSort;
 
 void GameLister::sortTitle() { setSort(&titleSort); }
 void GameLister::sortDate() { setSort(&dateSort); }
 void GameLister::sortRating() { setSort(&rateSort); }
 void GameLister::sortDownloads() { setSort(&dlSort); }
+void GameLister::sortSize() { setSort(&sizeSort); }
 
 struct SearchPicker : GamePicker
 {
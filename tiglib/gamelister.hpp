@@ -71,6 +71,7 @@ namespace TigLib
     void sortDate();
     void sortRating();
     void sortDownloads();
+    void sortSize();
 
     // Specify search string
     void setSearch(const std::string &str);
@@ -0,0 +1,103 @@
+#include "install_registry.hpp"
+#include "journalconf.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace TigLib;
+namespace bf = boost::filesystem;
+
+typedef boost::lock_guard<boost::mutex> Lock;
+
+// Maps idname to install dir. Uninstalled games map to "".
+typedef boost::unordered_map<std::string, std::string> DirMap;
+
+struct InstallRegistry::_Internal
+{
+  boost::mutex mutex;
+  DirMap dirs;
+  JournalConf conf;
+};
+
+InstallRegistry::InstallRegistry() : ptr(new _Internal) {}
+
+void InstallRegistry::load(const std::string &file, const std::string &defDir,
+                           bool readOnly)
+{
+  Lock lock(ptr->mutex);
+  ptr->conf.load(file, readOnly);
+  ptr->dirs.clear();
+
+  std::map<std::string, std::string> fixed;
+  std::vector<std::string> names = ptr->conf.getNames();
+  for(int i=0; i<names.size(); i++)
+    {
+      const std::string &id = names[i];
+      std::string val = ptr->conf.get(id);
+
+      // Convert old int values
+      std::string newVal = val;
+      if(val == "0") newVal = "";
+      else if(val == "2") newVal = (bf::path(defDir)/id).string();
+      if(newVal != val) fixed[id] = newVal;
+
+      ptr->dirs[id] = newVal;
+    }
+
+  if(!fixed.empty())
+    ptr->conf.setMany(fixed);
+}
+
+std::string InstallRegistry::getDir(const std::string &idname) const
+{
+  Lock lock(ptr->mutex);
+  DirMap::const_iterator it = ptr->dirs.find(idname);
+  if(it == ptr->dirs.end()) return "";
+  return it->second;
+}
+
+bool InstallRegistry::isInstalled(const std::string &idname) const
+{
+  Lock lock(ptr->mutex);
+  DirMap::const_iterator it = ptr->dirs.find(idname);
+  return it != ptr->dirs.end() && it->second != "";
+}
+
+void InstallRegistry::setInstalled(const std::string &idname,
+                                   const std::string &dir)
+{
+  Lock lock(ptr->mutex);
+  ptr->dirs[idname] = dir;
+  ptr->conf.set(idname, dir);
+}
+
+void InstallRegistry::setUninstalled(const std::string &idname)
+{
+  setInstalled(idname, "");
+}
+
+std::vector<std::string> InstallRegistry::getInstalled() const
+{
+  Lock lock(ptr->mutex);
+  std::vector<std::string> res;
+  for(DirMap::const_iterator it = ptr->dirs.begin(); it != ptr->dirs.end(); it++)
+    if(it->second != "")
+      res.push_back(it->first);
+  return res;
+}
+
+std::vector<std::string> InstallRegistry::getAll() const
+{
+  Lock lock(ptr->mutex);
+  std::vector<std::string> res;
+  for(DirMap::const_iterator it = ptr->dirs.begin(); it != ptr->dirs.end(); it++)
+    res.push_back(it->first);
+  return res;
+}
+
+void InstallRegistry::flush()
+{
+  ptr->conf.flush();
+}
@@ -0,0 +1,55 @@
+#ifndef __TIGLIB_INSTALL_REGISTRY_HPP_
+#define __TIGLIB_INSTALL_REGISTRY_HPP_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+namespace TigLib
+{
+  /* Keeps track of where each game is installed.
+
+     The config file (tiglib_installed.conf) is only read once, in
+     load(). After that all lookups are served from memory, so they
+     are cheap enough to use on every list refresh. Changes are
+     written back in the background through JournalConf.
+
+     Older versions stored "0" for uninstalled games and "2" for games
+     in the default location. These are converted once on load.
+
+     All functions are thread safe.
+   */
+  class InstallRegistry
+  {
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+
+  public:
+    InstallRegistry();
+
+    /* Load the registry from 'file'. Legacy entries for games in the
+       default location are resolved to 'defDir'/idname. With
+       'readOnly', changes are never saved (see JournalConf.)
+     */
+    void load(const std::string &file, const std::string &defDir,
+              bool readOnly=false);
+
+    // Install dir of a game, or "" if it is not installed
+    std::string getDir(const std::string &idname) const;
+    bool isInstalled(const std::string &idname) const;
+
+    void setInstalled(const std::string &idname, const std::string &dir);
+    void setUninstalled(const std::string &idname);
+
+    // All games that are currently installed
+    std::vector<std::string> getInstalled() const;
+
+    // All games that are or have ever been installed
+    std::vector<std::string> getAll() const;
+
+    // Write pending changes to disk
+    void flush();
+  };
+}
+
+#endif
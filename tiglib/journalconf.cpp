@@ -0,0 +1,386 @@
+#include "journalconf.hpp"
+#include "misc/metrics.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <spread/misc/jconfig.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace TigLib;
+namespace bf = boost::filesystem;
+
+typedef boost::lock_guard<boost::mutex> Lock;
+typedef std::pair<std::string, std::string> Record;
+
+// How long to wait for more changes before writing them out
+#define FLUSH_DELAY_MS 250
+
+// Don't compact journals smaller than this
+#define COMPACT_MIN 1000
+
+// Make sure a written file has hit the disk
+static void syncFile(FILE *f)
+{
+#ifdef _WIN32
+  _commit(_fileno(f));
+#else
+  fsync(fileno(f));
+#endif
+}
+
+static void syncFile(const std::string &file)
+{
+#ifndef _WIN32
+  int fd = open(file.c_str(), O_RDONLY);
+  if(fd == -1) return;
+  fsync(fd);
+  close(fd);
+#endif
+}
+
+struct JournalConf::_Internal
+{
+  // Protects everything below except ioMutex. Never held during IO.
+  boost::mutex mutex;
+
+  // Serializes writes to the journal and main file
+  boost::mutex ioMutex;
+
+  boost::condition_variable cond;
+  boost::thread thread;
+  bool running, stop, readOnly;
+
+  // Current values. This is never saved directly, but we let it do
+  // the encoding of values, so they stay compatible with JConfig.
+  boost::shared_ptr<Misc::JConfig> mem;
+
+  std::string file;
+
+  // Changes not yet written, and number of records in the journal
+  std::vector<Record> pending;
+  int64_t records;
+
+  _Internal() : running(false), stop(false), readOnly(false),
+                mem(new Misc::JConfig),
+                records(0) {}
+
+  ~_Internal()
+  {
+    {
+      Lock lock(mutex);
+      stop = true;
+    }
+    cond.notify_all();
+    if(running) thread.join();
+    flush();
+  }
+
+  std::string journal() const { return file + ".journal"; }
+
+  // Called with 'mutex' held after each change to 'mem'
+  void changed(const std::string &name)
+  {
+    if(readOnly) return;
+    pending.push_back(Record(name, mem->get(name)));
+
+    if(!running)
+      {
+        thread = boost::thread(boost::bind(&_Internal::run, this));
+        running = true;
+      }
+    cond.notify_all();
+  }
+
+  // Background writer
+  void run()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while(!stop)
+      {
+        if(pending.empty())
+          {
+            cond.wait(lock);
+            continue;
+          }
+
+        // Give more changes a chance to arrive, so they can all be
+        // written with one sync.
+        boost::system_time until = boost::get_system_time() +
+          boost::posix_time::milliseconds(FLUSH_DELAY_MS);
+        while(!stop && cond.timed_wait(lock, until)) {}
+
+        lock.unlock();
+        flush();
+        maybeCompact();
+        lock.lock();
+      }
+  }
+
+  // Append records to the journal and sync it
+  static bool append(const std::string &jfile, const std::vector<Record> &out)
+  {
+    std::ostringstream str;
+    for(int i=0; i<out.size(); i++)
+      str << out[i].first.size() << " " << out[i].second.size() << " "
+          << out[i].first << out[i].second << "\n";
+    const std::string &data = str.str();
+
+    bool ok = false;
+    FILE *f = fopen(jfile.c_str(), "ab");
+    if(f)
+      {
+        ok = fwrite(data.c_str(), 1, data.size(), f) == data.size() &&
+          fflush(f) == 0;
+        if(ok) syncFile(f);
+        fclose(f);
+      }
+    return ok;
+  }
+
+  /* Write out 'pending' until it is empty. Called with ioMutex held
+     and 'lock' holding 'mutex', which is released during the actual
+     writing. Since 'pending' is only ever emptied here, a change is
+     either still in 'pending' or already in the journal when this
+     returns. Returns false if writing failed.
+   */
+  bool drain(boost::unique_lock<boost::mutex> &lock)
+  {
+    while(!pending.empty())
+      {
+        if(file == "" || readOnly) return true;
+
+        std::vector<Record> out;
+        out.swap(pending);
+        std::string jfile = journal();
+
+        lock.unlock();
+        bool ok = append(jfile, out);
+        lock.lock();
+
+        if(!ok)
+          {
+            // Try again later, ahead of anything that came in since
+            pending.insert(pending.begin(), out.begin(), out.end());
+            return false;
+          }
+
+        records += out.size();
+        Misc::Metrics::count("conf.syncs");
+        Misc::Metrics::sample("conf.batch_size", out.size());
+      }
+    return true;
+  }
+
+  void flush()
+  {
+    Lock io(ioMutex);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    drain(lock);
+  }
+
+  void compact()
+  {
+    Lock io(ioMutex);
+
+    std::map<std::string, std::string> all;
+    std::string fname, jfile;
+    {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      if(file == "" || readOnly) return;
+
+      /* The new file must not contain anything the journal doesn't,
+         or replaying the journal over it after a crash would bring
+         back older values. So write out pending changes first, and
+         take the snapshot before letting go of the lock.
+       */
+      if(!drain(lock)) return;
+
+      fname = file;
+      jfile = journal();
+
+      std::vector<std::string> names = mem->getNames();
+      for(int i=0; i<names.size(); i++)
+        all[names[i]] = mem->get(names[i]);
+    }
+
+    /* Write the new file next to the old one and swap it in, and only
+       then drop the journal. If we crash halfway, replaying the
+       journal on top of either file gives the same result.
+     */
+    try
+      {
+        std::string tmp = fname + ".tmp";
+        bf::remove(tmp);
+        if(all.empty())
+          bf::remove(fname);
+        else
+          {
+            {
+              Misc::JConfig out;
+              out.load(tmp);
+              out.setMany(all);
+            }
+            syncFile(tmp);
+            bf::rename(tmp, fname);
+          }
+        bf::remove(jfile);
+      }
+    catch(...) { return; }
+
+    Lock lock(mutex);
+    records = 0;
+    Misc::Metrics::count("conf.compactions");
+  }
+
+  void maybeCompact()
+  {
+    {
+      Lock lock(mutex);
+      if(records < COMPACT_MIN || records < 2*(int64_t)mem->getNames().size())
+        return;
+    }
+    compact();
+  }
+
+  // Read the journal into 'mem'. Stops at the first broken record,
+  // which is what a crash in the middle of a write leaves behind.
+  void replay()
+  {
+    std::ifstream inp(journal().c_str(), std::ios::binary);
+    while(inp)
+      {
+        int64_t nlen, vlen;
+        if(!(inp >> nlen >> vlen) || inp.get() != ' ') break;
+        if(nlen < 0 || vlen < 0 || nlen > (1<<20) || vlen > (1<<26)) break;
+
+        std::string name(nlen, ' '), value(vlen, ' ');
+        if(nlen) inp.read(&name[0], nlen);
+        if(vlen) inp.read(&value[0], vlen);
+        if(!inp || inp.get() != '\n') break;
+
+        mem->set(name, value);
+        records++;
+      }
+  }
+};
+
+JournalConf::JournalConf() : ptr(new _Internal) {}
+
+void JournalConf::load(const std::string &file, bool readOnly)
+{
+  bool dirty;
+  {
+    Lock io(ptr->ioMutex);
+    boost::unique_lock<boost::mutex> lock(ptr->mutex);
+
+    /* Changes made so far belong to the previous file. Write them out
+       without letting go of ioMutex, so nothing set() in the meantime
+       is lost when we switch files below.
+     */
+    ptr->drain(lock);
+
+    ptr->file = file;
+    ptr->readOnly = readOnly;
+    ptr->records = 0;
+    ptr->pending.clear();
+    ptr->mem.reset(new Misc::JConfig);
+
+    Misc::JConfig disk;
+    disk.load(file);
+    std::map<std::string, std::string> all;
+    std::vector<std::string> names = disk.getNames();
+    for(int i=0; i<names.size(); i++)
+      all[names[i]] = disk.get(names[i]);
+    if(!all.empty())
+      ptr->mem->setMany(all);
+
+    /* A journal ending in a broken record can't be appended to, as
+       replay() would never get past it. So compact it away even when
+       nothing in it could be read.
+     */
+    ptr->replay();
+    dirty = ptr->records != 0 || bf::exists(ptr->journal());
+  }
+
+  // Start out with an empty journal
+  if(dirty) ptr->compact();
+}
+
+void JournalConf::flush() { ptr->flush(); }
+void JournalConf::compact() { ptr->compact(); }
+
+#define SETTER(func, type)                                      \
+  void JournalConf::func(const std::string &name, type val)     \
+  {                                                             \
+    Lock lock(ptr->mutex);                                      \
+    ptr->mem->func(name, val);                                  \
+    ptr->changed(name);                                         \
+  }
+
+SETTER(set, const std::string&)
+SETTER(setBool, bool)
+SETTER(setInt, int)
+SETTER(setInt64, int64_t)
+
+void JournalConf::setData(const std::string &name, const void *p, int num)
+{
+  Lock lock(ptr->mutex);
+  ptr->mem->setData(name, p, num);
+  ptr->changed(name);
+}
+
+void JournalConf::setMany(const std::map<std::string,std::string> &entries)
+{
+  Lock lock(ptr->mutex);
+  ptr->mem->setMany(entries);
+  std::map<std::string,std::string>::const_iterator it;
+  for(it = entries.begin(); it != entries.end(); it++)
+    ptr->changed(it->first);
+}
+
+std::string JournalConf::get(const std::string &name,
+                             const std::string &def) const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->get(name, def);
+}
+
+bool JournalConf::getBool(const std::string &name, bool def) const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->getBool(name, def);
+}
+
+int JournalConf::getInt(const std::string &name, int def) const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->getInt(name, def);
+}
+
+int64_t JournalConf::getInt64(const std::string &name, int64_t def) const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->getInt64(name, def);
+}
+
+bool JournalConf::has(const std::string &name) const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->has(name);
+}
+
+std::vector<std::string> JournalConf::getNames() const
+{
+  Lock lock(ptr->mutex);
+  return ptr->mem->getNames();
+}
@@ -0,0 +1,76 @@
+#ifndef __TIGLIB_JOURNALCONF_HPP_
+#define __TIGLIB_JOURNALCONF_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+
+namespace TigLib
+{
+  /* Drop-in replacement for Misc::JConfig, for config files that are
+     updated often.
+
+     JConfig rewrites the entire file on every set(). Here, changes are
+     instead appended to a journal next to the file (<file>.journal),
+     from a background thread. Changes made within a short window are
+     written together, with a single sync, so updating many keys in a
+     row costs no more than updating one.
+
+     When the journal grows large compared to the data, it is folded
+     back into the main file (compacted). This also happens on every
+     load(), so the main file stays a normal JConfig file, and other
+     code (such as the importer) can keep reading and writing it
+     directly while the repo is not loaded.
+
+     Changes not yet written are lost if the process dies, but the
+     file is never left in a broken state. Use flush() to force them
+     out.
+
+     All functions are thread safe.
+   */
+  class JournalConf
+  {
+    struct _Internal;
+    boost::shared_ptr<_Internal> ptr;
+
+  public:
+    JournalConf();
+
+    /* Load a file and its journal. Writes any pending changes to the
+       previous file first.
+
+       With 'readOnly', the files are never written. Changes are
+       still visible in memory, but are not saved. Used when another
+       process owns the repository.
+     */
+    void load(const std::string &file, bool readOnly=false);
+
+    // Write all pending changes to the journal, and wait for them to
+    // hit the disk.
+    void flush();
+
+    // Rewrite the main file from the current state, and clear the
+    // journal.
+    void compact();
+
+    // The rest works just like JConfig
+    void set(const std::string &name, const std::string &value);
+    void setBool(const std::string &name, bool b);
+    void setInt(const std::string &name, int i);
+    void setInt64(const std::string &name, int64_t i);
+    void setData(const std::string &name, const void *p, int num);
+    void setMany(const std::map<std::string,std::string> &entries);
+
+    std::string get(const std::string &name, const std::string &def="") const;
+    bool getBool(const std::string &name, bool def=false) const;
+    int getInt(const std::string &name, int def=0) const;
+    int64_t getInt64(const std::string &name, int64_t def=0) const;
+
+    bool has(const std::string &name) const;
+    std::vector<std::string> getNames() const;
+  };
+}
+
+#endif
@@ -1,7 +1,6 @@
 #include "liveinfo.hpp"
 #include "repo.hpp"
 #include "server_api.hpp"
-#include "launcher/run.hpp"
 #include <boost/filesystem.hpp>
 #include <assert.h>
 
@@ -39,6 +38,12 @@ bool LiveInfo::isWorking() const
   return installJob && installJob->isCreated() && !installJob->isFinished();
 }
 
+bool LiveInfo::isBusy() const
+{
+  return isWorking() ||
+    (otherJob && otherJob->isCreated() && !otherJob->isFinished());
+}
+
 void LiveInfo::setupInfo()
 {
   if(!installJob)
@@ -58,6 +63,12 @@ std::string LiveInfo::getInstallDir() const
   return repo->getGameDir(ent->idname);
 }
 
+int64_t LiveInfo::getSize() const
+{
+  if(!isInstalled()) return 0;
+  return repo->getGameSize(ent->idname);
+}
+
 int LiveInfo::getMyRating()
 {
   if(myRate == -2)
@@ -108,7 +119,8 @@ Spread::JobInfoPtr LiveInfo::update(bool async)
   assert(isInstalled());
   std::string instDir = repo->getGameDir(ent->idname);
   assert(instDir != "");
-  return repo->startInstall(ent->idname, ent->urlname, instDir, async);
+  otherJob = repo->startInstall(ent->idname, ent->urlname, instDir, async);
+  return otherJob;
 }
 
 Spread::JobInfoPtr LiveInfo::uninstall(bool async)
@@ -127,18 +139,18 @@ Spread::JobInfoPtr LiveInfo::uninstall(bool async)
   return repo->startUninstall(ent->idname, async);
 }
 
-void LiveInfo::launch() const
+Spread::JobInfoPtr LiveInfo::verify(Misc::Verify::Report *report,
+                                    bool repair, bool async)
 {
   assert(isInstalled());
+  otherJob = repo->verifyGame(ent->idname, repair, report, async);
+  return otherJob;
+}
 
-  // Figure out what to run
-  bs::path exe = getInstallDir();
-  exe /= ent->launch;
-
-  // Use executable location as working directory
-  bs::path work = exe.parent_path();
-
-  Launcher::run(exe.string(), work.string());
+void LiveInfo::launch() const
+{
+  assert(isInstalled());
+  repo->launchGame(ent->idname, ent->launch);
 }
 
 std::string LiveInfo::getScreenshot() const
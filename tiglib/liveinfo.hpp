@@ -2,6 +2,7 @@
 #define __TIGLIB_LIVEINFO_HPP_
 
 #include "gameinfo/tigentry.hpp"
+#include "misc/verify.hpp"
 #include <spread/job/jobinfo.hpp>
 
 namespace TigLib
@@ -29,6 +30,18 @@ namespace TigLib
     bool isUninstalled() const;
     bool isWorking() const;
 
+    /* True while an install, update or verify job is using the game's
+       files. Jobs that go through the files of all games, such as
+       Repo::dedupGames(), skip busy games.
+     */
+    bool isBusy() const;
+
+    /* Attach an update or verify job that was started outside of
+       LiveInfo, so isBusy() knows about it. Unlike setStatus(), this
+       does not change the install status.
+     */
+    void setOtherJob(Spread::JobInfoPtr info) { otherJob = info; }
+
     // Convenience function to get install status
     std::string progress(int64_t &current, int64_t &total)
     {
@@ -84,6 +97,17 @@ namespace TigLib
      */
     Spread::JobInfoPtr uninstall(bool async = true);
 
+    /* Check the installed files for corruption, and optionally
+       repair them. See Repo::verifyGame(). Only valid if the game is
+       installed.
+     */
+    Spread::JobInfoPtr verify(Misc::Verify::Report *report,
+                              bool repair = false, bool async = true);
+
+    // Disk space used by the installed game. Zero if unknown or not
+    // installed.
+    int64_t getSize() const;
+
     // Return install directory for this game. Only valid if the game
     // is installed.
     std::string getInstallDir() const;
@@ -119,6 +143,9 @@ namespace TigLib
 
   private:
     Spread::JobInfoPtr installJob;
+
+    // Last update or verify job
+    Spread::JobInfoPtr otherJob;
     Repo *repo;
     int myRate;
 
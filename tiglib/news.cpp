@@ -3,10 +3,11 @@
 #include "repo.hpp"
 
 #include <assert.h>
-#include <set>
-#include <ctime>
+#include <algorithm>
+#include <boost/filesystem.hpp>
 
 using namespace TigLib;
+namespace bf = boost::filesystem;
 
 static void add(std::vector<NewsItem> &list,
                 const std::string &id,
@@ -24,10 +25,19 @@ static void add(std::vector<NewsItem> &list,
   list.push_back(i);
 }
 
+static bool isError(const NewsItem &it) { return it.id == ""; }
+
+// Replaces any earlier error message
 void error(std::vector<NewsItem> &list,
            const std::string &body)
 {
-  add(list, "", std::time(NULL), "Error", body, true);
+  list.erase(std::remove_if(list.begin(), list.end(), isError), list.end());
+  list.insert(list.begin(), NewsItem());
+  NewsItem &i = list[0];
+  i.date = std::time(NULL);
+  i.subject = "Error";
+  i.body = body;
+  i.isRead = true;
 }
 
 struct DateSorter
@@ -36,59 +46,109 @@ struct DateSorter
   { return a.date > b.date; }
 };
 
-void NewsReader::reload()
+bool NewsReader::reload()
 {
   using namespace Json;
 
+  // Only read the read-status list once. After that it's kept up to
+  // date by markAsRead().
+  if(!readLoaded)
+    {
+      std::vector<std::string> names = repo->news.getNames();
+      readIds.insert(names.begin(), names.end());
+      readLoaded = true;
+    }
+
   try
     {
       std::string file = repo->getNewsFile();
 
+      // Nothing to do if the file hasn't changed
+      boost::system::error_code ec;
+      std::time_t time = bf::last_write_time(file, ec);
+      int64_t size = ec ? -1 : (int64_t)bf::file_size(file, ec);
+      if(!ec && time == fileTime && size == fileSize)
+        return false;
+
       Value root = ReadJson::readJson(file);
       if(!root.isObject())
         {
+          items.clear();
           error(items, "No news items were found");
-          return;
+          fileSize = -1;
+          return true;
+        }
+      fileTime = time;
+      fileSize = size;
+
+      /* Drop items that are no longer in the file (including any
+         earlier error message), or that were edited upstream, and
+         note which ones we can keep. Edited items are read again
+         below, and merged back in at their new date.
+       */
+      boost::unordered_set<std::string> have;
+      std::vector<NewsItem> kept;
+      kept.reserve(items.size());
+      for(int i=0; i<items.size(); i++)
+        {
+          const NewsItem &item = items[i];
+          if(item.id == "" || !root.isMember(item.id)) continue;
+
+          Value ent = root[item.id];
+          if((time_t)ent["date"].asUInt() != item.date ||
+             ent["subject"].asString() != item.subject ||
+             ent["body"].asString() != item.body)
+            continue;
+
+          have.insert(item.id);
+          kept.push_back(item);
         }
+      bool changed = kept.size() != items.size();
+      items.swap(kept);
 
+      std::vector<NewsItem> added;
       Value::Members keys = root.getMemberNames();
       Value::Members::iterator it;
-      items.clear();
       for(it = keys.begin(); it != keys.end(); it++)
         {
           const std::string &id = *it;
-          Value ent = root[id];
+          if(have.count(id)) continue;
 
-          add(items, id, ent["date"].asUInt(),
-              ent["subject"].asString(), ent["body"].asString());
+          Value ent = root[id];
+          add(added, id, ent["date"].asUInt(),
+              ent["subject"].asString(), ent["body"].asString(),
+              readIds.count(id) != 0);
         }
+      if(added.empty()) return changed;
 
-      // Create a lookup of read items
-      std::set<std::string> haveRead;
-      std::vector<std::string> names =
-        repo->news.getNames();
-      for(int i=0; i<names.size(); i++)
-        haveRead.insert(names[i]);
-
-      // Apply status
-      for(int i=0; i<items.size(); i++)
-        if(haveRead.count(items[i].id))
-          items[i].isRead = true;
-
-      // Finally, sort items by date
-      sort(items.begin(), items.end(), DateSorter());
+      // Merge the new items into the already sorted list
+      std::stable_sort(added.begin(), added.end(), DateSorter());
+      int mid = items.size();
+      items.insert(items.end(), added.begin(), added.end());
+      std::inplace_merge(items.begin(), items.begin()+mid, items.end(),
+                         DateSorter());
     }
   catch(std::exception &e)
-    { error(items, e.what()); }
+    {
+      error(items, e.what());
+      fileSize = -1;
+    }
   catch(...)
-    { error(items, "Unknown error"); }
+    {
+      error(items, "Unknown error");
+      fileSize = -1;
+    }
+
+  return true;
 }
 
 void NewsReader::markAsRead(int i)
 {
   assert(i >= 0 && i < size());
   NewsItem &it = items[i];
+  if(it.isRead) return;
   it.isRead = true;
+  readIds.insert(it.id);
   repo->news.setBool(it.id, true);
 }
 
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <ctime>
+#include <stdint.h>
+#include <boost/unordered_set.hpp>
 
 namespace TigLib
 {
@@ -16,10 +19,17 @@ namespace TigLib
   class Repo;
   struct NewsReader
   {
-    NewsReader(Repo *_repo) : repo(_repo) {}
+    NewsReader(Repo *_repo) : repo(_repo), readLoaded(false),
+                              fileTime(0), fileSize(-1) {}
 
-    // Fetch from the net and load into memory
-    void reload();
+    /* Load news from disk into memory. The list is kept sorted by
+       date, newest first. The news file is only parsed when it has
+       changed since the last call, and only new or edited items are
+       read into the list.
+
+       Returns true if the list changed.
+     */
+    bool reload();
 
     // Mark one or all items as read
     void markAsRead(int);
@@ -32,6 +42,14 @@ namespace TigLib
   private:
     std::vector<NewsItem> items;
     Repo *repo;
+
+    // Ids of read items, loaded from the repo once
+    boost::unordered_set<std::string> readIds;
+    bool readLoaded;
+
+    // News file timestamp and size when last parsed
+    std::time_t fileTime;
+    int64_t fileSize;
   };
 }
 
@@ -1,15 +1,33 @@
 #include "repo.hpp"
 #include "server_api.hpp"
 #include "repo_locator.hpp"
+#include "liveinfo.hpp"
+#include "filecache.hpp"
+#include "spread_cache.hpp"
 #include "misc/lockfile.hpp"
 #include "misc/fetch.hpp"
+#include "misc/trace.hpp"
+#include "misc/metrics.hpp"
+#include "misc/trash.hpp"
+#include "misc/freespace.hpp"
+#include "misc/hashcache.hpp"
+#include "misc/filecopy.hpp"
+#include "misc/dirwatch.hpp"
+#include "misc/prewarm.hpp"
+#include "launcher/run.hpp"
 #include "gameinfo/stats_json.hpp"
 #include <spread/job/thread.hpp>
 #include <spread/spread.hpp>
 #include <spread/hash/hash.hpp>
 #include <spread/tasks/download.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <stdio.h>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <ctime>
 
 using namespace TigLib;
 using namespace Spread;
@@ -35,8 +53,23 @@ struct Repo::_Internal
   // Used by fetchFiles()
   bool newData;
 
+  // Watches installed games for changes, see refreshSizes()
+  Misc::DirWatch watch;
+
+  // Last time games that can't be watched were rescanned
+  time_t lastUnwatched;
+
+  // Files from uninstalled games
+  FileCache cache;
+
+  /* Background jobs using 'cache', see runCacheJob(). They run one at
+     a time, holding cacheJobMutex.
+   */
+  boost::mutex cacheJobMutex, cacheJobsMutex;
+  std::vector<JobInfoPtr> cacheJobs;
+
   _Internal(const std::string &spreadDir, const std::string &tmpDir)
-    : spread(spreadDir, tmpDir), tmp(tmpDir)
+    : spread(spreadDir, tmpDir), tmp(tmpDir), lastUnwatched(0)
   {
     CallbackURL cb;
     spread.setURLCallback(cb);
@@ -45,12 +78,58 @@ struct Repo::_Internal
   }
 
   ~_Internal()
-  { bf::remove_all(tmp); }
+  {
+    // Cache jobs point to our members, so they must be gone first
+    stopCacheJobs();
+    bf::remove_all(tmp);
+  }
+
+  JobInfoPtr runCacheJob(Job *job, bool async)
+  {
+    JobInfoPtr info = Thread::run(job, async);
+    boost::lock_guard<boost::mutex> lock(cacheJobsMutex);
+    for(int i=cacheJobs.size()-1; i>=0; i--)
+      if(cacheJobs[i]->isFinished())
+        cacheJobs.erase(cacheJobs.begin()+i);
+    if(!info->isFinished())
+      cacheJobs.push_back(info);
+    return info;
+  }
+
+  void stopCacheJobs()
+  {
+    std::vector<JobInfoPtr> jobs;
+    {
+      boost::lock_guard<boost::mutex> lock(cacheJobsMutex);
+      jobs.swap(cacheJobs);
+    }
+    for(int i=0; i<jobs.size(); i++)
+      jobs[i]->abort();
+    for(int i=0; i<jobs.size(); i++)
+      while(!jobs[i]->isFinished())
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  }
 };
 
+void Repo::stopCacheJobs()
+{
+  if(ptr) ptr->stopCacheJobs();
+}
+
 bool Repo::isLocked() const
 { return ptr && ptr->lock.isLocked(); }
 
+bool Repo::isReadOnly() const
+{ return ptr && ptr->lock.isShared(); }
+
+int Repo::getLockOwner() const
+{
+  assert(ptr);
+  assert(dir != "");
+  Misc::LockFile lock(getPath("lock"));
+  return lock.getOwner();
+}
+
 const InfoLookup &Repo::getList() const
 {
   assert(ptr);
@@ -129,16 +208,49 @@ bool Repo::initRepo(bool forceLock)
   if(!ptr->lock.lock(getPath("lock"), forceLock))
     return false;
 
-  // Open config files
-  conf.load(getPath("tiglib.conf"));
-  inst.load(getPath("tiglib_installed.conf"));
-  news.load(getPath("tiglib_news.conf"));
-  rates.load(getPath("tiglib_rates.conf"));
+  loadConfig(false);
+
+  // Finish deleting anything left over from earlier uninstalls
+  if(Misc::Trash::hasItems(getPath("trash")))
+    emptyTrash();
+
+  // Shrink the cache, in case the budget was lowered
+  cacheGC();
+
+  return true;
+}
+
+bool Repo::initRepoReadOnly()
+{
+  assert(ptr);
+  assert(dir != "");
+
+  // Readers never create the repository
+  if(!bf::is_directory(dir))
+    return false;
+
+  ptr->lock.setFile(getPath("lock"));
+  if(!ptr->lock.lockShared())
+    return false;
+
+  loadConfig(true);
+  return true;
+}
+
+void Repo::loadConfig(bool readOnly)
+{
+  conf.load(getPath("tiglib.conf"), readOnly);
+  inst.load(getPath("tiglib_installed.conf"), getPath("gamedata"), readOnly);
+  sizes.load(getPath("tiglib_sizes.conf"), readOnly);
+  versions.load(getPath("tiglib_versions.conf"), readOnly);
+  news.load(getPath("tiglib_news.conf"), readOnly);
+  rates.load(getPath("tiglib_rates.conf"), readOnly);
 
   // Load config options
   lastTime = conf.getInt64("last_time", -1);
 
-  return true;
+  ptr->cache.setDir(getPath("cache"));
+  Misc::HashCache::load(getPath("tiglib_hashes.txt"), readOnly);
 }
 
 void Repo::setLastTime(int64_t val)
@@ -148,6 +260,16 @@ void Repo::setLastTime(int64_t val)
   conf.setData("last_time", &val, 8);
 }
 
+void Repo::flushConfig()
+{
+  conf.flush();
+  inst.flush();
+  sizes.flush();
+  versions.flush();
+  news.flush();
+  rates.flush();
+}
+
 int Repo::getRating(const std::string &id)
 {
   int res = rates.getInt(id, -1);
@@ -205,17 +327,29 @@ struct FetchJob : Job
   void doJob()
   {
     using namespace std;
+    TRACE_SCOPE("FetchJob");
+    Misc::Metrics::Timer tm("fetch.time_us");
 
-    JobInfoPtr client = spread.updateFromURL("tiggit.net", ServerAPI::spreadURL_SR0());
+    JobInfoPtr client;
+    {
+      SpreadLock lock;
+      client = spread.updateFromURL("tiggit.net", ServerAPI::spreadURL_SR0());
+    }
     if(waitClient(client)) return;
 
     // Set newData depending on whether data was updated
-    *newData = spread.wasUpdated("tiggit.net");
+    {
+      SpreadLock lock;
+      *newData = spread.wasUpdated("tiggit.net");
+    }
 
     if(shots)
       {
         std::string dest = (bf::path(shotsPath)/"tiggit.net").string();
-        client = spread.install("tiggit.net", "shots300x260", dest);
+        {
+          SpreadLock lock;
+          client = spread.install("tiggit.net", "shots300x260", dest);
+        }
         if(waitClient(client)) return;
       }
 
@@ -245,7 +379,7 @@ JobInfoPtr Repo::fetchFiles(bool includeShots, bool async)
   // If we're in offline mode, skip this entire function
   if(offline) return JobInfoPtr();
 
-  assert(isLocked());
+  assert(isLocked() && !isReadOnly());
 
   // Create and run the fetch job
   return Thread::run(new FetchJob(ptr->spread, includeShots, spreadDir,
@@ -253,26 +387,6 @@ JobInfoPtr Repo::fetchFiles(bool includeShots, bool async)
                                   &ptr->newData), async);
 }
 
-std::string Repo::getGameDir(const std::string &idname)
-{
-  if(inst.has(idname))
-    {
-      std::string val = inst.get(idname);
-
-      // Check for old int values
-      std::string newVal = val;
-      if(val == "0") newVal = "";
-      else if(val == "2") newVal = getDefGameDir(idname);
-
-      // Update the stored value if it was altered
-      if(newVal != val)
-        inst.set(idname, newVal);
-
-      return newVal;
-    }
-  return "";
-}
-
 void Repo::loadStats()
 {
   // Always ignore errors, stats aren't critically important
@@ -287,6 +401,8 @@ void Repo::doneLoading()
 
 void Repo::loadData()
 {
+  TRACE_SCOPE("Repo::loadData");
+  Misc::Metrics::Timer tm("repo.load_us");
   assert(isLocked());
 
   // TODO: This kills everything. Later we might add the possiblity to
@@ -309,15 +425,168 @@ struct InstallJob : Job
 {
   std::string sendOnDone;
   JobInfoPtr client;
-  std::string idname, where;
-  Misc::JConfig *inst;
+  std::string idname, where, manifest;
+  InstallRegistry *inst;
+  JournalConf *conf, *sizes, *versions;
+  SpreadLib *spread;
+
+  // Space taken up by an earlier install of this game, or -1
+  int64_t oldSize;
+
+  // Files kept from an earlier install of this game, if any
+  FileCache *cache;
+  std::string cachedManifest, staging;
+
+  /* Copy the files we still have from an earlier install into a
+     staging directory, and tell Spread about them. Spread then copies
+     them from there instead of downloading them.
+   */
+  void seedFromCache()
+  {
+    Misc::Verify::Manifest man;
+    try { if(!Misc::Verify::load(cachedManifest, man)) return; }
+    catch(...) { return; }
+
+    setBusy("Looking for cached files");
+    std::vector<std::string> files;
+    Misc::Verify::Manifest::iterator it;
+    for(it = man.begin(); it != man.end(); it++)
+      {
+        std::string file = (bf::path(staging)/it->first).string();
+        if(cache->restore(it->second.hash, it->second.size, file))
+          files.push_back(file);
+      }
+    cache->save();
+    cacheFiles(*spread, files);
+  }
+
+  /* Spread only tells us the download size, and archives unpack to
+     more than that. Estimate the installed size from how much earlier
+     installs grew when unpacked, and never go below what the
+     previous version of this game took up.
+   */
+  int64_t expectedSize(int64_t total)
+  {
+    int64_t size = total * conf->getInt64("unpack_ratio_pct", 200) / 100;
+    if(size < oldSize) size = oldSize;
+    return Misc::allocSize(size, Misc::getBlockSize(where));
+  }
+
+  // Learn the unpack ratio from a finished install
+  void recordRatio(int64_t size)
+  {
+    int64_t total = client->getTotal();
+    if(total <= 0) return;
+
+    int64_t pct = (conf->getInt64("unpack_ratio_pct", 200) + size*100/total) / 2;
+    if(pct < 100) pct = 100;
+    if(pct > 1000) pct = 1000;
+    conf->setInt64("unpack_ratio_pct", pct);
+  }
 
   void doJob()
   {
-    if(waitClient(client)) return;
+    TRACE_SCOPE2("InstallJob", idname);
+    int64_t start = Misc::Metrics::now();
+
+    seedFromCache();
+    {
+      SpreadLock lock;
+      client = spread->install("tiggit.net", idname, where);
+    }
+
+    /* Reserve disk space for the install as soon as Spread knows how
+       much it is going to fetch. This is shared with imports and
+       other installs, so parallel jobs don't all count on the same
+       free space. What we reserve is the estimated size after
+       unpacking, not the download size.
+     */
+    Misc::SpaceReservation space;
+    bool noSpace = false;
+    while(!client->isFinished())
+      {
+        if(info->checkForAbort())
+          {
+            client->abort();
+            break;
+          }
+
+        int64_t total = client->getTotal();
+        if(total > 0 && !space.isActive() &&
+           !space.reserve(where, expectedSize(total)))
+          {
+            client->abort();
+            noSpace = true;
+            break;
+          }
+
+        space.setProgress(client->getCurrent(), total);
+        setProgress(client->getCurrent(), total);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+      }
+
+    /* Spread may still be reading the staged files, or writing into
+       'where', after an abort. So only clean up once the client has
+       fully stopped.
+     */
+    bool failed = waitClient(client);
+    boost::system::error_code ec;
+    bf::remove_all(staging, ec);
+    if(noSpace)
+      {
+        setError("Not enough free disk space to install into " + where);
+        return;
+      }
+    if(failed) return;
+    bf::remove(cachedManifest, ec);
+
+    // Record install time and download speed
+    int64_t time = Misc::Metrics::now() - start;
+    Misc::Metrics::sample("install.time_us", time);
+    Misc::Metrics::throughput("install.bytes_per_sec", client->getTotal(), time);
+    if(time > 0)
+      Misc::Metrics::gauge("install.bytes_per_sec." + idname,
+                           client->getTotal() * 1000000 / time);
+    Misc::Metrics::count("install.bytes", client->getTotal());
+
+    /* Record what we installed, for verifyGame(), and the space it
+       takes up. Not fatal if it fails, the game can still be verified
+       later, and refreshSizes() will pick up the size.
+     */
+    try
+      {
+        Misc::Verify::Manifest man;
+        if(Misc::Verify::build(where, man))
+          {
+            Misc::Verify::save(manifest, man);
+
+            int64_t block = Misc::getBlockSize(where), size = 0;
+            Misc::Verify::Manifest::iterator it;
+            for(it = man.begin(); it != man.end(); it++)
+              size += Misc::allocSize(it->second.size, block);
+            sizes->setInt64(idname, size);
+            recordRatio(size);
+          }
+        Misc::HashCache::save();
+      }
+    catch(...) {}
 
     // Set config status
-    inst->set(idname, where);
+    inst->setInstalled(idname, where);
+
+    /* Record the version Spread just installed. This is looked up
+       now rather than when the job was created, since the channel
+       index may have been updated while the job was queued.
+     */
+    std::string version;
+    try
+      {
+        SpreadLock lock;
+        version = spread->getPackVersion("tiggit.net", idname);
+      }
+    catch(...) {}
+    if(version != "")
+      versions->set(idname, version);
 
     // Notify the server that the game was downloaded
     Fetch::fetchString(sendOnDone, true);
@@ -326,21 +595,223 @@ struct InstallJob : Job
   }
 };
 
-// Start installing or upgrading a game
-JobInfoPtr Repo::startInstall(const std::string &idname, const std::string &urlname,
-                              std::string where, bool async)
+Job *Repo::makeInstallJob(const std::string &idname, const std::string &urlname,
+                          std::string where)
 {
-  // Ignore offline mode for game installs, since they are user
-  // initiated events.
+  assert(!isReadOnly());
   where = bf::absolute(where).string();
-  JobInfoPtr client = ptr->spread.install("tiggit.net", idname, where);
+
+  // Updates may change which files the game reads at startup
+  boost::system::error_code ec;
+  bf::remove(getPrewarmProfile(idname), ec);
+
   InstallJob *job = new InstallJob;
-  job->client = client;
+  job->spread = &ptr->spread;
+  job->cache = &ptr->cache;
+  job->cachedManifest = getCachedManifest(idname);
+  job->staging = getPath("cache/staging/" + idname);
   job->sendOnDone = ServerAPI::dlCountURL(urlname);
   job->where = where;
   job->idname = idname;
+  job->manifest = getManifest(idname);
   job->inst = &inst;
-  return Thread::run(job,async);
+  job->conf = &conf;
+  job->sizes = &sizes;
+  job->versions = &versions;
+  job->oldSize = sizes.getInt64(idname, -1);
+
+  return job;
+}
+
+// Start installing or upgrading a game
+JobInfoPtr Repo::startInstall(const std::string &idname, const std::string &urlname,
+                              std::string where, bool async)
+{
+  // Ignore offline mode for game installs, since they are user
+  // initiated events.
+  return Thread::run(makeInstallJob(idname, urlname, where), async);
+}
+
+std::vector<UpdateInfo> Repo::checkUpdates(std::vector<std::string> *unknown)
+{
+  Misc::Metrics::Timer tm("repo.check_updates_us");
+  std::vector<UpdateInfo> res;
+
+  const InfoLookup &list = getList();
+  std::vector<std::string> games = getInstalledGames();
+  for(int i=0; i<games.size(); i++)
+    {
+      const std::string &id = games[i];
+
+      // Games no longer in the channel can't be updated
+      InfoLookup::const_iterator it = list.find(id);
+      if(it == list.end()) continue;
+
+      std::string avail;
+      try
+        {
+          // Updates may be running, and using Spread from their threads
+          SpreadLock lock;
+          avail = ptr->spread.getPackVersion("tiggit.net", id);
+        }
+      catch(...) {}
+      if(avail == "") continue;
+
+      std::string have = versions.get(id);
+      if(have == "")
+        {
+          if(unknown) unknown->push_back(id);
+          continue;
+        }
+      if(have == avail) continue;
+
+      UpdateInfo u;
+      u.idname = id;
+      u.urlname = it->second->ent->urlname;
+      u.installed = have;
+      u.available = avail;
+      u.size = getGameSize(id);
+      res.push_back(u);
+    }
+
+  Misc::Metrics::gauge("repo.updates_available", res.size());
+  return res;
+}
+
+static bool smallerFirst(const UpdateInfo *a, const UpdateInfo *b)
+{ return a->size < b->size; }
+
+struct UpdateAllJob : Job
+{
+  // Set up in the calling thread, started from here
+  std::vector<UpdateInfo*> games;
+  std::vector<Job*> jobs;
+  int parallel;
+
+  ~UpdateAllJob()
+  {
+    // Jobs that were never started
+    for(int i=0; i<jobs.size(); i++)
+      delete jobs[i];
+  }
+
+  void doJob()
+  {
+    TRACE_SCOPE("UpdateAllJob");
+    setBusy("Updating games");
+
+    std::vector<JobInfoPtr> running(games.size());
+    int next = 0, active = 0, finished = 0, failed = 0;
+    std::string firstError;
+    bool aborting = false;
+
+    while(true)
+      {
+        /* On abort, stop starting new updates, and abort the running
+           ones. Keep going until they have all stopped, so none is
+           left writing to its game after we return.
+         */
+        if(!aborting && info->checkForAbort())
+          {
+            aborting = true;
+            for(int i=0; i<next; i++)
+              if(running[i] && !running[i]->isFinished())
+                running[i]->abort();
+          }
+
+        while(!aborting && active < parallel && next < games.size())
+          {
+            running[next] = Thread::run(jobs[next], true);
+            jobs[next] = NULL;
+            next++;
+            active++;
+          }
+
+        int64_t cur = 0, total = 0;
+        for(int i=0; i<next; i++)
+          {
+            JobInfoPtr job = running[i];
+            UpdateInfo *u = games[i];
+            if(u->done) continue;
+
+            if(!job->isFinished())
+              {
+                cur += job->getCurrent();
+                total += job->getTotal();
+                continue;
+              }
+
+            u->done = true;
+            active--;
+            finished++;
+            if(!job->isSuccess())
+              {
+                u->error = job->isAbort() ? "Aborted" : job->getMessage();
+                if(!failed++) firstError = u->idname + ": " + u->error;
+              }
+          }
+
+        if(finished == next && (aborting || next == games.size()))
+          break;
+
+        // Finished games count as fully done
+        setProgress(finished*1000 + (total ? cur*1000/total : 0),
+                    games.size()*1000);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      }
+
+    if(checkStatus()) return;
+    if(failed)
+      {
+        std::ostringstream msg;
+        msg << failed << " of " << games.size() << " updates failed. "
+            << firstError;
+        setError(msg.str());
+        return;
+      }
+    setDone();
+  }
+};
+
+JobInfoPtr Repo::updateGames(std::vector<UpdateInfo> *list, int parallel,
+                             bool async)
+{
+  assert(list);
+  assert(parallel > 0);
+  UpdateAllJob *job = new UpdateAllJob;
+  job->parallel = parallel;
+
+  for(int i=0; i<list->size(); i++)
+    {
+      UpdateInfo &u = (*list)[i];
+      u.done = false;
+      u.error = "";
+      job->games.push_back(&u);
+    }
+  std::stable_sort(job->games.begin(), job->games.end(), smallerFirst);
+
+  // Jobs are created here rather than in the job thread, since they
+  // read from the repo
+  for(int i=0; i<job->games.size(); i++)
+    {
+      const UpdateInfo *u = job->games[i];
+      job->jobs.push_back(makeInstallJob(u->idname, u->urlname,
+                                         getGameDir(u->idname)));
+    }
+
+  // The games count as busy until the whole batch is done
+  std::vector<LiveInfo*> lives;
+  const InfoLookup &lst = getList();
+  for(int i=0; i<job->games.size(); i++)
+    {
+      InfoLookup::const_iterator it = lst.find(job->games[i]->idname);
+      if(it != lst.end()) lives.push_back(it->second);
+    }
+
+  JobInfoPtr res = Thread::run(job, async);
+  for(int i=0; i<lives.size(); i++)
+    lives[i]->setOtherJob(res);
+  return res;
 }
 
 struct RemoveJob : Job
@@ -351,8 +822,9 @@ struct RemoveJob : Job
 
   void doJob()
   {
+    TRACE_SCOPE2("RemoveJob", what);
     setBusy("Removing " + what);
-    bf::remove_all(what);
+    Misc::Trash::removeTree(what);
     setDone();
   }
 };
@@ -363,15 +835,604 @@ JobInfoPtr Repo::killPath(const std::string &dir, bool async)
   return Thread::run(new RemoveJob(dir), async);
 }
 
+struct DedupJob : Job
+{
+  std::vector<std::string> dirs;
+  Misc::Dedup::Mode mode;
+  Misc::Dedup::Report *report;
+  JournalConf *conf;
+
+  bool progress(int64_t cur, int64_t tot)
+  {
+    setProgress(cur, tot);
+    return !info->checkForAbort();
+  }
+
+  void doJob()
+  {
+    TRACE_SCOPE("DedupJob");
+    setBusy("Finding duplicate files");
+
+    bool ok = Misc::Dedup::run(dirs, mode, *report,
+                               boost::bind(&DedupJob::progress, this, _1, _2));
+    Misc::HashCache::save();
+
+    // Linking may have happened even if we were aborted
+    if(report->savedBytes)
+      conf->setInt64("dedup_saved", conf->getInt64("dedup_saved") +
+                     report->savedBytes);
+
+    if(!ok || checkStatus()) return;
+    setDone();
+  }
+};
+
+JobInfoPtr Repo::dedupGames(Misc::Dedup::Report *report, bool async)
+{
+  assert(report);
+  DedupJob *job = new DedupJob;
+  job->report = report;
+  job->conf = &conf;
+  job->mode = Misc::Dedup::REFLINK;
+
+  // Leave games alone while other jobs are changing or reading them
+  const InfoLookup &lst = getList();
+  std::vector<std::string> games = getInstalledGames();
+  for(int i=0; i<games.size(); i++)
+    {
+      InfoLookup::const_iterator it = lst.find(games[i]);
+      if(it != lst.end() && it->second->isBusy())
+        continue;
+      job->dirs.push_back(getGameDir(games[i]));
+    }
+
+  return Thread::run(job, async);
+}
+
+struct VerifyJob : Job
+{
+  std::string idname, where, manifest;
+  SpreadLib *spread;
+  FileCache *cache;
+  bool repair, readOnly;
+  Misc::Verify::Report *report;
+
+  bool progress(int64_t cur, int64_t tot)
+  {
+    setProgress(cur, tot);
+    return !info->checkForAbort();
+  }
+
+  void doJob()
+  {
+    TRACE_SCOPE2("VerifyJob", idname);
+    Misc::Verify::ProgressFunc prog = boost::bind(&VerifyJob::progress, this, _1, _2);
+
+    /* Games installed before manifests were introduced don't have
+       one. There is nothing to compare against, so record the current
+       state as the reference instead.
+     */
+    Misc::Verify::Manifest man;
+    if(!Misc::Verify::load(manifest, man))
+      {
+        setBusy("Recording installed files");
+        if(!Misc::Verify::build(where, man, prog) || checkStatus()) return;
+        if(!readOnly) Misc::Verify::save(manifest, man);
+        Misc::HashCache::save();
+        report->files = man.size();
+        report->baseline = true;
+        setDone();
+        return;
+      }
+
+    setBusy("Verifying installed files");
+    bool ok = Misc::Verify::check(where, man, *report, prog);
+    Misc::HashCache::save();
+    if(!ok || checkStatus())
+      return;
+
+    if(report->isOk() || !repair)
+      {
+        setDone();
+        return;
+      }
+
+    /* Move the damaged files out of the way and let Spread reinstall
+       the package on top of what's left. Only missing files are
+       fetched, and they are taken from the local cache where
+       possible.
+
+       The manifest may include files the game itself wrote (such as
+       settings) if the game was updated after running. Spread won't
+       restore those, so put them back afterwards rather than losing
+       them.
+     */
+    setBusy("Repairing installed files");
+    std::vector<std::string> &changed = report->changed;
+    for(int i=0; i<changed.size(); i++)
+      {
+        bf::path file = bf::path(where)/changed[i];
+        boost::system::error_code ec;
+        bf::rename(file, file.string() + ".damaged", ec);
+      }
+
+    // Take what we can from the file cache first
+    int left = 0;
+    for(int i=0; i<changed.size(); i++)
+      {
+        const Misc::Verify::FileSum &s = man[changed[i]];
+        if(!cache->restore(s.hash, s.size, (bf::path(where)/changed[i]).string()))
+          left++;
+      }
+    for(int i=0; i<report->missing.size(); i++)
+      {
+        const Misc::Verify::FileSum &s = man[report->missing[i]];
+        if(!cache->restore(s.hash, s.size, (bf::path(where)/report->missing[i]).string()))
+          left++;
+      }
+    cache->save();
+
+    bool failed = false;
+    if(left)
+      {
+        JobInfoPtr client;
+        {
+          SpreadLock lock;
+          client = spread->install("tiggit.net", idname, where);
+        }
+        failed = waitClient(client);
+      }
+
+    for(int i=0; i<changed.size(); i++)
+      {
+        bf::path file = bf::path(where)/changed[i];
+        bf::path old = file.string() + ".damaged";
+        boost::system::error_code ec;
+        if(bf::exists(file)) bf::remove(old, ec);
+        else bf::rename(old, file, ec);
+      }
+    if(failed) return;
+
+    /* See what's still wrong. Everything else was just checked, so
+       only the files that were put back need reading.
+     */
+    int64_t bad = report->changed.size() + report->missing.size();
+    Misc::Verify::Report after;
+    ok = Misc::Verify::check(where, man, after, prog, 0, true);
+    Misc::HashCache::save();
+    if(!ok || checkStatus()) return;
+    report->changed = after.changed;
+    report->missing = after.missing;
+    report->repaired = bad - after.changed.size() - after.missing.size();
+
+    setDone();
+  }
+};
+
+JobInfoPtr Repo::verifyGame(const std::string &idname, bool repair,
+                            Misc::Verify::Report *report, bool async)
+{
+  assert(report);
+  assert(!repair || !isReadOnly());
+  std::string dir = getGameDir(idname);
+  if(dir == "") return JobInfoPtr();
+
+  VerifyJob *job = new VerifyJob;
+  job->idname = idname;
+  job->where = dir;
+  job->manifest = getManifest(idname);
+  job->spread = &ptr->spread;
+  job->cache = &ptr->cache;
+  job->repair = repair;
+  job->readOnly = isReadOnly();
+  job->report = report;
+  return Thread::run(job, async);
+}
+
+// Seconds a game gets to start up before we check what it read
+#define LEARN_DELAY 30
+
+// Most a cold launch waits for the access time snapshot, in ms
+#define SNAPSHOT_WAIT 250
+
+// 'before' is time spent before the launch itself, in microseconds
+static void recordReady(const char *name, int64_t before, int64_t usecs)
+{
+  if(usecs >= 0)
+    Misc::Metrics::sample(name, before + usecs);
+}
+
+static void warmGame(std::string dir, Misc::Prewarm::Profile prof,
+                     int64_t budget)
+{
+  TRACE_SCOPE2("Prewarm", dir);
+  Misc::Prewarm::warm(dir, prof, budget);
+}
+
+// Shared between launchGame() and its learner thread
+struct LearnState
+{
+  std::string dir, launch, file;
+
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  bool ready;
+
+  LearnState(const std::string &d, const std::string &l, const std::string &f)
+    : dir(d), launch(l), file(f), ready(false) {}
+};
+
+static void learnGame(boost::shared_ptr<LearnState> st)
+{
+  Misc::Prewarm::Snapshot snap;
+  Misc::Prewarm::snapshot(st->dir, snap);
+  {
+    boost::lock_guard<boost::mutex> lock(st->mutex);
+    st->ready = true;
+  }
+  st->cond.notify_all();
+
+  boost::this_thread::sleep(boost::posix_time::seconds(LEARN_DELAY));
+
+  Misc::Prewarm::Profile prof;
+  if(!Misc::Prewarm::learn(st->dir, snap, prof))
+    Misc::Prewarm::guess(st->dir, st->launch, prof);
+  Misc::Prewarm::save(st->file, prof);
+}
+
+void Repo::launchGame(const std::string &idname, const std::string &launch)
+{
+  std::string dir = getGameDir(idname);
+  assert(dir != "");
+
+  // Use executable location as working directory
+  bf::path exe = bf::path(dir) / launch;
+  std::string work = exe.parent_path().string();
+
+  if(!conf.getBool("prewarm", true))
+    {
+      Launcher::run(exe.string(), work,
+                    boost::bind(&recordReady, "launch.cold_ready_us", 0, _1));
+      return;
+    }
+
+  /* If we know what the game reads, start reading it in the
+     background and launch right away. The game then mostly finds its
+     files already cached, instead of waiting for the disk.
+   */
+  Misc::Prewarm::Profile prof;
+  std::string file = getPrewarmProfile(idname);
+  if(Misc::Prewarm::load(file, prof))
+    {
+      int64_t budget = conf.getInt64("prewarm_budget", 256*1024*1024);
+      boost::thread(boost::bind(&warmGame, dir, prof, budget)).detach();
+      Launcher::run(exe.string(), work,
+                    boost::bind(&recordReady, "launch.prewarmed_ready_us", 0, _1));
+      return;
+    }
+
+  /* Otherwise launch cold, and learn a profile for next time. That
+     needs a snapshot of access times from before the game starts
+     reading. Walking a big game on a cold disk can take a while, so
+     the learner thread takes it, and we only wait up to SNAPSHOT_WAIT
+     for it. If the walk is slower, files the game reads before the
+     walk reaches them are left out of the profile.
+   */
+  int64_t start = Misc::Metrics::now();
+  if(!isReadOnly())
+    {
+      boost::shared_ptr<LearnState> st(new LearnState(dir, launch, file));
+      boost::thread(boost::bind(&learnGame, st)).detach();
+
+      boost::unique_lock<boost::mutex> lock(st->mutex);
+      boost::system_time until = boost::get_system_time() +
+        boost::posix_time::milliseconds(SNAPSHOT_WAIT);
+      while(!st->ready && st->cond.timed_wait(lock, until)) {}
+    }
+
+  // Count the wait, so cold and prewarmed launches compare fairly
+  Launcher::run(exe.string(), work,
+                boost::bind(&recordReady, "launch.cold_ready_us",
+                            Misc::Metrics::now() - start, _1));
+}
+
+// Space taken up on disk by all files in a directory
+static int64_t dirSize(const std::string &dir)
+{
+  std::vector<Misc::FileCopy::FileInfo> files;
+  Misc::FileCopy::index(dir, files);
+
+  int64_t block = Misc::getBlockSize(dir), size = 0;
+  for(int i=0; i<files.size(); i++)
+    size += Misc::allocSize(files[i].size, block);
+  return size;
+}
+
+// Seconds between rescans of games that DirWatch can't watch
+#define UNWATCHED_RESCAN 600
+
+struct SizeJob : Job
+{
+  // Installed games and their directories
+  std::vector<std::string> games, dirs;
+  Misc::DirWatch *watch;
+  JournalConf *sizes;
+  bool full, unwatched;
+
+  void doJob()
+  {
+    TRACE_SCOPE("SizeJob");
+    setBusy("Updating game sizes");
+
+    std::set<std::string> changed;
+    watch->getChanged(changed);
+
+    for(int i=0; i<games.size(); i++)
+      {
+        if(checkStatus()) return;
+        const std::string &id = games[i];
+
+        bool rescan = full || changed.count(id) ||
+          sizes->getInt64(id, -1) < 0;
+
+        /* Start watching games we haven't seen yet. Changes made
+           before that (eg. while we weren't running) are never
+           reported, so look at the game once now. Games that can't be
+           watched are rescanned every so often instead.
+         */
+        if(!watch->isWatched(id))
+          {
+            if(watch->add(id, dirs[i]) || unwatched)
+              rescan = true;
+          }
+
+        if(!rescan) continue;
+
+        try { sizes->setInt64(id, dirSize(dirs[i])); }
+        catch(...) {}
+      }
+
+    setDone();
+  }
+};
+
+JobInfoPtr Repo::refreshSizes(bool full, bool async)
+{
+  SizeJob *job = new SizeJob;
+  job->watch = &ptr->watch;
+  job->sizes = &sizes;
+  job->full = full;
+
+  time_t now = std::time(NULL);
+  job->unwatched = difftime(now, ptr->lastUnwatched) >= UNWATCHED_RESCAN;
+  if(job->unwatched) ptr->lastUnwatched = now;
+
+  std::vector<std::string> games = getInstalledGames();
+  for(int i=0; i<games.size(); i++)
+    {
+      job->games.push_back(games[i]);
+      job->dirs.push_back(getGameDir(games[i]));
+    }
+
+  return Thread::run(job, async);
+}
+
+int64_t Repo::getTotalSize()
+{
+  int64_t total = 0;
+  std::vector<std::string> games = getInstalledGames();
+  for(int i=0; i<games.size(); i++)
+    total += getGameSize(games[i]);
+  return total;
+}
+
+struct CacheJob : Job
+{
+  FileCache *cache;
+  boost::mutex *serial;
+  int64_t budget;
+
+  // Manifests of the installed games, whose files must be kept
+  std::vector<std::string> pinned;
+
+  /* Optionally, a directory to move into the cache first. It is
+     deleted afterwards.
+   */
+  std::string storeDir, storeManifest;
+
+  /* Paths to delete at the end. These are listed when the job is
+     created, so that games moved into cache/incoming after that are
+     left alone.
+   */
+  std::vector<std::string> leftovers;
+
+  bool store()
+  {
+    Misc::Verify::Manifest man;
+    try { Misc::Verify::load(storeManifest, man); }
+    catch(...) { return true; }
+
+    setBusy("Moving files into the cache");
+    Misc::Verify::Manifest::iterator it;
+    for(it = man.begin(); it != man.end(); it++)
+      {
+        if(info->checkForAbort()) return false;
+
+        // Only keep files that are unchanged, as far as we can
+        // tell. restore() checks the hash properly later.
+        bf::path file = bf::path(storeDir)/it->first;
+        boost::system::error_code ec;
+        if((int64_t)bf::file_size(file, ec) != it->second.size || ec)
+          continue;
+
+        cache->store(file.string(), it->second.hash, it->second.size, true);
+      }
+    return true;
+  }
+
+  void doJob()
+  {
+    TRACE_SCOPE("CacheJob");
+    boost::lock_guard<boost::mutex> lock(*serial);
+
+    /* If aborted, whatever is left of storeDir stays in
+       cache/incoming until the next startup.
+     */
+    if(storeDir != "")
+      {
+        if(!store() || checkStatus()) return;
+        try { Misc::Trash::removeTree(storeDir); }
+        catch(...) {}
+      }
+    if(checkStatus()) return;
+
+    setBusy("Cleaning up the cache");
+    std::set<std::string> keys;
+    for(int i=0; i<pinned.size(); i++)
+      {
+        Misc::Verify::Manifest man;
+        try { Misc::Verify::load(pinned[i], man); }
+        catch(...) {}
+
+        Misc::Verify::Manifest::iterator it;
+        for(it = man.begin(); it != man.end(); it++)
+          keys.insert(FileCache::makeKey(it->second.hash, it->second.size));
+      }
+
+    int64_t freed = cache->gc(budget, keys);
+    Misc::Metrics::count("cache.evicted_bytes", freed);
+
+    if(!leftovers.empty())
+      setBusy("Removing leftovers");
+    for(int i=0; i<leftovers.size(); i++)
+      {
+        if(checkStatus()) return;
+        try { Misc::Trash::removeTree(leftovers[i]); }
+        catch(...) {}
+      }
+
+    setDone();
+  }
+};
+
+std::vector<std::string> Repo::getManifests()
+{
+  std::vector<std::string> res;
+  std::vector<std::string> games = getInstalledGames();
+  for(int i=0; i<games.size(); i++)
+    res.push_back(getManifest(games[i]));
+  return res;
+}
+
+JobInfoPtr Repo::cacheGC(bool async)
+{
+  CacheJob *job = new CacheJob;
+  job->cache = &ptr->cache;
+  job->serial = &ptr->cacheJobMutex;
+  job->budget = getCacheBudget();
+  job->pinned = getManifests();
+
+  // Anything already here was interrupted on its way into the cache
+  boost::system::error_code ec;
+  bf::directory_iterator it(getPath("cache/incoming"), ec), end;
+  for(; !ec && it != end; it.increment(ec))
+    job->leftovers.push_back(it->path().string());
+
+  return ptr->runCacheJob(job, async);
+}
+
+FileCache::Stats Repo::getCacheStats() const
+{
+  assert(ptr);
+  return ptr->cache.getStats();
+}
+
+struct EmptyTrashJob : Job
+{
+  std::string dir;
+
+  void doJob()
+  {
+    TRACE_SCOPE("EmptyTrashJob");
+    setBusy("Emptying trash");
+    Misc::Trash::empty(dir);
+    setDone();
+  }
+};
+
+JobInfoPtr Repo::emptyTrash(bool async)
+{
+  EmptyTrashJob *job = new EmptyTrashJob;
+  job->dir = getPath("trash");
+  return Thread::run(job, async);
+}
+
 // Start uninstalling a game
 JobInfoPtr Repo::startUninstall(const std::string &idname, bool async)
 {
+  assert(!isReadOnly());
   // Get the game's install dir
   std::string dir = getGameDir(idname);
   if(dir == "") return JobInfoPtr();
 
   // Mark the game as uninstalled immediately
-  inst.set(idname, "");
+  inst.setUninstalled(idname);
+
+  sizes.setInt64(idname, -1);
+  versions.set(idname, "");
+  ptr->watch.remove(idname);
+  Misc::HashCache::forget(dir);
+
+  /* Keep the manifest with the cache, so a later reinstall knows
+     which cached files it can use.
+   */
+  std::string manifest = getManifest(idname);
+  std::string cached = getCachedManifest(idname);
+  boost::system::error_code ec;
+  bf::remove(cached, ec);
+  if(getCacheBudget() > 0 && bf::exists(manifest))
+    {
+      bf::create_directories(bf::path(cached).parent_path(), ec);
+      bf::rename(manifest, cached, ec);
+    }
+  bf::remove(manifest, ec);
+  bf::remove(getPrewarmProfile(idname), ec);
+
+  /* Move the installation into the trash. This is instant, and the
+     actual deleting happens in the background. Only works within the
+     same filesystem, so games installed elsewhere are deleted
+     directly instead.
+
+     If the cache is in use, the game is moved to a separate
+     directory instead, and its files are moved into the cache before
+     the rest is deleted.
+   */
+  std::string trashed;
+  if(getCacheBudget() > 0 && bf::exists(cached) &&
+     Misc::Trash::moveTo(getPath("cache/incoming"), dir, &trashed))
+    {
+      CacheJob *job = new CacheJob;
+      job->cache = &ptr->cache;
+      job->serial = &ptr->cacheJobMutex;
+      job->budget = getCacheBudget();
+      job->pinned = getManifests();
+      job->storeDir = trashed;
+      job->storeManifest = cached;
+      ptr->runCacheJob(job, true);
+
+      JobInfoPtr info(new JobInfo);
+      info->setDone();
+      return info;
+    }
+
+  if(Misc::Trash::moveTo(getPath("trash"), dir))
+    {
+      emptyTrash();
+
+      JobInfoPtr info(new JobInfo);
+      info->setDone();
+      return info;
+    }
 
   // Kill the installation directory
   return killPath(dir, async);
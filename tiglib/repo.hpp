@@ -3,15 +3,39 @@
 
 #include <stdint.h>
 #include <spread/job/jobinfo.hpp>
-#include <spread/misc/jconfig.hpp>
 #include <boost/shared_ptr.hpp>
 #include "list/mainlist.hpp"
+#include "misc/dedup.hpp"
+#include "misc/verify.hpp"
 #include "gamedata.hpp"
+#include "filecache.hpp"
+#include "journalconf.hpp"
+#include "install_registry.hpp"
 
-namespace Spread { struct SpreadLib; }
+namespace Spread { struct SpreadLib; struct Job; }
 
 namespace TigLib
 {
+  // An installed game with a newer version available, see
+  // Repo::checkUpdates()
+  struct UpdateInfo
+  {
+    std::string idname, urlname;
+
+    // Installed and available package versions
+    std::string installed, available;
+
+    // Installed size, used to order the updates
+    int64_t size;
+
+    // Set by Repo::updateGames() when the update has finished. Empty
+    // on success.
+    std::string error;
+    bool done;
+
+    UpdateInfo() : size(0), done(false) {}
+  };
+
   class Repo
   {
     struct _Internal;
@@ -19,11 +43,23 @@ namespace TigLib
 
     std::string dir;
     std::string tigFile, statsFile, newsFile, shotDir, spreadDir;
-    Misc::JConfig conf, inst;
+    JournalConf conf, sizes, versions;
+    InstallRegistry inst;
     int64_t lastTime;
 
     void setDirs();
 
+    // Manifest files of all installed games
+    std::vector<std::string> getManifests();
+
+    // Open the config files, after locking
+    void loadConfig(bool readOnly);
+
+    // Set up an install job, without starting it
+    Spread::Job *makeInstallJob(const std::string &idname,
+                                const std::string &urlname,
+                                std::string where);
+
   public:
     Repo(bool runOffline=false)
       : offline(runOffline) {}
@@ -33,12 +69,21 @@ namespace TigLib
     // connect to the net if this is set.
     bool offline;
 
-    Misc::JConfig news, rates;
+    JournalConf news, rates;
 
     // Check if the repository is locked. If not, we are not allowed
     // to write to it.
     bool isLocked() const;
 
+    // True if we only hold a shared lock, see initRepoReadOnly()
+    bool isReadOnly() const;
+
+    /* Process ID of whoever holds the repository for writing, or 0 if
+       nobody does. Processes that crashed don't count, and their locks
+       are released by the OS anyway.
+     */
+    int getLockOwner() const;
+
     /* Find or establish a repository in the given location. An empty
        path means we should use the standard path for this OS.
 
@@ -105,6 +150,19 @@ namespace TigLib
      */
     bool initRepo(bool forceLock=false);
 
+    /* Open the repository for reading only, eg. for searching or
+       verifying. Any number of processes may do this at once, but
+       not while someone has it open with initRepo(). Returns false if
+       they do, or if the repository directory doesn't exist.
+
+       Nothing is written to the repository in this mode, except for
+       the lock file. Settings changed in memory are not saved. Only
+       use functions that don't change the repository: loadData(),
+       getList(), checkUpdates(), verifyGame() without repair, and so
+       on.
+     */
+    bool initRepoReadOnly();
+
     /* Update all disk files from the net. May in some cases return a
        JobInfo pointer. If it does, then it is not safe to proceed
        (calling loadData) until the job has finished. Preferably you
@@ -163,11 +221,16 @@ namespace TigLib
 
     // Returns idnames of all games that are or have been installed.
     // Use getGameDir() to check actual install status of the game.
-    std::vector<std::string> getGameList() { return inst.getNames(); }
+    std::vector<std::string> getGameList() const { return inst.getAll(); }
+
+    // Returns idnames of all currently installed games
+    std::vector<std::string> getInstalledGames() const
+    { return inst.getInstalled(); }
 
     // Get actuall install dir for a game. Returns "" if the game is
-    // not registered as installed.
-    std::string getGameDir(const std::string &idname);
+    // not registered as installed. Does not touch the disk.
+    std::string getGameDir(const std::string &idname) const
+    { return inst.getDir(idname); }
 
     // Get default install dir for a game
     std::string getDefGameDir(const std::string &idname) const
@@ -184,11 +247,154 @@ namespace TigLib
 
     // Start uninstalling a game
     Spread::JobInfoPtr startUninstall(const std::string &idname, bool async=true);
+
+    /* Find installed games that have a newer version in the channel
+       index. This is a single pass over the local index and the
+       recorded install versions, without touching the net, so call
+       fetchFiles() first to check against the latest data.
+
+       Games installed before versions were recorded can't be
+       compared. They are added to 'unknown', if given. Updating such
+       a game records its version.
+     */
+    std::vector<UpdateInfo> checkUpdates(std::vector<std::string> *unknown=NULL);
+
+    /* Update the given games (eg. from checkUpdates), running at most
+       'parallel' installs at once. Parallel downloads share the same
+       connection, so running many at once only delays all of them.
+       Instead, the smallest games go first, so most games are updated
+       early and a slow large download doesn't hold up the rest.
+
+       Each entry's 'done' and 'error' fields are set as its update
+       finishes, so 'list' must stay alive until the job is done. One
+       failed update doesn't stop the others. The job fails if any of
+       them failed.
+     */
+    Spread::JobInfoPtr updateGames(std::vector<UpdateInfo> *list,
+                                   int parallel=2, bool async=true);
+
+    // Version of an installed game, or "" if not known
+    std::string getGameVersion(const std::string &idname) const
+    { return versions.get(idname); }
    
-    // Remove any path, using boost::filesystem::remove_all(), in a
+    /* Find identical files across all installed games, and make them
+       share disk space with reflinks (see misc/dedup.hpp.) Only works
+       on filesystems with reflink support. Games with a running
+       install, update or verify job (see LiveInfo::isBusy()) are
+       skipped.
+
+       Results are written to 'report', which must stay alive until
+       the job is done. Bytes reclaimed are also added to a running
+       total, see getDedupSaved().
+     */
+    Spread::JobInfoPtr dedupGames(Misc::Dedup::Report *report,
+                                  bool async=true);
+
+    // Total bytes reclaimed by dedupGames() in this repository
+    int64_t getDedupSaved() const { return conf.getInt64("dedup_saved"); }
+
+    /* Check an installed game against the manifest recorded when it
+       was installed (see misc/verify.hpp.) Files are hashed in
+       parallel, and the hashing speed is available in the report.
+
+       If 'repair' is set, damaged and missing files are restored by
+       reinstalling them through Spread. The report then lists only
+       the files that are still broken afterwards.
+
+       Games installed before manifests were recorded get one made
+       from their current files, and are reported as ok.
+
+       Returns an empty pointer if the game is not installed.
+     */
+    Spread::JobInfoPtr verifyGame(const std::string &idname, bool repair,
+                                  Misc::Verify::Report *report,
+                                  bool async=true);
+
+    /* Disk space used by an installed game, in bytes. Returns 0 if
+       not known yet. Sizes are recorded by install jobs and kept up to
+       date by refreshSizes().
+     */
+    int64_t getGameSize(const std::string &idname) const
+    {
+      int64_t res = sizes.getInt64(idname, -1);
+      return res > 0 ? res : 0;
+    }
+
+    // Sum of getGameSize() over all installed games
+    int64_t getTotalSize();
+
+    /* Bring the stored game sizes up to date. Only games that have
+       changed on disk since the last refresh (as reported by
+       Misc::DirWatch), that have no size recorded, or that are seen
+       for the first time since startup, are rescanned, unless 'full'
+       is set. Games DirWatch can't watch (always the case outside
+       Linux) are rescanned every ten minutes. Meant to be called
+       regularly from the main loop.
+     */
+    Spread::JobInfoPtr refreshSizes(bool full=false, bool async=true);
+
+    // Manifest file used by verifyGame()
+    std::string getManifest(const std::string &idname) const
+    { return getPath("manifests/" + idname + ".conf"); }
+
+    /* Start an installed game. 'launch' is the executable, relative
+       to the game directory. Throws on error.
+
+       Unless "prewarm" is set to false in tiglib.conf, the files the
+       game read during an earlier launch are read into the OS file
+       cache first (see misc/prewarm.hpp), up to "prewarm_budget"
+       bytes. The first launch learns which files those are.
+
+       Where the OS can tell us, the time until the game is ready for
+       input is recorded in the metrics, as launch.prewarmed_ready_us
+       or launch.cold_ready_us.
+     */
+    void launchGame(const std::string &idname, const std::string &launch);
+
+    // Access profile used by launchGame()
+    std::string getPrewarmProfile(const std::string &idname) const
+    { return getPath("profiles/" + idname + ".txt"); }
+
+    /* Files of uninstalled games are kept in a file cache (see
+       filecache.hpp) so that reinstalling or repairing a game can
+       reuse them. The cache is limited to "cache_budget" bytes in
+       tiglib.conf. It is off (zero) by default, so that uninstalling
+       a game frees its disk space.
+     */
+    int64_t getCacheBudget() const
+    { return conf.getInt64("cache_budget", 0); }
+    void setCacheBudget(int64_t bytes) { conf.setInt64("cache_budget", bytes); }
+
+    // Manifest of an uninstalled game's files in the cache
+    std::string getCachedManifest(const std::string &idname) const
+    { return getPath("cache/manifests/" + idname + ".conf"); }
+
+    /* Shrink the cache to within its budget, evicting the least
+       recently used files first. Files used by installed games are
+       never evicted. Run automatically at startup and after each
+       uninstall.
+     */
+    Spread::JobInfoPtr cacheGC(bool async=true);
+
+    /* Abort the background cache jobs started by cacheGC() and
+       startUninstall(), and wait for them to finish. Call this before
+       exiting. The repository also does it when it is destroyed.
+     */
+    void stopCacheJobs();
+
+    // Hit rate, bytes saved etc.
+    FileCache::Stats getCacheStats() const;
+
+    // Remove any path, using Misc::Trash::removeTree(), in a
     // background thread.
     static Spread::JobInfoPtr killPath(const std::string &dir, bool async=true);
 
+    /* Delete everything in the repository trash, where uninstalled
+       games are moved. Started automatically by startUninstall() and
+       initRepo(), so you normally don't need to call this.
+     */
+    Spread::JobInfoPtr emptyTrash(bool async=true);
+
     // Get access to the Spread repository instance used internally by
     // Repo
     Spread::SpreadLib &getSpread() const;
@@ -212,6 +418,12 @@ namespace TigLib
     // Set new lastTime. Does NOT change the current lastTime field,
     // but instead stores the value in conf for our next run.
     void setLastTime(int64_t val);
+
+    /* Config changes are written in the background, shortly after
+       they are made (see journalconf.hpp). Call this before exiting to
+       make sure nothing is lost.
+     */
+    void flushConfig();
   };
 }
 #endif
@@ -51,3 +51,14 @@ bool DateSort::isLess(const LiveInfo *a, const LiveInfo *b)
 {
   return a->ent->addTime > b->ent->addTime;
 }
+
+bool SizeSort::isLess(const LiveInfo *a, const LiveInfo *b)
+{
+  int64_t sizeA = a->getSize();
+  int64_t sizeB = b->getSize();
+
+  if(sizeA == sizeB)
+    return TitleSort::isLess(a, b);
+
+  return sizeA > sizeB;
+}
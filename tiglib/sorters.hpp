@@ -35,6 +35,13 @@ namespace TigLib
   {
     bool isLess(const LiveInfo *a, const LiveInfo *b);
   };
+
+  /* Sort by installed size (largest first), then by title.
+   */
+  struct SizeSort : TitleSort
+  {
+    bool isLess(const LiveInfo *a, const LiveInfo *b);
+  };
 }
 
 #endif
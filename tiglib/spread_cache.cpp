@@ -0,0 +1,31 @@
+#include "spread_cache.hpp"
+
+#include <spread/spread.hpp>
+
+// At file scope, so it is constructed before any threads exist
+static boost::mutex spreadMutex;
+
+TigLib::SpreadLock::SpreadLock() : lock(spreadMutex) {}
+
+int TigLib::cacheFiles(Spread::SpreadLib &spread,
+                       const std::vector<std::string> &files)
+{
+  SpreadLock lock;
+
+  int res = 0;
+  for(int i=0; i<files.size(); i++)
+    {
+      try
+        {
+          spread.cacheFile(files[i]);
+          res++;
+        }
+      catch(...) {}
+    }
+  return res;
+}
+
+bool TigLib::cacheFile(Spread::SpreadLib &spread, const std::string &file)
+{
+  return cacheFiles(spread, std::vector<std::string>(1, file)) == 1;
+}
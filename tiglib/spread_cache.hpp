@@ -0,0 +1,43 @@
+#ifndef __TIGLIB_SPREAD_CACHE_HPP_
+#define __TIGLIB_SPREAD_CACHE_HPP_
+
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace Spread { struct SpreadLib; }
+
+namespace TigLib
+{
+  /* SpreadLib is not thread safe. Installs, imports, verify repairs
+     and the app updater all use it from their own threads, so every
+     call into a SpreadLib that can happen while other jobs run must
+     hold this lock. It is shared by all SpreadLibs in the process.
+
+     Only hold it for the call itself. Jobs returned by Spread run on
+     their own, and must not be waited for with the lock held.
+   */
+  struct SpreadLock
+  {
+    SpreadLock();
+
+  private:
+    boost::lock_guard<boost::mutex> lock;
+  };
+
+  /* Add files to Spread's file cache, so installs can copy them
+     instead of downloading them. Takes the SpreadLock. Each file is
+     hashed in full, so prefer adding files in one batch after they
+     have all been written, rather than one by one from inside a copy
+     loop.
+
+     Failing to cache a file is not an error. Returns the number of
+     files cached.
+   */
+  int cacheFiles(Spread::SpreadLib &spread, const std::vector<std::string> &files);
+
+  bool cacheFile(Spread::SpreadLib &spread, const std::string &file);
+}
+
+#endif
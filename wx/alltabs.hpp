@@ -60,6 +60,15 @@ struct DownloadsCol : ColumnHandler
   }
 };
 
+struct SizeCol : ColumnHandler
+{
+  bool doSort(wxGameList &lst) { return lst.sortSize(); }
+  wxString getText(const wxGameInfo &e)
+  {
+    return e.sizeString();
+  }
+};
+
 struct StatusCol : ColumnHandler
 {
   wxString textNotInst, textReady;
@@ -156,12 +165,28 @@ struct DemoTab : GameTab
 // Installed or installing games
 struct InstalledTab : GameTab
 {
-  InstalledTab(wxNotebook *parent, wxGameData &data)
-    : GameTab(parent, wxT("Installed"), data.getInstalled())
+  wxGameData &data;
+
+  InstalledTab(wxNotebook *parent, wxGameData &_data)
+    : GameTab(parent, wxT("Installed"), _data.getInstalled()), data(_data)
   {
     list->addColumn("Name", 310, new TitleCol);
     list->addColumn("Status", 170, new StatusCol);
+    list->addColumn("Size", 75, new SizeCol);
 
     lister.sortTitle();
   }
+
+  // Show the total size in the tab title
+  wxString getTitle()
+  {
+    wxString res = GameTab::getTitle();
+    wxString size = data.totalSizeString();
+    if(!size.IsEmpty())
+      res += wxT(" - ") + size;
+    return res;
+  }
+
+  // Sizes are updated in the background
+  void gameStatusChanged() { updateTitle(); }
 };
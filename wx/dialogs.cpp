@@ -97,6 +97,26 @@ OutputDirDialog::OutputDirDialog(wxWindow *parent, const std::string &old_dir,
 
   Destroy(); 
 }
+
+TextDialog::TextDialog(wxWindow *parent, const wxString &title,
+                       const std::string &text)
+  : wxDialog(parent, -1, title, wxDefaultPosition, wxSize(600, 450))
+{
+  wxBoxSizer *vbox = new wxBoxSizer(wxVERTICAL);
+
+  wxTextCtrl *edit = new wxTextCtrl(this, -1, strToWx(text),
+                                    wxDefaultPosition, wxDefaultSize,
+                                    wxTE_MULTILINE | wxTE_READONLY | wxTE_DONTWRAP);
+  edit->SetFont(wxFont(9, wxFONTFAMILY_TELETYPE, wxFONTSTYLE_NORMAL,
+                       wxFONTWEIGHT_NORMAL));
+  vbox->Add(edit, 1, wxEXPAND | wxALL, 8);
+  vbox->Add(CreateButtonSizer(wxOK), 0, wxALIGN_CENTER | wxBOTTOM, 8);
+  SetSizer(vbox);
+
+  Centre();
+  ShowModal();
+  Destroy();
+}
 /*
 ImportDialog::ImportDialog(wxWindow *parent, const std::string &maindir)
   : BrowseDialog(parent, wxT("Add/Import Data"), 450, 280)
@@ -49,6 +49,13 @@ namespace wxTiggit
     std::string path;
   };
 
+  // Read-only text display, used for diagnostics output.
+  struct TextDialog : wxDialog
+  {
+    TextDialog(wxWindow *parent, const wxString &title,
+               const std::string &text);
+  };
+
   /*
   struct ImportDialog : BrowseDialog
   {
@@ -3,6 +3,7 @@
 #include "myids.hpp"
 #include "dialogs.hpp"
 #include "boxes.hpp"
+#include "misc/trace.hpp"
 
 using namespace wxTiggit;
 
@@ -32,6 +33,7 @@ TigFrame::TigFrame(const wxString& title, const std::string &ver,
 
   wxMenu *menuData = new wxMenu;
   menuData->Append(myID_MENU_SETDIR, _("Set &Data Location..."));
+  menuData->Append(myID_MENU_DEDUP, _("&Free Space Used by Duplicates..."));
   /*
   menuData->Append(myID_MENU_EXPORT, _("&Export Data"));
   menuData->Append(myID_MENU_IMPORT, _("Add/&Import Data"));
@@ -104,6 +106,8 @@ TigFrame::TigFrame(const wxString& title, const std::string &ver,
 
   Connect(myID_MENU_SETDIR, wxEVT_COMMAND_MENU_SELECTED,
           wxCommandEventHandler(TigFrame::onDataMenu));
+  Connect(myID_MENU_DEDUP, wxEVT_COMMAND_MENU_SELECTED,
+          wxCommandEventHandler(TigFrame::onDataMenu));
   Connect(myID_MENU_IMPORT, wxEVT_COMMAND_MENU_SELECTED,
           wxCommandEventHandler(TigFrame::onDataMenu));
   Connect(myID_MENU_EXPORT, wxEVT_COMMAND_MENU_SELECTED,
@@ -117,7 +121,9 @@ void TigFrame::onClose(wxCloseEvent &event)
   bool exit = true;
   if(event.CanVeto())
     {
-      if(data.isActive())
+      if(data.isActive() && data.conf().getBackgroundJobs())
+        exit = Boxes::ask("There are downloads in progress. Are you sure you want to exit? The downloads will be stopped, and then started over from the beginning in the background.");
+      else if(data.isActive())
         exit = Boxes::ask("There are downloads in progress. Are you sure you want to exit? All downloads will be aborted.");
     }
 
@@ -127,9 +133,16 @@ void TigFrame::onClose(wxCloseEvent &event)
 
 void TigFrame::onOption(wxCommandEvent &event)
 {
+  TRACE_SCOPE("TigFrame::onOption");
   if(event.GetId() == myID_MENU_SHOW_VOTES)
     {
       data.conf().setShowVotes(event.IsChecked());
+
+      // The list views cache their text, so tell them explicitly
+      newGamesTab->displayChanged();
+      freewareTab->displayChanged();
+      demosTab->displayChanged();
+      installedTab->displayChanged();
       Refresh();
     }
 }
@@ -170,6 +183,7 @@ void TigFrame::displayNotification(const std::string &message, const std::string
 
 void TigFrame::onDataMenu(wxCommandEvent &event)
 {
+  TRACE_SCOPE("TigFrame::onDataMenu");
   if(event.GetId() == myID_MENU_SETDIR)
     {
       const std::string &curDir = data.getRepoDir();
@@ -200,6 +214,8 @@ void TigFrame::onDataMenu(wxCommandEvent &event)
           error = true;
         }
     }
+  else if(event.GetId() == myID_MENU_DEDUP)
+    data.dedupGames();
   /*
   else if(event.GetId() == myID_MENU_IMPORT)
     {
@@ -238,6 +254,11 @@ void TigFrame::onSpecialKey(wxCommandEvent &event)
       book->AdvanceSelection(true);
       focusTab();
     }
+  else if(event.GetInt() == WXK_F12)
+    {
+      // Hidden diagnostics view
+      TextDialog(this, wxT("Diagnostics"), data.getDiagnostics());
+    }
   else
     event.Skip();
 }
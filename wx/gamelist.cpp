@@ -2,6 +2,10 @@
 
 using namespace wxTiggit;
 
+// Number of rows kept in the row cache. Should comfortably cover one
+// visible page of the list.
+#define ROW_CACHE_SIZE 64
+
 void ColumnHandler::sort(wxGameList &lst)
 {
   if(doSort(lst))
@@ -11,8 +15,11 @@ void ColumnHandler::sort(wxGameList &lst)
 }
 
 GameListView::GameListView(wxWindow *parent, int id, wxGameList &lst)
-  : ListBase(parent, id), lister(lst), markNew(false), markInstalled(false)
+  : ListBase(parent, id), lister(lst), generation(0), markNew(false),
+    markInstalled(false)
 {
+  rowCache.resize(ROW_CACHE_SIZE);
+
   orange.SetBackgroundColour(wxColour(255,240,180));
   orange.SetTextColour(wxColour(0,0,0));
 
@@ -56,12 +63,14 @@ void GameListView::addColumn(const std::string &name, int width, ColumnHandler *
   col.SetText(strToWx(name));
   col.SetWidth(width);
   InsertColumn(colNum, col);
+
+  clearCache();
 }
 
-void GameListView::gameInfoChanged() { Refresh(); }
-void GameListView::gameStatusChanged() { Refresh(); }
-void GameListView::gameListChanged() { updateSize(); }
-void GameListView::gameSelectionChanged() { updateSize(); }
+void GameListView::gameInfoChanged() { clearCache(); Refresh(); }
+void GameListView::gameStatusChanged() { clearCache(); Refresh(); }
+void GameListView::gameListChanged() { clearCache(); updateSize(); }
+void GameListView::gameSelectionChanged() { clearCache(); updateSize(); }
 
 // Refresh list size.
 void GameListView::updateSize()
@@ -71,13 +80,8 @@ void GameListView::updateSize()
   Refresh();
 }
 
-wxListItemAttr *GameListView::OnGetItemAttr(long item) const
+wxListItemAttr *GameListView::makeAttr(const wxGameInfo &g) const
 {
-  if(item < 0 || item >= lister.size())
-    return NULL;
-
-  const wxGameInfo &g = lister.get(item);
-
   if(markNew)
     {
       if(!g.isUninstalled())
@@ -103,14 +107,47 @@ wxListItemAttr *GameListView::OnGetItemAttr(long item) const
   return (wxListItemAttr*)&orange;
 }
 
+const GameListView::CachedRow &GameListView::getRow(long item) const
+{
+  assert(item >= 0 && item < lister.size());
+  assert(rowCache.size() == ROW_CACHE_SIZE);
+
+  CachedRow &row = rowCache[item % ROW_CACHE_SIZE];
+  if(row.item == item && row.gen == generation)
+    return row;
+
+  // Not found, render the row from scratch
+  const wxGameInfo &g = lister.get(item);
+
+  row.item = item;
+  row.gen = generation;
+  row.attr = makeAttr(g);
+  row.text.resize(colHands.size());
+  for(int i=0; i<colHands.size(); i++)
+    {
+      ColumnHandler *h = colHands[i];
+      assert(h);
+      row.text[i] = h->getText(g);
+    }
+
+  return row;
+}
+
+wxListItemAttr *GameListView::OnGetItemAttr(long item) const
+{
+  if(item < 0 || item >= lister.size())
+    return NULL;
+
+  return getRow(item).attr;
+}
+
 wxString GameListView::OnGetItemText(long item, long column) const
 {
   if(column < 0 || column >= colHands.size() ||
      item < 0 || item >= lister.size())
     return wxT("No info");
 
-  assert(column >= 0 && column < colHands.size());
-  ColumnHandler *h = colHands[column];
-  assert(h);
-  return h->getText(lister.get(item));
+  const CachedRow &row = getRow(item);
+  assert(column < row.text.size());
+  return row.text[column];
 }
@@ -22,6 +22,28 @@ namespace wxTiggit
     wxGameList &lister;
     std::vector<ColumnHandler*> colHands;
 
+    /* Cache of rendered rows. Virtual list controls ask for the same
+       rows over and over while painting and scrolling, so we keep the
+       last few rows around instead of going through the game list
+       and column handlers every time.
+
+       Slots are picked by row number (item % size), and an entry is
+       only valid if it was rendered in the current generation. Any
+       change notification bumps the generation, which invalidates
+       the entire cache.
+     */
+    struct CachedRow
+    {
+      long item;
+      int gen;
+      wxListItemAttr *attr;
+      std::vector<wxString> text;
+
+      CachedRow() : item(-1), gen(-1), attr(NULL) {}
+    };
+    mutable std::vector<CachedRow> rowCache;
+    int generation;
+
   public:
     // Special display modifiers
     bool markNew, markInstalled;
@@ -30,6 +52,10 @@ namespace wxTiggit
 
     void addColumn(const std::string &name, int width, ColumnHandler *ch);
 
+    // Throw away all cached row data. Done automatically on all list
+    // notifications.
+    void clearCache() { generation++; }
+
     // wxGameListener functions
     void gameInfoChanged();
     void gameSelectionChanged();
@@ -40,6 +66,10 @@ namespace wxTiggit
     void onHeaderClick(wxListEvent& event);
     void updateSize();
 
+    // Get a rendered row, from the cache if possible
+    const CachedRow &getRow(long item) const;
+    wxListItemAttr *makeAttr(const wxGameInfo &g) const;
+
     // Inherited functions used for fetching the list data
     wxListItemAttr *OnGetItemAttr(long item) const;
     wxString OnGetItemText(long item, long column) const;
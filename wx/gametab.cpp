@@ -2,6 +2,7 @@
 #include "image_viewer.hpp"
 #include "myids.hpp"
 #include "boxes.hpp"
+#include "misc/trace.hpp"
 
 using namespace wxTiggit;
 
@@ -231,6 +232,7 @@ void GameTab::onRating(wxCommandEvent &event)
 
 void GameTab::onTagSelect(wxCommandEvent &event)
 {
+  TRACE_SCOPE("GameTab::onTagSelect");
   int sel = event.GetSelection();
 
   /* Clear search when setting tags, as a lingering search string
@@ -260,6 +262,7 @@ void GameTab::onTagSelect(wxCommandEvent &event)
 
 void GameTab::onSearch(wxCommandEvent &event)
 {
+  TRACE_SCOPE("GameTab::onSearch");
   lister.setSearch(wxToStr(event.GetString()));
 }
 
@@ -289,6 +292,7 @@ void GameTab::onGamePage(wxCommandEvent &event)
 
 void GameTab::onButton(wxCommandEvent &event)
 {
+  TRACE_SCOPE("GameTab::onButton");
   if(event.GetId() == myID_BUTTON1)
     doAction1(select);
   else if(event.GetId() == myID_BUTTON2)
@@ -298,6 +302,7 @@ void GameTab::onButton(wxCommandEvent &event)
 
 void GameTab::onListActivate(wxListEvent &event)
 {
+  TRACE_SCOPE("GameTab::onListActivate");
   doAction1(event.GetIndex());
 }
 
@@ -309,6 +314,7 @@ void GameTab::onListDeselect(wxListEvent &event)
 
 void GameTab::onListSelect(wxListEvent &event)
 {
+  TRACE_SCOPE("GameTab::onListSelect");
   select = event.GetIndex();
   updateSelection();
 }
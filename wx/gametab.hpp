@@ -41,6 +41,7 @@ namespace wxTiggit
 
     // TabBase functions
     void gotFocus();
+    void displayChanged() { list->gameInfoChanged(); }
     int getTitleNumber();
 
     // Event handling functions
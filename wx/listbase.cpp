@@ -16,7 +16,8 @@ void ListBase::onKeyDown(wxKeyEvent &evt)
   // Capture special keys
   if(evt.GetKeyCode() == WXK_LEFT ||
      evt.GetKeyCode() == WXK_RIGHT ||
-     evt.GetKeyCode() == WXK_DELETE)
+     evt.GetKeyCode() == WXK_DELETE ||
+     evt.GetKeyCode() == WXK_F12)
     {
       // Send the key as a special button press
       wxCommandEvent cmd(wxEVT_COMMAND_BUTTON_CLICKED, myID_SPECIAL_KEY);
@@ -97,7 +97,7 @@ public:
     // Find number of unread items
     int unread = 0;
     for(int i=0; i<news.size(); i++)
-      if(!news.get(i).read)
+      if(!news.isRead(i))
         unread++;
     return unread;
   }
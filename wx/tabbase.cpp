@@ -15,7 +15,10 @@ TabBase::TabBase(wxNotebook *parent, const wxString &name)
 
 void TabBase::updateTitle()
 {
-  book->SetPageText(tabNum, getTitle());
+  // Avoid flickering when this is called often
+  wxString title = getTitle();
+  if(title != book->GetPageText(tabNum))
+    book->SetPageText(tabNum, title);
 }
 
 wxString TabBase::getTitle()
@@ -16,6 +16,10 @@ namespace wxTiggit
     // Called when the tab is selected
     virtual void gotFocus() {}
 
+    // Called when display options have changed and the tab contents
+    // must be redrawn.
+    virtual void displayChanged() { Refresh(); }
+
     void select()
     {
       book->SetSelection(tabNum);
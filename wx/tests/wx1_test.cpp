@@ -39,6 +39,10 @@ struct TestInfo : wxGameInfo
   {
     return wxT("Ah, not bad.");
   }
+  wxString sizeString() const
+  {
+    return wxT("1.2Gb");
+  }
 
   std::string getHomepage() const { return "http://tiggit.net/"; }
   std::string getTiggitPage() const { return "http://tiggit.net/"; }
@@ -75,6 +79,7 @@ struct TestList : wxGameList
   bool sortDate() { cout << "Date!\n"; return false; }
   bool sortRating() { cout << "Rating!\n"; return false; }
   bool sortDownloads() { cout << "Downloads!\n"; return false; }
+  bool sortSize() { cout << "Size!\n"; return false; }
 
   void clearTags() {}
   void setTags(const std::string &) {}
@@ -99,6 +104,7 @@ struct TestConf : wxGameConf
   {
     cout << "Setting option: " << (b?"TRUE":"FALSE") << endl;
   }
+  virtual bool getBackgroundJobs() { return false; }
 };
 
 struct TestNews : wxGameNews
@@ -165,6 +171,12 @@ struct TestData : wxGameData
   wxGameConf &conf() { return testConf; }
 
   void notifyButton(int id) {}
+
+  void dedupGames() { cout << "Dedup games\n"; }
+
+  std::string getDiagnostics() { return "No diagnostics in test mode"; }
+
+  wxString totalSizeString() { return wxT("3.6Gb"); }
 };
 
 TestData testData;
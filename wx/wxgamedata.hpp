@@ -27,6 +27,9 @@ namespace wxTiggit
     virtual wxString dlString() const = 0;
     virtual wxString statusString() const = 0;
 
+    // Disk space used by the installed game. Empty if unknown.
+    virtual wxString sizeString() const = 0;
+
     virtual std::string getHomepage() const = 0;
     virtual std::string getTiggitPage() const = 0;
     virtual std::string getIdName() const = 0;
@@ -64,6 +67,7 @@ namespace wxTiggit
     virtual bool sortDate() = 0;
     virtual bool sortRating() = 0;
     virtual bool sortDownloads() = 0;
+    virtual bool sortSize() = 0;
 
     virtual int size() const = 0;
     virtual const wxGameInfo& get(int) = 0;
@@ -74,6 +78,10 @@ namespace wxTiggit
   {
     virtual bool getShowVotes() = 0;
     virtual void setShowVotes(bool) = 0;
+
+    // True if unfinished installs are restarted in the background on
+    // exit
+    virtual bool getBackgroundJobs() = 0;
   };
 
   struct wxGameNewsItem
@@ -87,6 +95,10 @@ namespace wxTiggit
   {
     virtual const wxGameNewsItem &get(int i) const = 0;
     virtual int size() const = 0;
+
+    // Same as get(i).read, but may be cheaper
+    virtual bool isRead(int i) const { return get(i).read; }
+
     virtual void reload() = 0;
     virtual void markAsRead(int) = 0;
     virtual void markAllAsRead() = 0;
@@ -114,6 +126,17 @@ namespace wxTiggit
 
     virtual void notifyButton(int id) = 0;
 
+    // Find and merge identical files across installed games. Handles
+    // its own user interaction.
+    virtual void dedupGames() = 0;
+
+    // Disk space used by all installed games. Empty if unknown.
+    virtual wxString totalSizeString() = 0;
+
+    // Human readable diagnostics info (timings etc.), shown by a
+    // hidden dialog.
+    virtual std::string getDiagnostics() = 0;
+
     wxAppListener *listener;
     wxGameData() : listener(NULL) {}
   };